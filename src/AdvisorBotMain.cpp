@@ -3,37 +3,298 @@
 #include <vector>
 #include <map>
 #include <functional>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <optional>
+#include <charconv>
+#include <cctype>
+#include <cmath>
 #include "OrderBookEntry.h"
 #include "CSVReader.h"
+#include "Tokenizer.h"
+#include "Trace.h"
+
+// the commands that are counted and timed
+static const char* const commandNames[] = {"help", "prod", "min", "max", "avg", "predict", "time", "step", "goto", "back", "stats", "exit"};
 
 AdvisorBotMain::AdvisorBotMain()
+: AdvisorBotMain(std::make_shared<const OrderBook>("20200317.csv"), makeCommandCounters())
+{
+
+}
+
+/** construct a session over an already loaded order book nobody writes to, sharing the command counters */
+AdvisorBotMain::AdvisorBotMain(std::shared_ptr<const OrderBook> _book, std::shared_ptr<CommandCounters> _commandsCounter)
+: AdvisorBotMain(_book, nullptr, nullptr, _commandsCounter)
+{
+
+}
+
+/** construct a session over an already loaded order book, sharing the command counters.
+ * The book may be written to by another thread while the session runs
+ * */
+AdvisorBotMain::AdvisorBotMain(std::shared_ptr<ConcurrentOrderBook> _sharedBook, std::shared_ptr<CommandCounters> _commandsCounter)
+: AdvisorBotMain(nullptr, _sharedBook, nullptr, _commandsCounter)
 {
 
 }
 
+/** construct a session over a multi-day dataset, days are loaded as the session reaches them */
+AdvisorBotMain::AdvisorBotMain(std::shared_ptr<DayCatalogue> _catalogue, std::shared_ptr<CommandCounters> _commandsCounter)
+: AdvisorBotMain(nullptr, nullptr, _catalogue, _commandsCounter)
+{
+
+}
+
+/** construct a session over a book, a shared book or a catalogue, the other two are nullptr */
+AdvisorBotMain::AdvisorBotMain(std::shared_ptr<const OrderBook> _book, std::shared_ptr<ConcurrentOrderBook> _sharedBook, std::shared_ptr<DayCatalogue> _catalogue, std::shared_ptr<CommandCounters> _commandsCounter)
+: book(_book), sharedBook(_sharedBook), catalogue(_catalogue), orderBook(nullptr), commandsCounter(_commandsCounter), output(&std::cout), running(true)
+{
+    currentTime = getEarliestTime();
+
+    for (const char* command : commandNames)
+    {
+        commandLatencies[command] = &Metrics::global().histogram(std::string{"command."} + command);
+    }
+}
+
+/** return counters for every command, to be shared by the sessions */
+std::shared_ptr<CommandCounters> AdvisorBotMain::makeCommandCounters()
+{
+    // all counters exist before any session does, so sessions on other threads only ever increment them
+    std::shared_ptr<CommandCounters> counters = std::make_shared<CommandCounters>();
+    for (const char* command : commandNames)
+    {
+        (*counters)[command];
+    }
+    return counters;
+}
+
 /** init function */
 void AdvisorBotMain::init()
 {
-    currentTime = orderBook.getEarliestTime();
-    std::map<std::string, int> commandsCounter;
+    currentTime = getEarliestTime();
 
     printHelp();
 
-    while(true)
+    while(running)
     {
         printTitle();
-        processUserInput(getUserInput());
+        std::vector<std::string> input = getUserInput();
+        if (running) {
+            processUserInput(input);
+        }
+    }
+}
+
+/** wraps text in double quotes, escaping it for a csv or json field */
+static std::string quoteField(const std::string& text, std::string format)
+{
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"') {
+            quoted += format == "csv" ? "\"\"" : "\\\"";
+        } else if (c == '\\' && format == "json") {
+            quoted += "\\\\";
+        } else if (c == '\n' && format == "json") {
+            quoted += "\\n";
+        } else if (c == '\t' && format == "json") {
+            quoted += "\\t";
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+/** appends the result of one command to the batch buffer in the requested format */
+static void appendResult(std::string& buffer, unsigned long lineNumber, const std::string& line, std::string text, std::string format)
+{
+    // drop the blank lines processUserInput frames every command with
+    std::size_t first = text.find_first_not_of('\n');
+    std::size_t last = text.find_last_not_of('\n');
+    text = first == std::string::npos ? "" : text.substr(first, last - first + 1);
+
+    if (format == "csv") {
+        buffer += std::to_string(lineNumber) + "," + quoteField(line, format) + "," + quoteField(text, format) + "\n";
+    } else if (format == "json") {
+        buffer += "{\"line\":" + std::to_string(lineNumber) + ",\"command\":" + quoteField(line, format) + ",\"output\":" + quoteField(text, format) + "}\n";
+    } else {
+        buffer += text + "\n\n";
+    }
+}
+
+/** runs every command read from commands until EOF, writing the results to results.
+ * format is text, csv or json (one json object per line)
+ * */
+void AdvisorBotMain::runBatch(std::istream& commands, std::ostream& results, std::string format, unsigned int threads)
+{
+    // results are collected in one large buffer which is written out in big chunks,
+    // every command writes into its own small stream so it can be formatted
+    const std::size_t flushSize = 1 << 20;
+    std::string buffer;
+    buffer.reserve(flushSize + 4096);
+    std::ostringstream commandOutput;
+    output = &commandOutput;
+
+    if (format == "csv") {
+        buffer += "line,command,output\n";
+    }
+
+    currentTime = getEarliestTime();
+    running = true;
+    unsigned long lineNumber = 0;
+    unsigned long commandsRun = 0;
+    std::string line;
+    std::vector<std::string> input;
+    auto start = std::chrono::steady_clock::now();
+
+    if (threads > 1) {
+        commandsRun = runBatchParallel(commands, results, format, threads, buffer);
+    } else {
+        while (running && std::getline(commands, line))
+        {
+            lineNumber++;
+            tokeniseCommand(line, input);
+            // skip blank lines and # comments in scripts
+            if (input.size() == 0 || input[0][0] == '#') {
+                continue;
+            }
+
+            commandOutput.str("");
+            processUserInput(input);
+            commandsRun++;
+            appendResult(buffer, lineNumber, line, commandOutput.str(), format);
+
+            if (buffer.size() >= flushSize) {
+                results.write(buffer.data(), buffer.size());
+                buffer.clear();
+            }
+        }
+    }
+    results.write(buffer.data(), buffer.size());
+    results.flush();
+
+    output = &std::cout;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cerr << "AdvisorBotMain::runBatch ran " << commandsRun << " commands in " << elapsed.count() << "s ("
+              << (elapsed.count() > 0 ? commandsRun / elapsed.count() : 0) << " commands/s)" << std::endl;
+}
+
+/** runs the batch on a pool of worker sessions sharing the read-only order book.
+ * Appends the results to buffer in input order, returns the amount of commands run.
+ * */
+unsigned long AdvisorBotMain::runBatchParallel(std::istream& commands, std::ostream& results, std::string format, unsigned int threads, std::string& buffer)
+{
+    struct BatchCommand
+    {
+        unsigned long lineNumber;
+        std::string line;
+        std::vector<std::string> input;
+        // the time the command runs at, decided up front so commands can run in any order
+        std::string time;
+        std::string result;
+    };
+
+    // read the whole batch, replaying step / exit serially to give every command its time.
+    // step only needs getNextTime, so this pass is cheap compared to the queries
+    std::vector<BatchCommand> batch;
+    std::string line;
+    unsigned long lineNumber = 0;
+    std::string time = currentTime;
+    std::vector<std::string> input;
+    while (std::getline(commands, line))
+    {
+        lineNumber++;
+        tokeniseCommand(line, input);
+        if (input.size() == 0 || input[0][0] == '#') {
+            continue;
+        }
+        batch.push_back(BatchCommand{lineNumber, line, input, time, ""});
+        if (input[0] == "step" || input[0] == "goto" || input[0] == "back") {
+            std::string target = getTargetTime(input, time);
+            time = target != "" ? target : time;
+        } else if (input[0] == "exit") {
+            break;
+        }
+    }
+    currentTime = time;
+
+    // every worker is a session of its own (time, output, cache) over the shared book and counters,
+    // commands are handed out one at a time so slow queries don't hold up a whole chunk
+    std::atomic<std::size_t> next{0};
+    auto work = [this, &batch, &next](unsigned int worker)
+    {
+        Trace::setThreadName("batch worker " + std::to_string(worker));
+        AdvisorBotMain session{book, sharedBook, catalogue, commandsCounter};
+        std::ostringstream commandOutput;
+        session.output = &commandOutput;
+        for (std::size_t i = next++; i < batch.size(); i = next++)
+        {
+            commandOutput.str("");
+            session.currentTime = batch[i].time;
+            session.processUserInput(batch[i].input);
+            batch[i].result = commandOutput.str();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back(work, i);
     }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    // emit in input order
+    const std::size_t flushSize = 1 << 20;
+    for (const BatchCommand& command : batch)
+    {
+        appendResult(buffer, command.lineNumber, command.line, command.result, format);
+        if (buffer.size() >= flushSize) {
+            results.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    return batch.size();
+}
+
+/** runs one command line and returns its output, without the blank lines framing it */
+std::string AdvisorBotMain::runCommand(std::string line)
+{
+    std::ostringstream commandOutput;
+    std::ostream* previousOutput = output;
+    output = &commandOutput;
+    std::vector<std::string> input;
+    tokeniseCommand(line, input);
+    processUserInput(input);
+    output = previousOutput;
+
+    std::string text = commandOutput.str();
+    std::size_t first = text.find_first_not_of('\n');
+    std::size_t last = text.find_last_not_of('\n');
+    return first == std::string::npos ? "" : text.substr(first, last - first + 1);
+}
+
+/** return false once exit was requested */
+bool AdvisorBotMain::isRunning() const
+{
+    return running;
 }
 
 /** Print title*/
 void AdvisorBotMain::printTitle()
 {   
-    std::cout << "Please enter a command, or help for a list of commands" << std::endl;
+    *output << "Please enter a command, or help for a list of commands" << "\n";
 }
 
 /** handle help command*/
-void AdvisorBotMain::handleHelp(std::vector<std::string> input)
+void AdvisorBotMain::handleHelp(const std::vector<std::string>& input)
 {
     if (input.size() == 1) {
          // if no argument are passed
@@ -64,6 +325,14 @@ void AdvisorBotMain::handleHelp(std::string command)
         printTime();
     } else if (command == "step") {
         printStep();
+    } else if (command == "goto") {
+        printGoto();
+    } else if (command == "back") {
+        printBack();
+    } else if (command == "stats") {
+        printStats();
+    } else if (command == "exit") {
+        printExit();
     } else {
         // invalid command passed
         printInvalidCommand();
@@ -73,19 +342,19 @@ void AdvisorBotMain::handleHelp(std::string command)
 /** print help */
 void AdvisorBotMain::printHelp()
 {
-    std::cout << std::endl;
-    std::cout << "===============================================" << std::endl;
-    std::cout << std::endl;
+    *output << "\n";
+    *output << "===============================================" << "\n";
+    *output << "\n";
 
-    std::cout << "Available commands are:" << std::endl;
-    std::cout << std::endl;
+    *output << "Available commands are:" << "\n";
+    *output << "\n";
 
-    std::cout << "help" << "\t\t" << "Get help on the available commands" << std::endl;
-    std::cout << std::endl;
-    std::cout << "help <cmd>" << "\t" << "Get help on the specified <cmd> command" << std::endl;
-    std::cout << "\t\t" << "usage: help <command>" << std::endl;
-    std::cout << "\t\t" << "example: help avg" << std::endl;
-    std::cout << std::endl;
+    *output << "help" << "\t\t" << "Get help on the available commands" << "\n";
+    *output << "\n";
+    *output << "help <cmd>" << "\t" << "Get help on the specified <cmd> command" << "\n";
+    *output << "\t\t" << "usage: help <command>" << "\n";
+    *output << "\t\t" << "example: help avg" << "\n";
+    *output << "\n";
     
 
     // rest of commands
@@ -96,53 +365,64 @@ void AdvisorBotMain::printHelp()
     printPredict();
     printTime();
     printStep();
+    printGoto();
+    printBack();
     printStats();
-    std::cout << std::endl;
+    printExit();
+    *output << "\n";
 }
 
 /** lists all known products */
 void AdvisorBotMain::handleProd()
 {
-    std::cout << "Available products:" << std::endl;
-    std::vector<std::string> products = orderBook.getKnownProducts();
+    *output << "Available products:" << "\n";
+    std::vector<std::string> products = orderBook->getKnownProducts();
     for (std::string& product : products)
     {
-        std::cout << product << std::endl;
+        *output << product << "\n";
     }
-    std::cout << std::endl;    
+    *output << "\n";    
 }
 
 /** print products command help*/
 void AdvisorBotMain::printProd()
 {
-    std::cout << "prod" << "\t\t" << "List all available products" << std::endl;
-    std::cout << "\t\t" << "usage: prod" << std::endl;
-    std::cout << std::endl;
+    *output << "prod" << "\t\t" << "List all available products" << "\n";
+    *output << "\t\t" << "usage: prod" << "\n";
+    *output << "\n";
 }
 
 /** print minimum price for product of specific type (bid/ask) */
-void AdvisorBotMain::handleMin(std::vector<std::string> input)
+void AdvisorBotMain::handleMin(const std::vector<std::string>& input)
 {   
     if (input.size() == 3) {
         // handle bookType
         OrderBookType bookType = OrderBookEntry::stringToOrderBookType(input[2]);
         if (bookType == OrderBookType::unknown) {
-            std::cout << "book type is invalid. valid types are: ask/ bid" << std::endl;
+            *output << "book type is invalid. valid types are: ask/ bid" << "\n";
             return;
         }
 
         // handle product input
         std::string product = input[1];
-        if (!orderBook.isProductInTimestamp(product, currentTime, bookType)) {
-            std::cout << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " not found in the current timestamp: " << currentTime << std::endl;
+        if (!orderBook->isProductInTimestamp(product, currentTime, bookType)) {
+            *output << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " not found in the current timestamp: " << currentTime << "\n";
             return;
         }
 
         // handle min calculation
-        std::vector<OrderBookEntry> orders = orderBook.getOrders(bookType, product, currentTime);
-        const double price = orderBook.getLowPrice(orders);
+        std::string cacheKey = QueryCache::makeKey("min", product, bookType, currentTime, "");
+        unsigned long version = orderBook->getProductVersion(product);
+        double price;
+        if (!queryCache.lookup(cacheKey, version, price)) {
+            std::vector<OrderBookEntry> orders = orderBook->getOrders(bookType, product, currentTime);
+            price = orderBook->getLowPrice(orders);
+            queryCache.store(cacheKey, version, price);
+        }
 
-        std::cout << "The min " << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " is " << price << std::endl;
+        *output << "The min " << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " is " << price << "\n";
+    } else if (input.size() == 7) {
+        handleRange("min", input);
     } else {
         printInvalidCommand();
     }
@@ -151,35 +431,46 @@ void AdvisorBotMain::handleMin(std::vector<std::string> input)
 /** print min command help*/
 void AdvisorBotMain::printMin()
 {
-    std::cout << "min" << "\t\t" << "Find minimum bid or ask for product in current time step" << std::endl;
-    std::cout << "\t\t" << "usage: min <product> <type>" << std::endl;
-    std::cout << "\t\t" << "example: min ETH/BTC ask" << std::endl;
-    std::cout << std::endl;
+    *output << "min" << "\t\t" << "Find minimum bid or ask for product in current time step" << "\n";
+    *output << "\t\t" << "usage: min <product> <type>" << "\n";
+    *output << "\t\t" << "example: min ETH/BTC ask" << "\n";
+    *output << "\t\t" << "usage: min <product> <type> <from-timestamp> <to-timestamp>" << "\n";
+    *output << "\t\t" << "example: min ETH/BTC ask 2020/03/17 17:01:24 2020/03/17 17:01:55" << "\n";
+    *output << "\t\t" << "a timestamp cut short takes in every time it is the start of, 17:01:55 up to 17:01:55.999999" << "\n";
+    *output << "\n";
 }
 
 /** print maximum price for product of specific type (bid/ask) */
-void AdvisorBotMain::handleMax(std::vector<std::string> input)
+void AdvisorBotMain::handleMax(const std::vector<std::string>& input)
 {
     if (input.size() == 3) {
         // handle bookType
         OrderBookType bookType = OrderBookEntry::stringToOrderBookType(input[2]);
         if (bookType == OrderBookType::unknown) {
-            std::cout << "book type is invalid. valid types are: ask/ bid" << std::endl;
+            *output << "book type is invalid. valid types are: ask/ bid" << "\n";
             return;
         }
 
         // handle product input
         std::string product = input[1];
-        if (!orderBook.isProductInTimestamp(product, currentTime, bookType)) {
-            std::cout << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " not found in the current timestamp: " << currentTime << std::endl;
+        if (!orderBook->isProductInTimestamp(product, currentTime, bookType)) {
+            *output << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " not found in the current timestamp: " << currentTime << "\n";
             return;
         }
 
         // handle max calculation
-        std::vector<OrderBookEntry> orders = orderBook.getOrders(bookType, product, currentTime);
-        const double price = orderBook.getHighPrice(orders);
+        std::string cacheKey = QueryCache::makeKey("max", product, bookType, currentTime, "");
+        unsigned long version = orderBook->getProductVersion(product);
+        double price;
+        if (!queryCache.lookup(cacheKey, version, price)) {
+            std::vector<OrderBookEntry> orders = orderBook->getOrders(bookType, product, currentTime);
+            price = orderBook->getHighPrice(orders);
+            queryCache.store(cacheKey, version, price);
+        }
 
-        std::cout << "The max " << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " is " << price << std::endl;
+        *output << "The max " << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " is " << price << "\n";
+    } else if (input.size() == 7) {
+        handleRange("max", input);
     } else {
         printInvalidCommand();
     }
@@ -188,20 +479,23 @@ void AdvisorBotMain::handleMax(std::vector<std::string> input)
 /** print max command help*/
 void AdvisorBotMain::printMax()
 {   
-    std::cout << "max" << "\t\t" << "Find maximum bid or ask for product in current time step" << std::endl;
-    std::cout << "\t\t" << "usage: max <product> <type>" << std::endl;
-    std::cout << "\t\t" << "example: max ETH/BTC ask" << std::endl;
-    std::cout << std::endl;
+    *output << "max" << "\t\t" << "Find maximum bid or ask for product in current time step" << "\n";
+    *output << "\t\t" << "usage: max <product> <type>" << "\n";
+    *output << "\t\t" << "example: max ETH/BTC ask" << "\n";
+    *output << "\t\t" << "usage: max <product> <type> <from-timestamp> <to-timestamp>" << "\n";
+    *output << "\t\t" << "example: max ETH/BTC ask 2020/03/17 17:01:24 2020/03/17 17:01:55" << "\n";
+    *output << "\t\t" << "a timestamp cut short takes in every time it is the start of, 17:01:55 up to 17:01:55.999999" << "\n";
+    *output << "\n";
 }
 
 /** print avg price for product of specific type (bid/ask) in requested amount of timestemps*/
-void AdvisorBotMain::handleAvg(std::vector<std::string> input)
+void AdvisorBotMain::handleAvg(const std::vector<std::string>& input)
 {
     if (input.size() == 4) {
         // handle bookType
         OrderBookType bookType = OrderBookEntry::stringToOrderBookType(input[2]);
         if (bookType == OrderBookType::unknown) {
-            std::cout << "book type is invalid. valid types are: ask/ bid" << std::endl;
+            *output << "book type is invalid. valid types are: ask/ bid" << "\n";
             return;
         }
 
@@ -210,21 +504,30 @@ void AdvisorBotMain::handleAvg(std::vector<std::string> input)
         try {
             timesteps = std::stoi(input[3]);
         } catch (const std::exception& e) {
-            std::cout << "amount of timestamps is invalid. valid inputs are: numbers (1,2,3..)" << std::endl; 
+            *output << "amount of timestamps is invalid. valid inputs are: numbers (1,2,3..)" << "\n"; 
             return;
         }
 
         // handle product input
         std::string product = input[1];
-        if (!orderBook.isProductInTimestamp(product, currentTime, bookType, timesteps)) {
-            std::cout << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " not found in the last " << timesteps << " timestamps" << std::endl;
-            return;
-        }
 
-        // calc avg
-        double avg = orderBook.calcProductInTimestampsAvg(product, currentTime, timesteps, bookType);
+        // calc avg, the window may reach back into earlier days
+        std::string cacheKey = QueryCache::makeKey("avg", product, bookType, currentTime, std::to_string(timesteps));
+        unsigned long version = orderBook->getProductVersion(product);
+        double avg;
+        if (!queryCache.lookup(cacheKey, version, avg)) {
+            PriceSummary summary = getWindowSummary(product, bookType, timesteps);
+            if (summary.count == 0) {
+                *output << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " not found in the last " << timesteps << " timestamps" << "\n";
+                return;
+            }
+            avg = summary.avg();
+            queryCache.store(cacheKey, version, avg);
+        }
 
-        std::cout << "The avg " << product << " " << OrderBookEntry::bookTypeToString(bookType) << " over the last " << timesteps << " was " << avg << std::endl;
+        *output << "The avg " << product << " " << OrderBookEntry::bookTypeToString(bookType) << " over the last " << timesteps << " was " << avg << "\n";
+    } else if (input.size() == 7) {
+        handleRange("avg", input);
     } else {
         printInvalidCommand();
     }
@@ -233,24 +536,34 @@ void AdvisorBotMain::handleAvg(std::vector<std::string> input)
 /** print avg command help*/
 void AdvisorBotMain::printAvg()
 {
-    std::cout << "avg" << "\t\t" << "Compute Average ask/bid for product in the last timestamps" << std::endl;
-    std::cout << "\t\t" << "usage: avg <product> <type> <amount-of-timestemps>" << std::endl;
-    std::cout << "\t\t" << "example: avg ETH/BTC ask 10" << std::endl;
-    std::cout << std::endl;
+    *output << "avg" << "\t\t" << "Compute Average ask/bid for product in the last timestamps" << "\n";
+    *output << "\t\t" << "usage: avg <product> <type> <amount-of-timestemps>" << "\n";
+    *output << "\t\t" << "example: avg ETH/BTC ask 10" << "\n";
+    *output << "\t\t" << "usage: avg <product> <type> <from-timestamp> <to-timestamp>" << "\n";
+    *output << "\t\t" << "example: avg ETH/BTC ask 2020/03/17 17:01:24 2020/03/17 17:01:55" << "\n";
+    *output << "\t\t" << "a timestamp cut short takes in every time it is the start of, 17:01:55 up to 17:01:55.999999" << "\n";
+    *output << "\n";
 }
 
 /** prints a prediction for product & type price according to last 5 timesteps*/
-void AdvisorBotMain::handlePredict(std::vector<std::string> input)
+void AdvisorBotMain::handlePredict(const std::vector<std::string>& input)
 {
-    if (input.size() == 4) {
+    if (input.size() == 4 || input.size() == 5) {
         int timesteps = 5;
 
+        // handle model, the percentile one is the default
+        PredictionModel model = PredictionModel::percentile;
+        if (input.size() == 5 && !PriceModels::stringToModel(input[4], model)) {
+            *output << "model is invalid. valid models are: percentile/ ewma/ trend/ vwap" << "\n";
+            return;
+        }
+
         // handle bookType
         OrderBookType bookType = OrderBookEntry::stringToOrderBookType(input[3]);
         if (bookType == OrderBookType::unknown) {
-            std::cout << "book type is invalid. valid types are: ask/ bid" << std::endl;
+            *output << "book type is invalid. valid types are: ask/ bid" << "\n";
             return;
-        } else {
+        } else if (model == PredictionModel::percentile) {
             // make prediction according to the other bookType
             if (bookType == OrderBookType::ask) {
                 bookType = OrderBookType::bid;
@@ -261,22 +574,36 @@ void AdvisorBotMain::handlePredict(std::vector<std::string> input)
 
         // handle product input
         std::string product = input[2];
-        if (!orderBook.isProductInTimestamp(product, currentTime, bookType, timesteps)) { // did the product appear in the last 10 timesteps
-            std::cout << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " not found in the last " << timesteps << " timestamps" << std::endl;
+        if (!orderBook->isProductInTimestamp(product, currentTime, bookType, timesteps)) { // did the product appear in the last 10 timesteps
+            *output << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " not found in the last " << timesteps << " timestamps" << "\n";
             return;
         }
 
         // read max/min
         std::string requestedOperator = input[1];
         if (requestedOperator != "min" && requestedOperator != "max") {
-            std::cout << "operator is invalid. valid types are: min/ max" << std::endl;
+            *output << "operator is invalid. valid types are: min/ max" << "\n";
             return;
         }
 
-        // calc prediction
-        double prediction = orderBook.calcProductPrediction(product, currentTime, timesteps, bookType, requestedOperator);
+        // calc prediction, the maintained models answer in constant time and aren't worth caching
+        double prediction;
+        if (model == PredictionModel::percentile) {
+            std::string cacheKey = QueryCache::makeKey("predict " + requestedOperator, product, bookType, currentTime, std::to_string(timesteps));
+            unsigned long version = orderBook->getProductVersion(product);
+            if (!queryCache.lookup(cacheKey, version, prediction)) {
+                prediction = orderBook->calcProductPrediction(product, currentTime, timesteps, bookType, requestedOperator);
+                queryCache.store(cacheKey, version, prediction);
+            }
+        } else {
+            prediction = orderBook->calcProductPrediction(product, currentTime, timesteps, bookType, requestedOperator, model);
+        }
 
-        std::cout << "The predicted " << OrderBookEntry::bookTypeToString(bookType) << " price for " << product << " is " << prediction << std::endl;
+        if (std::isnan(prediction)) {
+            *output << "Not enough data to predict the " << OrderBookEntry::bookTypeToString(bookType) << " price for " << product << "\n";
+            return;
+        }
+        *output << "The predicted " << OrderBookEntry::bookTypeToString(bookType) << " price for " << product << " is " << prediction << "\n";
     } else {
         printInvalidCommand();
     }
@@ -285,75 +612,362 @@ void AdvisorBotMain::handlePredict(std::vector<std::string> input)
 /** print prediction command help */
 void AdvisorBotMain::printPredict()
 {
-    std::cout << "predict" << "\t\t" << "Predict max or min ask or bid for the sent product for the next time" << std::endl;
-    std::cout << "\t\t" << "usage: predict <max/min> <product> <type>" << std::endl;
-    std::cout << "\t\t" << "example: predict max ETH/BTC ask" << std::endl;
-    std::cout << std::endl;
+    *output << "predict" << "\t\t" << "Predict max or min ask or bid for the sent product for the next time" << "\n";
+    *output << "\t\t" << "usage: predict <max/min> <product> <type> [model]" << "\n";
+    *output << "\t\t" << "example: predict max ETH/BTC ask" << "\n";
+    *output << "\t\t" << "models:  percentile  average of the top/bottom 10% of the other side's prices in the last 5 timestamps (default)" << "\n";
+    *output << "\t\t" << "         the other models read the highest (max) or lowest (min) price of each timestamp of <type>:" << "\n";
+    *output << "\t\t" << "         ewma        their moving average with a span of 5 timestamps" << "\n";
+    *output << "\t\t" << "         trend       the least squares line through them over the last 5 timestamps, one timestamp on" << "\n";
+    *output << "\t\t" << "         vwap        their average over the last 5 timestamps, each weighted by its timestamp's volume" << "\n";
+    *output << "\n";
 }
 
 /** print current time */
 void AdvisorBotMain::handleTime()
 {
-    std::cout << "Current time is: " << currentTime << std::endl;
+    *output << "Current time is: " << currentTime << "\n";
 }
 
 /** print time command help */
 void AdvisorBotMain::printTime()
 {
-    std::cout << "time" << "\t\t" << "State current time in dataset, i.e. which timeframe are we looking at" << std::endl;
-    std::cout << "\t\t" << "usage: time" << std::endl;
-    std::cout << std::endl;
+    *output << "time" << "\t\t" << "State current time in dataset, i.e. which timeframe are we looking at" << "\n";
+    *output << "\t\t" << "usage: time" << "\n";
+    *output << "\n";
 }
 
 /** goes to next time step */
 void AdvisorBotMain::handleStep()
 {
-    std::cout << "Going to next time frame. " << std::endl;
-    currentTime = orderBook.getNextTime(currentTime);
+    *output << "Going to next time frame. " << "\n";
+    currentTime = getNextTime(currentTime);
     handleTime();
 }
 
 /** print step command help */
 void AdvisorBotMain::printStep()
 {
-    std::cout << "step" << "\t\t" << "Move to next time step" << std::endl;
-    std::cout << "\t\t" << "usage: step" << std::endl;
-    std::cout << std::endl;
+    *output << "step" << "\t\t" << "Move to next time step" << "\n";
+    *output << "\t\t" << "usage: step" << "\n";
+    *output << "\n";
+}
+
+/** return whether text is a timestamp or its start, e.g. 2020/03/17 17:05 */
+static bool isTimestampPrefix(const std::string& text)
+{
+    const std::string layout = "0000/00/00 00:00:00.000000";
+    if (text.size() == 0 || text.size() > layout.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < text.size(); ++i)
+    {
+        bool matches = layout[i] == '0' ? std::isdigit((unsigned char) text[i]) != 0 : text[i] == layout[i];
+        if (!matches) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** jumps to a time, or a number of time steps forward or back */
+void AdvisorBotMain::handleGoto(const std::vector<std::string>& input)
+{
+    std::string target = getTargetTime(input, currentTime);
+    if (target == "") {
+        printInvalidCommand();
+        return;
+    }
+    *output << "Going to " << target << "\n";
+    currentTime = target;
+    handleTime();
+}
+
+/** print goto command help */
+void AdvisorBotMain::printGoto()
+{
+    *output << "goto" << "\t\t" << "Jump to the first time step at or after a time, or a number of time steps forward or back" << "\n";
+    *output << "\t\t" << "usage: goto <timestamp>, goto +<n> or goto -<n>" << "\n";
+    *output << "\t\t" << "example: goto 2020/03/17 17:05" << "\n";
+    *output << "\t\t" << "example: goto -10" << "\n";
+    *output << "\n";
+}
+
+/** goes to the previous time step */
+void AdvisorBotMain::handleBack()
+{
+    std::string target = getPreviousTime(currentTime);
+    if (target == "") {
+        *output << "Already at the first time frame" << "\n";
+        return;
+    }
+    *output << "Going to previous time frame. " << "\n";
+    currentTime = target;
+    handleTime();
+}
+
+/** print back command help */
+void AdvisorBotMain::printBack()
+{
+    *output << "back" << "\t\t" << "Move to the previous time step" << "\n";
+    *output << "\t\t" << "usage: back" << "\n";
+    *output << "\n";
+}
+
+/** return the time the step, goto or back command in input moves to from time,
+ * "" if the command is invalid or there is nowhere to move
+ * */
+std::string AdvisorBotMain::getTargetTime(const std::vector<std::string>& input, std::string time)
+{
+    if (input[0] == "step") {
+        return getNextTime(time);
+    }
+    if (input[0] == "back") {
+        return getPreviousTime(time);
+    }
+    if (input[0] != "goto" || input.size() < 2) {
+        return "";
+    }
+
+    // goto +n / goto -n
+    const std::string& argument = input[1];
+    if (input.size() == 2 && argument.size() > 1 && (argument[0] == '+' || argument[0] == '-')) {
+        long steps = 0;
+        std::from_chars_result result = std::from_chars(argument.data() + 1, argument.data() + argument.size(), steps);
+        if (result.ec != std::errc{} || result.ptr != argument.data() + argument.size()) {
+            return "";
+        }
+        return offsetTime(time, argument[0] == '-' ? -steps : steps);
+    }
+
+    // goto <timestamp>, the date and the time arrive as separate tokens
+    std::string timestamp = argument;
+    for (std::size_t i = 2; i < input.size(); ++i)
+    {
+        timestamp += " " + input[i];
+    }
+    if (!isTimestampPrefix(timestamp)) {
+        return "";
+    }
+    return findTime(timestamp);
 }
 
 /** print stats command help */
 void AdvisorBotMain::printStats()
 {
-    std::cout << "stats" << "\t\t" << "Print AdvisorBot stats" << std::endl;
-    std::cout << "\t\t" << "usage: stats" << std::endl;
-    std::cout << std::endl;
+    *output << "stats" << "\t\t" << "Print AdvisorBot stats: command calls, latency percentiles and counters" << "\n";
+    *output << "\t\t" << "usage: stats, or stats json for a machine-readable dump" << "\n";
+    *output << "\n";
 }
 
-/** print stats regarding the AdvisorBot */
-void AdvisorBotMain::handleStats()
+/** print stats regarding the AdvisorBot, as JSON with stats json */
+void AdvisorBotMain::handleStats(const std::vector<std::string>& input)
 {
-    std::cout << "# of commands calls:" << std::endl;
-    for (auto const& command : commandsCounter)
+    if (input.size() == 2 && input[1] == "json") {
+        *output << "{\"commands\":{";
+        bool first = true;
+        for (auto const& command : *commandsCounter)
+        {
+            *output << (first ? "" : ",") << "\"" << command.first << "\":" << command.second;
+            first = false;
+        }
+        std::size_t rows = orderBook->getRowCount();
+        std::size_t bytes = orderBook->getMemoryUsage();
+        *output << "},\"book\":{\"rows\":" << rows << ",\"bytes\":" << bytes
+                << ",\"bytesPerRow\":" << (rows > 0 ? (double) bytes / rows : 0) << "}";
+        *output << ",\"metrics\":";
+        Metrics::global().writeJson(*output);
+        *output << "}" << "\n";
+        return;
+    }
+    if (input.size() != 1) {
+        printInvalidCommand();
+        return;
+    }
+
+    *output << "# of commands calls:" << "\n";
+    for (auto const& command : *commandsCounter)
     {
-        std::cout << command.first << ":" << "\t" << command.second << std::endl;
+        // only list commands that were used
+        if (command.second > 0) {
+            *output << command.first << ":" << "\t" << command.second << "\n";
+        }
     }
+
+    *output << "command latency (us):" << "\t" << "p50" << "\t" << "p90" << "\t" << "p99" << "\t" << "max" << "\t" << "count" << "\n";
+    Metrics::global().printLatencies(*output, "command.");
+    *output << "engine latency (us):" << "\t" << "p50" << "\t" << "p90" << "\t" << "p99" << "\t" << "max" << "\t" << "count" << "\n";
+    Metrics::global().printLatencies(*output, "orderbook.");
+    *output << "counters:" << "\n";
+    Metrics::global().printCounters(*output);
+
+    *output << "book:" << "\n";
+    std::size_t rows = orderBook->getRowCount();
+    std::size_t bytes = orderBook->getMemoryUsage();
+    *output << "rows:" << "\t" << rows << "\n";
+    *output << "bytes:" << "\t" << bytes << "\n";
+    *output << "bytes per row:" << "\t" << (rows > 0 ? (double) bytes / rows : 0) << "\n";
+
+    *output << "query cache:" << "\n";
+    *output << "hits:" << "\t" << queryCache.getHits() << "\n";
+    *output << "misses:" << "\t" << queryCache.getMisses() << "\n";
+}
+
+/** stops reading commands */
+void AdvisorBotMain::handleExit()
+{
+    *output << "Goodbye" << "\n";
+    running = false;
+}
+
+/** print exit command help */
+void AdvisorBotMain::printExit()
+{
+    *output << "exit" << "\t\t" << "Stop the AdvisorBot" << "\n";
+    *output << "\t\t" << "usage: exit" << "\n";
+    *output << "\n";
 }
 
 /** print invalid command text */
 void AdvisorBotMain::printInvalidCommand()
 {
-    std::cout << "Invalid input. type help, to see available commands" << std::endl;
+    *output << "Invalid input. type help, to see available commands" << "\n";
+}
+
+/** handle the min/max/avg variants over a time range: <cmd> <product> <type> <from> <to> */
+void AdvisorBotMain::handleRange(std::string command, const std::vector<std::string>& input)
+{
+    // handle bookType
+    OrderBookType bookType = OrderBookEntry::stringToOrderBookType(input[2]);
+    if (bookType == OrderBookType::unknown) {
+        *output << "book type is invalid. valid types are: ask/ bid" << "\n";
+        return;
+    }
+
+    // timestamps are "<date> <time>", so each one was split into two tokens
+    std::string product = input[1];
+    std::string fromTime = input[3] + " " + input[4];
+    std::string toTime = input[5] + " " + input[6];
+    if (fromTime.compare(0, toTime.size(), toTime) > 0) {
+        *output << "time range is invalid. <from-timestamp> must not be after <to-timestamp>" << "\n";
+        return;
+    }
+
+    std::string cacheKey = QueryCache::makeKey(command, product, bookType, fromTime + "|" + toTime, "");
+    unsigned long version = orderBook->getProductVersion(product);
+    double price;
+    if (!queryCache.lookup(cacheKey, version, price)) {
+        PriceSummary summary = getPriceSummary(product, bookType, fromTime, toTime);
+        if (summary.count == 0) {
+            *output << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " not found between " << fromTime << " and " << toTime << "\n";
+            return;
+        }
+
+        price = summary.avg();
+        if (command == "min") {
+            price = summary.min;
+        } else if (command == "max") {
+            price = summary.max;
+        }
+        queryCache.store(cacheKey, version, price);
+    }
+
+    *output << "The " << command << " " << OrderBookEntry::bookTypeToString(bookType) << " for " << product << " between " << fromTime << " and " << toTime << " is " << price << "\n";
 }
  
+/** returns the earliest time in the dataset */
+std::string AdvisorBotMain::getEarliestTime()
+{
+    if (catalogue) {
+        return catalogue->getEarliestTime();
+    }
+    if (book) {
+        return book->getEarliestTime();
+    }
+    return sharedBook->read().book().getEarliestTime();
+}
+
+/** returns the time after time, wrapping around at the end of the dataset */
+std::string AdvisorBotMain::getNextTime(std::string time)
+{
+    if (catalogue) {
+        return catalogue->getNextTime(time);
+    }
+    if (book) {
+        return book->getNextTime(time);
+    }
+    return sharedBook->read().book().getNextTime(time);
+}
+
+/** returns the time before time, "" at the start of the dataset */
+std::string AdvisorBotMain::getPreviousTime(std::string time)
+{
+    if (catalogue) {
+        return catalogue->getPreviousTime(time);
+    }
+    if (book) {
+        return book->getPreviousTime(time);
+    }
+    return sharedBook->read().book().getPreviousTime(time);
+}
+
+/** returns the first time at or after time, the latest time if there is none */
+std::string AdvisorBotMain::findTime(std::string time)
+{
+    if (catalogue) {
+        return catalogue->findTime(time);
+    }
+    if (book) {
+        return book->findTime(time);
+    }
+    return sharedBook->read().book().findTime(time);
+}
+
+/** returns the time steps time steps after time (before it if negative), stopping at the ends */
+std::string AdvisorBotMain::offsetTime(std::string time, long steps)
+{
+    if (catalogue) {
+        return catalogue->offsetTime(time, steps);
+    }
+    if (book) {
+        return book->offsetTime(time, steps);
+    }
+    return sharedBook->read().book().offsetTime(time, steps);
+}
+
+/** return min/max/sum/count of the product prices with timestamps in [fromTime, toTime] */
+PriceSummary AdvisorBotMain::getPriceSummary(std::string product, OrderBookType type, std::string fromTime, std::string toTime)
+{
+    if (catalogue) {
+        return catalogue->getPriceSummary(product, type, fromTime, toTime);
+    }
+    return orderBook->getPriceSummary(product, type, fromTime, toTime);
+}
+
+/** return min/max/sum/count of the product prices in the current time and the lastTimestamps before it */
+PriceSummary AdvisorBotMain::getWindowSummary(std::string product, OrderBookType type, int lastTimestamps)
+{
+    if (catalogue) {
+        return catalogue->getWindowSummary(product, currentTime, lastTimestamps, type);
+    }
+    return orderBook->getWindowSummary(product, currentTime, lastTimestamps, type);
+}
+
 /** gets input from user, splits them by spaces using tokenizer */
 std::vector<std::string> AdvisorBotMain::getUserInput()
 {
     std::string rawInput;
-    std::getline(std::cin, rawInput);
+    if (!std::getline(std::cin, rawInput)) {
+        // input ended, nothing more to process
+        running = false;
+        return std::vector<std::string>{};
+    }
 
     try {
         // split input by spaces
-        return CSVReader::tokenise(rawInput, ' ');
+        std::vector<std::string> input;
+        tokeniseCommand(rawInput, input);
+        return input;
     } catch (const std::exception& e) {
         printInvalidCommand();
     }
@@ -362,44 +976,88 @@ std::vector<std::string> AdvisorBotMain::getUserInput()
     return emptyArary;
 }
 
+/** split a command line by spaces into input, reusing its storage */
+void AdvisorBotMain::tokeniseCommand(std::string_view line, std::vector<std::string>& input)
+{
+    input.clear();
+    Tokenizer tokenizer{line, ' '};
+    std::string_view token;
+    while (tokenizer.next(token))
+    {
+        input.emplace_back(token);
+    }
+}
+
 /** process user input, calls the right command */
-void AdvisorBotMain::processUserInput(std::vector<std::string> input)
+void AdvisorBotMain::processUserInput(const std::vector<std::string>& input)
 {
     if (input.size() == 0) {
         printInvalidCommand();
         return;
     }
+    TraceScope scope{"AdvisorBotMain::processUserInput", "query", input[0]};
+
+    // the whole command sees one version of the book, even while a writer adds to it.
+    // Over a catalogue it sees the day of the current time, which can't be evicted meanwhile
+    std::optional<ConcurrentOrderBook::ReadGuard> guard;
+    std::shared_ptr<const OrderBook> day;
+    if (catalogue) {
+        day = catalogue->getPartitionFor(currentTime);
+        orderBook = day.get();
+    } else if (book) {
+        orderBook = book.get();
+    } else {
+        guard.emplace(sharedBook->read());
+        orderBook = &guard->book();
+    }
+
+    // time the command, not counting the wait for input
+    auto latency = commandLatencies.find(input[0]);
+    std::optional<ScopedTimer> timer;
+    if (latency != commandLatencies.end()) {
+        timer.emplace(*latency->second);
+    }
 
-    std::cout << std::endl;
+    *output << "\n";
     if (input[0] == "help") {
-        commandsCounter["help"] ++;
+        commandsCounter->at("help") ++;
         handleHelp(input);
     } else if (input[0] == "prod") {
-        commandsCounter["prod"] ++;
+        commandsCounter->at("prod") ++;
         handleProd();
     } else if (input[0] == "min") {
-        commandsCounter["min"] ++;
+        commandsCounter->at("min") ++;
         handleMin(input);
     } else if (input[0] == "max") {
-        commandsCounter["max"] ++;
+        commandsCounter->at("max") ++;
         handleMax(input);
     } else if (input[0] == "avg") {
-        commandsCounter["avg"] ++;
+        commandsCounter->at("avg") ++;
         handleAvg(input);
     } else if (input[0] == "predict") {
-        commandsCounter["predict"] ++;
+        commandsCounter->at("predict") ++;
         handlePredict(input);
     } else if (input[0] == "time") {
-        commandsCounter["time"] ++;
+        commandsCounter->at("time") ++;
         handleTime();
     } else if (input[0] == "step") {
-        commandsCounter["step"] ++;
+        commandsCounter->at("step") ++;
         handleStep();
+    } else if (input[0] == "goto") {
+        commandsCounter->at("goto") ++;
+        handleGoto(input);
+    } else if (input[0] == "back") {
+        commandsCounter->at("back") ++;
+        handleBack();
     } else if (input[0] == "stats") {
-        commandsCounter["stats"] ++;
-        handleStats();
+        commandsCounter->at("stats") ++;
+        handleStats(input);
+    } else if (input[0] == "exit") {
+        commandsCounter->at("exit") ++;
+        handleExit();
     } else {
         printInvalidCommand();
     }
-    std::cout << std::endl;
+    *output << "\n";
+    orderBook = nullptr;
 }
@@ -1,20 +1,59 @@
 #pragma once
 
 #include <vector>
+#include <string_view>
 #include <map>
 #include <functional>
+#include <iostream>
+#include <memory>
+#include <atomic>
 #include "OrderBookEntry.h"
 #include "OrderBook.h"
+#include "ConcurrentOrderBook.h"
+#include "DayCatalogue.h"
 #include "Wallet.h"
+#include "QueryCache.h"
+#include "Metrics.h"
 
 
+/** per command call counters, safe to increment from several threads.
+ * Made by AdvisorBotMain::makeCommandCounters with every command in it, the sessions only look them up
+ * */
+typedef std::map<std::string, std::atomic<unsigned long>> CommandCounters;
+
 class AdvisorBotMain
 {
     public:
         AdvisorBotMain();
+        /** construct a session over an already loaded order book nobody writes to, sharing the command counters */
+        AdvisorBotMain(std::shared_ptr<const OrderBook> book, std::shared_ptr<CommandCounters> commandsCounter);
+        /** construct a session over an already loaded order book, sharing the command counters.
+         * The book may be written to by another thread while the session runs
+         * */
+        AdvisorBotMain(std::shared_ptr<ConcurrentOrderBook> sharedBook, std::shared_ptr<CommandCounters> commandsCounter);
+        /** construct a session over a multi-day dataset, days are loaded as the session reaches them */
+        AdvisorBotMain(std::shared_ptr<DayCatalogue> catalogue, std::shared_ptr<CommandCounters> commandsCounter);
+        /** return counters for every command, to be shared by the sessions */
+        static std::shared_ptr<CommandCounters> makeCommandCounters();
         /** init function */
         void init();
+        /** runs every command read from commands until EOF, writing the results to results.
+         * format is text, csv or json (one json object per line).
+         * With threads > 1 the queries run concurrently and results are still written in input order
+         * */
+        void runBatch(std::istream& commands, std::ostream& results, std::string format, unsigned int threads = 1);
+        /** runs one command line and returns its output, without the blank lines framing it */
+        std::string runCommand(std::string line);
+        /** return false once exit was requested */
+        bool isRunning() const;
     private: 
+        /** construct a session over a book, a shared book or a catalogue, the other two are nullptr */
+        AdvisorBotMain(std::shared_ptr<const OrderBook> book, std::shared_ptr<ConcurrentOrderBook> sharedBook, std::shared_ptr<DayCatalogue> catalogue, std::shared_ptr<CommandCounters> commandsCounter);
+        /** runs the batch on a pool of worker sessions sharing the read-only order book.
+         * Appends the results to buffer in input order, returns the amount of commands run.
+         * */
+        unsigned long runBatchParallel(std::istream& commands, std::ostream& results, std::string format, unsigned int threads, std::string& buffer);
+
         /** Print title*/
         void printTitle();
         
@@ -22,7 +61,7 @@ class AdvisorBotMain
 
         // help
         /** handle help command*/
-        void handleHelp(std::vector<std::string> input);
+        void handleHelp(const std::vector<std::string>& input);
         /** handle help command with arguments*/
         void handleHelp(std::string command);
         /** print help */
@@ -36,25 +75,25 @@ class AdvisorBotMain
 
         // min
         /** print minimum price for product of specific type (bid/ask) */
-        void handleMin(std::vector<std::string> input);
+        void handleMin(const std::vector<std::string>& input);
         /** print min command help*/
         void printMin();
 
         // max
         /** print maximum price for product of specific type (bid/ask) */
-        void handleMax(std::vector<std::string> input);
+        void handleMax(const std::vector<std::string>& input);
         /** print max command help*/
         void printMax();
 
         // avg
         /** print avg price for product of specific type (bid/ask) in requested amount of timestemps*/
-        void handleAvg(std::vector<std::string> input);
+        void handleAvg(const std::vector<std::string>& input);
         /** print avg command help*/
         void printAvg();
 
         // predict
         /** prints a prediction for product & type price according to last 5 timesteps*/
-        void handlePredict(std::vector<std::string> input);
+        void handlePredict(const std::vector<std::string>& input);
         /** print prediction command help */
         void printPredict();
 
@@ -70,28 +109,82 @@ class AdvisorBotMain
         /** print step command help */
         void printStep();
 
+        // goto / back
+        /** jumps to a time, or a number of time steps forward or back */
+        void handleGoto(const std::vector<std::string>& input);
+        /** print goto command help */
+        void printGoto();
+        /** goes to the previous time step */
+        void handleBack();
+        /** print back command help */
+        void printBack();
+        /** return the time the step, goto or back command in input moves to from time,
+         * "" if the command is invalid or there is nowhere to move
+         * */
+        std::string getTargetTime(const std::vector<std::string>& input, std::string time);
+
         // stats
         /** print stats command help */
         void printStats();
-        /** print stats regarding the AdvisorBot */
-        void handleStats();
+        /** print stats regarding the AdvisorBot, as JSON with stats json */
+        void handleStats(const std::vector<std::string>& input);
+
+        // exit
+        /** stops reading commands */
+        void handleExit();
+        /** print exit command help */
+        void printExit();
 
         // common
         /** print invalid command text */
         void printInvalidCommand();
+        /** handle the min/max/avg variants over a time range: <cmd> <product> <type> <from> <to> */
+        void handleRange(std::string command, const std::vector<std::string>& input);
+
+        // dataset, from the book or the catalogue
+        /** returns the earliest time in the dataset */
+        std::string getEarliestTime();
+        /** returns the time after time, wrapping around at the end of the dataset */
+        std::string getNextTime(std::string time);
+        /** returns the time before time, "" at the start of the dataset */
+        std::string getPreviousTime(std::string time);
+        /** returns the first time at or after time, the latest time if there is none */
+        std::string findTime(std::string time);
+        /** returns the time steps time steps after time (before it if negative), stopping at the ends */
+        std::string offsetTime(std::string time, long steps);
+        /** return min/max/sum/count of the product prices with timestamps in [fromTime, toTime] */
+        PriceSummary getPriceSummary(std::string product, OrderBookType type, std::string fromTime, std::string toTime);
+        /** return min/max/sum/count of the product prices in the current time and the lastTimestamps before it */
+        PriceSummary getWindowSummary(std::string product, OrderBookType type, int lastTimestamps);
 
         // user input
         /** gets input from user, splits them by spaces using tokenizer */
         std::vector<std::string> getUserInput();
+        /** split a command line by spaces into input, reusing its storage */
+        static void tokeniseCommand(std::string_view line, std::vector<std::string>& input);
         /** process user input, calls the right command */
-        void processUserInput(std::vector<std::string> input);
+        void processUserInput(const std::vector<std::string>& input);
 
 
         // properties
         // stores current time
         std::string currentTime;
-        // stores order book
-        OrderBook orderBook{"20200317.csv"};
-        // stores commands counter
-        std::map<std::string, int> commandsCounter;
+        // stores order book when nobody writes to it, shared with other sessions
+        std::shared_ptr<const OrderBook> book;
+        // stores order book, shared with other sessions and possibly a writer
+        std::shared_ptr<ConcurrentOrderBook> sharedBook;
+        // stores the days of a multi-day dataset, nullptr when running over a book
+        std::shared_ptr<DayCatalogue> catalogue;
+        // the version of the book (or the day) pinned for the command being processed
+        const OrderBook* orderBook;
+        // stores commands counter, shared with other sessions
+        std::shared_ptr<CommandCounters> commandsCounter;
+        // latency of every command, process wide (see Metrics)
+        std::map<std::string, LatencyHistogram*> commandLatencies;
+        // stores results of min/max/avg/predict queries
+        QueryCache queryCache;
+        // where command results are written to
+        std::ostream* output;
+        // false once exit was requested or the input ended
+        bool running;
 };
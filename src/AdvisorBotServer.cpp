@@ -0,0 +1,326 @@
+#include "AdvisorBotServer.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <charconv>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// stop reading from a client while this much output is still unsent
+static const std::size_t maxPendingOutput = 4 << 20;
+// a client sending this much without a newline is closed rather than buffered without bound
+static const std::size_t maxLineBytes = 64 * 1024;
+
+/** switch fd to non-blocking mode */
+static bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+AdvisorBotServer::AdvisorBotServer(std::shared_ptr<ConcurrentOrderBook> _book, std::shared_ptr<CommandCounters> _commandsCounter)
+: book(_book), commandsCounter(_commandsCounter), listenFd(-1), epollFd(-1), running(false)
+{
+
+}
+
+AdvisorBotServer::~AdvisorBotServer()
+{
+    for (auto& connection : connections)
+    {
+        close(connection.first);
+    }
+    if (listenFd >= 0) close(listenFd);
+    if (epollFd >= 0) close(epollFd);
+    if (socketPath != "") unlink(socketPath.c_str());
+}
+
+/** listen on localhost if address is a port number, otherwise on a unix socket at that path */
+bool AdvisorBotServer::listen(std::string address)
+{
+    bool isPort = address.size() > 0 && address.find_first_not_of("0123456789") == std::string::npos;
+    if (isPort) {
+        unsigned long port = 0;
+        std::from_chars_result result = std::from_chars(address.data(), address.data() + address.size(), port);
+        if (result.ec != std::errc{} || port == 0 || port > 65535) {
+            std::cerr << "AdvisorBotServer::listen port out of range " << address << std::endl;
+            return false;
+        }
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((unsigned short) port);
+        if (listenFd < 0 || bind(listenFd, (sockaddr*) &addr, sizeof(addr)) != 0) {
+            std::cerr << "AdvisorBotServer::listen cannot bind port " << address << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+    } else {
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (address.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "AdvisorBotServer::listen socket path too long " << address << std::endl;
+            return false;
+        }
+        std::strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+        // a stale socket file from an earlier run would make bind fail
+        unlink(address.c_str());
+        if (listenFd < 0 || bind(listenFd, (sockaddr*) &addr, sizeof(addr)) != 0) {
+            std::cerr << "AdvisorBotServer::listen cannot bind " << address << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        socketPath = address;
+    }
+
+    if (::listen(listenFd, SOMAXCONN) != 0 || !setNonBlocking(listenFd)) {
+        std::cerr << "AdvisorBotServer::listen cannot listen: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    epollFd = epoll_create1(0);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) != 0) {
+        std::cerr << "AdvisorBotServer::listen epoll setup failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    std::cerr << "AdvisorBotServer listening on " << address << std::endl;
+    return true;
+}
+
+/** serve clients until stop is called */
+void AdvisorBotServer::run()
+{
+    const int maxEvents = 256;
+    epoll_event events[maxEvents];
+    running = true;
+    while (running)
+    {
+        // wake up now and then to notice stop()
+        int ready = epoll_wait(epollFd, events, maxEvents, 200);
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "AdvisorBotServer::run epoll_wait failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < ready; ++i)
+        {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                acceptConnections();
+                continue;
+            }
+            auto it = connections.find(fd);
+            if (it == connections.end()) {
+                continue;
+            }
+            Connection& connection = *it->second;
+            bool open = true;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                open = false;
+            }
+            if (open && (events[i].events & EPOLLIN)) {
+                open = readFrom(connection);
+            }
+            if (open && (events[i].events & EPOLLOUT)) {
+                open = writeTo(connection);
+                // output drained, lines held back by the output limit can go now
+                if (open && connection.output.size() - connection.written < maxPendingOutput) {
+                    open = answerLines(connection);
+                }
+            }
+            if (open && !connection.session->isRunning() && connection.written == connection.output.size()) {
+                // exit was answered and sent
+                open = false;
+            }
+            if (open) {
+                updateInterest(connection);
+            } else {
+                closeConnection(fd);
+            }
+        }
+    }
+}
+
+/** make run return, safe to call from another thread */
+void AdvisorBotServer::stop()
+{
+    running = false;
+}
+
+/** accept every pending connection */
+void AdvisorBotServer::acceptConnections()
+{
+    while (true)
+    {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            // EAGAIN: no more pending connections
+            return;
+        }
+        setNonBlocking(fd);
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        std::unique_ptr<Connection> connection{new Connection{fd, "", "", 0, EPOLLIN | EPOLLRDHUP, nullptr}};
+        connection->session.reset(new AdvisorBotMain{book, commandsCounter});
+
+        epoll_event event{};
+        event.events = connection->events;
+        event.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            continue;
+        }
+        connections[fd] = std::move(connection);
+    }
+}
+
+/** read what the client sent and answer every complete line, false if the connection is done */
+bool AdvisorBotServer::readFrom(Connection& connection)
+{
+    char buffer[64 * 1024];
+    bool peerClosed = false;
+    while (connection.output.size() - connection.written < maxPendingOutput)
+    {
+        ssize_t received = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            connection.input.append(buffer, received);
+            if (connection.input.size() > maxLineBytes && connection.input.find('\n') > maxLineBytes) {
+                return false;
+            }
+            continue;
+        }
+        if (received == 0) {
+            peerClosed = true;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            return false;
+        }
+        break;
+    }
+
+    if (!answerLines(connection)) {
+        return false;
+    }
+    // a client that half closed still gets the answers to what it sent
+    return !peerClosed || connection.written < connection.output.size();
+}
+
+/** answer the complete lines in the input buffer */
+void AdvisorBotServer::processLines(Connection& connection)
+{
+    std::size_t start = 0;
+    std::size_t end;
+    while (connection.session->isRunning()
+           && connection.output.size() - connection.written < maxPendingOutput
+           && (end = connection.input.find('\n', start)) != std::string::npos)
+    {
+        std::string line = connection.input.substr(start, end - start);
+        start = end + 1;
+        if (line.size() > 0 && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        std::string text = connection.session->runCommand(line);
+        // dot stuffing, then the terminating "." line
+        std::size_t lineStart = 0;
+        while (lineStart < text.size())
+        {
+            std::size_t lineEnd = text.find('\n', lineStart);
+            if (lineEnd == std::string::npos) lineEnd = text.size();
+            if (text[lineStart] == '.') connection.output += '.';
+            connection.output.append(text, lineStart, lineEnd - lineStart);
+            connection.output += '\n';
+            lineStart = lineEnd + 1;
+        }
+        connection.output += ".\n";
+    }
+    connection.input.erase(0, start);
+
+    // don't let sent output pile up at the front of the buffer
+    if (connection.written > 0 && connection.written == connection.output.size()) {
+        connection.output.clear();
+        connection.written = 0;
+    }
+}
+
+/** answer the complete lines in the input buffer and send the answers, false on error */
+bool AdvisorBotServer::answerLines(Connection& connection)
+{
+    // if the socket took everything, nothing wakes us for the lines held back by the output limit
+    do
+    {
+        processLines(connection);
+        if (!writeTo(connection)) {
+            return false;
+        }
+    } while (connection.session->isRunning()
+             && connection.output.size() == 0
+             && connection.input.find('\n') != std::string::npos);
+    return true;
+}
+
+/** send as much pending output as the socket takes, false on error */
+bool AdvisorBotServer::writeTo(Connection& connection)
+{
+    while (connection.written < connection.output.size())
+    {
+        ssize_t sent = send(connection.fd,
+                            connection.output.data() + connection.written,
+                            connection.output.size() - connection.written,
+                            MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        connection.written += sent;
+    }
+    if (connection.written == connection.output.size()) {
+        connection.output.clear();
+        connection.written = 0;
+    }
+    return true;
+}
+
+/** ask epoll for EPOLLOUT only while output is pending, and for EPOLLIN only while the
+ * output is below the limit
+ * */
+void AdvisorBotServer::updateInterest(Connection& connection)
+{
+    bool pending = connection.written < connection.output.size();
+    // readFrom doesn't read past the output limit, epoll would report the unread input over and over
+    bool throttled = connection.output.size() - connection.written >= maxPendingOutput;
+    std::uint32_t events = pending ? (std::uint32_t) EPOLLOUT : 0;
+    if (!throttled) {
+        events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (events == connection.events) {
+        return;
+    }
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = connection.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.events = events;
+}
+
+void AdvisorBotServer::closeConnection(int fd)
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include "AdvisorBotMain.h"
+#include "ConcurrentOrderBook.h"
+
+/** serves AdvisorBot commands to many clients over a unix domain socket
+ * or a localhost tcp port, from one epoll event loop over one loaded book.
+ *
+ * Protocol: a request is one command line. The response is the command
+ * output followed by a line with a single "."; output lines starting with
+ * "." are sent with an extra "." in front. Clients may pipeline requests,
+ * responses come back in request order. Every connection is its own
+ * session with its own current time, "exit" closes the connection. A line
+ * longer than 64 KiB closes it too.
+ */
+class AdvisorBotServer
+{
+    public:
+        AdvisorBotServer(std::shared_ptr<ConcurrentOrderBook> book, std::shared_ptr<CommandCounters> commandsCounter);
+        ~AdvisorBotServer();
+        /** listen on localhost if address is a port number, otherwise on a unix socket at that path */
+        bool listen(std::string address);
+        /** serve clients until stop is called */
+        void run();
+        /** make run return, safe to call from another thread */
+        void stop();
+
+    private:
+        struct Connection
+        {
+            int fd;
+            // bytes received that don't form a whole line yet
+            std::string input;
+            // responses not yet sent, from written onwards
+            std::string output;
+            std::size_t written;
+            // the events epoll waits for
+            std::uint32_t events;
+            std::unique_ptr<AdvisorBotMain> session;
+        };
+
+        /** accept every pending connection */
+        void acceptConnections();
+        /** read what the client sent and answer every complete line, false if the connection is done
+         * or sent a line too long to buffer
+         * */
+        bool readFrom(Connection& connection);
+        /** answer the complete lines in the input buffer */
+        void processLines(Connection& connection);
+        /** answer the complete lines in the input buffer and send the answers, false on error */
+        bool answerLines(Connection& connection);
+        /** send as much pending output as the socket takes, false on error */
+        bool writeTo(Connection& connection);
+        /** ask epoll for EPOLLOUT only while output is pending, and for EPOLLIN only while the
+         * output is below the limit
+         * */
+        void updateInterest(Connection& connection);
+        void closeConnection(int fd);
+
+        std::shared_ptr<ConcurrentOrderBook> book;
+        std::shared_ptr<CommandCounters> commandsCounter;
+        int listenFd;
+        int epollFd;
+        // path of the unix socket, removed again on shutdown
+        std::string socketPath;
+        std::atomic<bool> running;
+        std::unordered_map<int, std::unique_ptr<Connection>> connections;
+};
@@ -0,0 +1,44 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// allocations are counted on 16 cache line sized stripes, threads spread over them
+struct alignas(64) AllocationStripe
+{
+    std::atomic<unsigned long> count{0};
+};
+static AllocationStripe allocationStripes[16];
+static std::atomic<unsigned int> nextStripe{0};
+
+// operator new[] and the nothrow forms call this one, operator delete[] calls the delete below
+void* operator new(std::size_t size)
+{
+    static thread_local unsigned int stripe = nextStripe.fetch_add(1, std::memory_order_relaxed) % 16;
+    allocationStripes[stripe].count.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size > 0 ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+/** return the amount of allocations made by the process so far */
+unsigned long AllocationCounter::getAllocations()
+{
+    unsigned long allocations = 0;
+    for (const AllocationStripe& stripe : allocationStripes)
+    {
+        allocations += stripe.count.load(std::memory_order_relaxed);
+    }
+    return allocations;
+}
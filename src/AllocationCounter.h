@@ -0,0 +1,16 @@
+#pragma once
+
+/** counts the allocations of the whole process.
+ *
+ * AllocationCounter.cpp replaces the global operator new and delete with a counted
+ * malloc and free. Both halves of the pair live in that file on their own, so every
+ * new in the program is matched by a delete of the same allocator. Threads count on
+ * separate cache lines, so counting doesn't make them contend. Allocations with an
+ * extended alignment go through the library's aligned operator new and aren't counted
+ */
+class AllocationCounter
+{
+    public:
+        /** return the amount of allocations made by the process so far */
+        static unsigned long getAllocations();
+};
@@ -0,0 +1,89 @@
+#include "Arena.h"
+#include <cstring>
+#include <algorithm>
+#include <utility>
+
+// size of the first slab
+static const std::size_t minimumSlabSize = 4096;
+
+Arena::Arena(std::size_t _slabSize)
+: slabSize(_slabSize), next(nullptr), end(nullptr), bytesUsed(0), bytesReserved(0)
+{
+
+}
+
+/** take over other's slabs, other is left empty */
+Arena::Arena(Arena&& other)
+: slabSize(other.slabSize),
+  slabs(std::move(other.slabs)),
+  next(std::exchange(other.next, nullptr)),
+  end(std::exchange(other.end, nullptr)),
+  bytesUsed(std::exchange(other.bytesUsed, 0)),
+  bytesReserved(std::exchange(other.bytesReserved, 0))
+{
+
+}
+
+Arena& Arena::operator=(Arena&& other)
+{
+    if (this != &other) {
+        slabSize = other.slabSize;
+        slabs = std::move(other.slabs);
+        other.slabs.clear();
+        next = std::exchange(other.next, nullptr);
+        end = std::exchange(other.end, nullptr);
+        bytesUsed = std::exchange(other.bytesUsed, 0);
+        bytesReserved = std::exchange(other.bytesReserved, 0);
+    }
+    return *this;
+}
+
+/** return bytes of memory aligned to alignment, valid until release() */
+void* Arena::allocate(std::size_t bytes, std::size_t alignment)
+{
+    std::size_t padding = next == nullptr ? 0 : (alignment - (std::size_t) next % alignment) % alignment;
+    if (next == nullptr || padding + bytes > (std::size_t) (end - next)) {
+        // slabs start small and double up to slabSize, so small datasets hold little memory.
+        // Allocations bigger than that get a slab of their own
+        std::size_t size = std::max(std::min(slabSize, minimumSlabSize << std::min(slabs.size(), (std::size_t) 16)), bytes + alignment);
+        slabs.emplace_back(new char[size]);
+        next = slabs.back().get();
+        end = next + size;
+        bytesReserved += size;
+        padding = (alignment - (std::size_t) next % alignment) % alignment;
+    }
+    char* allocation = next + padding;
+    next = allocation + bytes;
+    bytesUsed += bytes;
+    return allocation;
+}
+
+/** return a copy of text held by the arena */
+std::string_view Arena::copy(std::string_view text)
+{
+    char* copied = (char*) allocate(text.size(), 1);
+    std::memcpy(copied, text.data(), text.size());
+    return std::string_view{copied, text.size()};
+}
+
+/** free everything allocated so far */
+void Arena::release()
+{
+    slabs.clear();
+    next = nullptr;
+    end = nullptr;
+    bytesUsed = 0;
+    bytesReserved = 0;
+}
+
+/** return the bytes handed out */
+std::size_t Arena::getBytesUsed() const
+{
+    return bytesUsed;
+}
+
+/** return the bytes held in slabs, used or not */
+std::size_t Arena::getBytesReserved() const
+{
+    return bytesReserved;
+}
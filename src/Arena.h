@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/** allocates memory in large slabs that are only released all at once.
+ * Allocating is a pointer bump, releasing drops a handful of slabs however
+ * many allocations were made. Memory handed out stays where it is until release(),
+ * also when the arena is moved
+ */
+class Arena
+{
+    public:
+        /** slabs grow from 4 KiB up to _slabSize */
+        Arena(std::size_t _slabSize = 1 << 20);
+        /** take over other's slabs, other is left empty */
+        Arena(Arena&& other);
+        Arena& operator=(Arena&& other);
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        /** return bytes of memory aligned to alignment, valid until release() */
+        void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t));
+        /** return a copy of text held by the arena */
+        std::string_view copy(std::string_view text);
+        /** free everything allocated so far */
+        void release();
+
+        /** return the bytes handed out */
+        std::size_t getBytesUsed() const;
+        /** return the bytes held in slabs, used or not */
+        std::size_t getBytesReserved() const;
+
+    private:
+        std::size_t slabSize;
+        std::vector<std::unique_ptr<char[]>> slabs;
+        // free space of the last slab
+        char* next;
+        char* end;
+        std::size_t bytesUsed;
+        std::size_t bytesReserved;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+/** the integer and double encodings shared by the binary file formats,
+ * see OrderArchive and SimulationCheckpoint. Values are appended to and read
+ * from a std::string holding the whole file
+ */
+namespace BinaryCodec
+{
+    /** appends an unsigned LEB128 varint */
+    inline void putVarint(std::string& out, std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += (char) ((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += (char) value;
+    }
+
+    /** reads an unsigned LEB128 varint, pos moves past it */
+    inline std::uint64_t getVarint(const std::string& in, std::size_t& pos)
+    {
+        std::uint64_t value = 0;
+        for (int shift = 0; pos < in.size() && shift < 64; shift += 7)
+        {
+            unsigned char byte = in[pos++];
+            value |= (std::uint64_t) (byte & 0x7f) << shift;
+            if (byte < 0x80) {
+                return value;
+            }
+        }
+        throw std::runtime_error{"truncated varint"};
+    }
+
+    /** signed deltas are zigzag encoded so small negative values stay small */
+    inline std::uint64_t zigzag(std::int64_t value)
+    {
+        return ((std::uint64_t) value << 1) ^ (std::uint64_t) (value >> 63);
+    }
+
+    inline std::int64_t unzigzag(std::uint64_t value)
+    {
+        return (std::int64_t) (value >> 1) ^ -(std::int64_t) (value & 1);
+    }
+
+    /** appends a little endian fixed size value */
+    inline void putFixed(std::string& out, std::uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; ++i)
+        {
+            out += (char) ((value >> (8 * i)) & 0xff);
+        }
+    }
+
+    inline std::uint64_t getFixed(const std::string& in, std::size_t pos, int bytes)
+    {
+        std::uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i)
+        {
+            value |= (std::uint64_t) (unsigned char) in[pos + i] << (8 * i);
+        }
+        return value;
+    }
+
+    inline std::uint64_t doubleToBits(double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof bits);
+        return bits;
+    }
+
+    inline double bitsToDouble(std::uint64_t bits)
+    {
+        double value;
+        std::memcpy(&value, &bits, sizeof value);
+        return value;
+    }
+}
@@ -1,7 +1,28 @@
 #include "CSVReader.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include "Trace.h"
+#include "Tokenizer.h"
+#include <charconv>
+#include <cctype>
+#include <stdexcept>
+#include <cmath>
 
+/** put the fields of tokenizer into tokens, at most maxTokens of them, returning how many there were */
+static std::size_t collectTokens(Tokenizer& tokenizer, std::string_view* tokens, std::size_t maxTokens)
+{
+    std::string_view token;
+    std::size_t count = 0;
+    while (tokenizer.next(token))
+    {
+        if (count < maxTokens) {
+            tokens[count] = token;
+        }
+        count++;
+    }
+    return count;
+}
 
 CSVReader::CSVReader()
 {
@@ -9,97 +30,139 @@ CSVReader::CSVReader()
 }
 
 std::vector<OrderBookEntry> CSVReader::readCSV(std::string csvFilename)
+{
+    LoadReport report;
+    std::vector<OrderBookEntry> entries = readCSV(csvFilename, report);
+    std::cout << "CSVReader::readCSV read " << entries.size() << " entries"  << std::endl;
+    if (report.getRejected() > 0) {
+        report.print(std::cout);
+    }
+    return entries; 
+}
+
+/** read the valid rows of a csv file, counting the rejected ones in report */
+std::vector<OrderBookEntry> CSVReader::readCSV(std::string csvFilename, LoadReport& report)
 {
     std::vector<OrderBookEntry> entries;
 
-    std::ifstream csvFile{csvFilename};
-    std::string line;
-    if (csvFile.is_open())
+    TraceScope scope{"CSVReader::readCSV", "ingest", csvFilename};
+    // read the whole file before parsing it, so a trace shows the two apart
+    std::string contents;
     {
-        while(std::getline(csvFile, line))
-        {
-            try {
-                OrderBookEntry obe = stringsToOBE(tokenise(line, ','));
-                entries.push_back(obe);
-            }catch(const std::exception& e)
-            {
-                std::cout << "CSVReader::readCSV bad data"  << std::endl;
-            }
-        }// end of while
-    }    
+        TraceScope ioScope{"CSVReader::readCSV io", "ingest"};
+        std::ifstream csvFile{csvFilename, std::ios::binary};
+        if (csvFile.is_open()) {
+            std::stringstream buffer;
+            buffer << csvFile.rdbuf();
+            contents = buffer.str();
+        }
+    }
+
+    TraceScope parseScope{"CSVReader::readCSV parse", "ingest"};
+    std::string_view tokens[rowTokens];
+    std::size_t lineStart = 0;
+    unsigned long lineNumber = 0;
+    while (lineStart < contents.size())
+    {
+        std::size_t lineEnd = contents.find('\n', lineStart);
+        if (lineEnd == std::string::npos) lineEnd = contents.size();
+        std::size_t lineLength = lineEnd - lineStart;
+        if (lineLength > 0 && contents[lineEnd - 1] == '\r') lineLength--;
+        // the line is a part of contents, which its quoted fields may be unescaped in
+        Tokenizer tokenizer{&contents[lineStart], lineLength, ','};
+        lineStart = lineEnd + 1;
+        lineNumber++;
+
+        // bad rows are common in feeds, so they are counted rather than thrown
+        RowError error = parseRow(tokens, collectTokens(tokenizer, tokens, rowTokens), entries);
+        if (error == RowError::none) {
+            report.addRows();
+        } else {
+            report.addError(error, lineNumber);
+        }
+    }// end of while
 
-    std::cout << "CSVReader::readCSV read " << entries.size() << " entries"  << std::endl;
     return entries; 
 }
 
-std::vector<std::string> CSVReader::tokenise(std::string csvLine, char separator)
+/** split line into at most maxTokens tokens without allocating, see Tokenizer.
+ * Returns the amount of tokens in the line, which is more than maxTokens if they didn't all fit
+ * */
+std::size_t CSVReader::tokenise(std::string_view line, char separator, std::string_view* tokens, std::size_t maxTokens)
 {
-   std::vector<std::string> tokens;
-   signed int start, end;
-   std::string token;
-    start = csvLine.find_first_not_of(separator, 0);
-    do{
-        end = csvLine.find_first_of(separator, start);
-        if (start == csvLine.length() || start == end) break;
-        if (end >= 0) token = csvLine.substr(start, end - start);
-        else token = csvLine.substr(start, csvLine.length() - start);
-        tokens.push_back(token);
-    start = end + 1;
-    }while(end > 0);
+    Tokenizer tokenizer{line, separator};
+    return collectTokens(tokenizer, tokens, maxTokens);
+}
 
-   return tokens; 
+/** as above, making doubled quotes in quoted fields single in place */
+std::size_t CSVReader::tokenise(std::string& line, char separator, std::string_view* tokens, std::size_t maxTokens)
+{
+    Tokenizer tokenizer{line, separator};
+    return collectTokens(tokenizer, tokens, maxTokens);
 }
 
-OrderBookEntry CSVReader::stringsToOBE(std::vector<std::string> tokens)
+/** check the tokens of a csv row and add it to orders, or return what is wrong with it */
+RowError CSVReader::parseRow(const std::string_view* tokens, std::size_t count, std::vector<OrderBookEntry>& orders)
 {
+    if (count != rowTokens) {
+        return RowError::fieldCount;
+    }
     double price, amount;
-
-    if (tokens.size() != 5) // bad
-    {
-        std::cout << "Bad line " << std::endl;
-        throw std::exception{};
+    if (!parseDouble(tokens[3], price)) {
+        return RowError::badPrice;
     }
-    // we have 5 tokens
-    try {
-         price = std::stod(tokens[3]);
-         amount = std::stod(tokens[4]);
-    }catch(const std::exception& e){
-        std::cout << "CSVReader::stringsToOBE Bad float! " << tokens[3]<< std::endl;
-        std::cout << "CSVReader::stringsToOBE Bad float! " << tokens[4]<< std::endl; 
-        throw;        
+    if (!parseDouble(tokens[4], amount)) {
+        return RowError::badAmount;
     }
-
-    OrderBookEntry obe{price, 
-                        amount, 
-                        tokens[0],
-                        tokens[1], 
-                        OrderBookEntry::stringToOrderBookType(tokens[2])};
-
-    return obe; 
+    OrderBookType orderType = OrderBookEntry::stringToOrderBookType(tokens[2]);
+    if (orderType == OrderBookType::unknown) {
+        return RowError::unknownSide;
+    }
+    orders.emplace_back(price, amount, std::string{tokens[0]}, std::string{tokens[1]}, orderType);
+    return RowError::none;
 }
 
 
-OrderBookEntry CSVReader::stringsToOBE(std::string priceString, 
-                                    std::string amountString, 
-                                    std::string timestamp, 
-                                    std::string product, 
+OrderBookEntry CSVReader::stringsToOBE(std::string_view priceString, 
+                                    std::string_view amountString, 
+                                    std::string_view timestamp, 
+                                    std::string_view product, 
                                     OrderBookType orderType)
 {
     double price, amount;
-    try {
-         price = std::stod(priceString);
-         amount = std::stod(amountString);
-    }catch(const std::exception& e){
+    if (!parseDouble(priceString, price) || !parseDouble(amountString, amount)) {
         std::cout << "CSVReader::stringsToOBE Bad float! " << priceString<< std::endl;
         std::cout << "CSVReader::stringsToOBE Bad float! " << amountString<< std::endl; 
-        throw;        
+        throw std::invalid_argument{"CSVReader::stringsToOBE"};
     }
     OrderBookEntry obe{price, 
                     amount, 
-                    timestamp,
-                    product, 
+                    std::string{timestamp},
+                    std::string{product}, 
                     orderType};
                 
     return obe;
 }
-     
\ No newline at end of file
+
+/** parse text, a finite number with nothing but spaces around it, into value.
+ * Returns false if it isn't one
+ * */
+bool CSVReader::parseDouble(std::string_view text, double& value)
+{
+    std::size_t start = 0;
+    std::size_t end = text.size();
+    while (start < end && std::isspace((unsigned char) text[start]))
+    {
+        start++;
+    }
+    while (end > start && std::isspace((unsigned char) text[end - 1]))
+    {
+        end--;
+    }
+    // from_chars doesn't take a plus sign
+    if (start + 1 < end && text[start] == '+' && text[start + 1] != '-') {
+        start++;
+    }
+    std::from_chars_result result = std::from_chars(text.data() + start, text.data() + end, value);
+    return result.ec == std::errc{} && result.ptr == text.data() + end && std::isfinite(value);
+}
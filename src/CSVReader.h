@@ -1,8 +1,10 @@
 #pragma once
 
 #include "OrderBookEntry.h"
+#include "LoadReport.h"
 #include <vector>
 #include <string>
+#include <string_view>
 
 
 class CSVReader
@@ -10,16 +12,33 @@ class CSVReader
     public:
      CSVReader();
 
+     // tokens in a csv row of orders
+     static const std::size_t rowTokens = 5;
+
+     /** read the valid rows of a csv file, printing a report of the rejected ones */
      static std::vector<OrderBookEntry> readCSV(std::string csvFile);
-     static std::vector<std::string> tokenise(std::string csvLine, char separator);
+     /** read the valid rows of a csv file, counting the rejected ones in report */
+     static std::vector<OrderBookEntry> readCSV(std::string csvFile, LoadReport& report);
+     /** split line into at most maxTokens tokens without allocating, see Tokenizer.
+      * Returns the amount of tokens in the line, which is more than maxTokens if they didn't all fit
+      * */
+     static std::size_t tokenise(std::string_view line, char separator, std::string_view* tokens, std::size_t maxTokens);
+     /** as above, making doubled quotes in quoted fields single in place, so line may change */
+     static std::size_t tokenise(std::string& line, char separator, std::string_view* tokens, std::size_t maxTokens);
     
-     static OrderBookEntry stringsToOBE(std::string price, 
-                                        std::string amount, 
-                                        std::string timestamp, 
-                                        std::string product, 
+     /** convert the fields of a typed in order, throws std::invalid_argument if a number is bad */
+     static OrderBookEntry stringsToOBE(std::string_view price, 
+                                        std::string_view amount, 
+                                        std::string_view timestamp, 
+                                        std::string_view product, 
                                         OrderBookType OrderBookType);
 
-    private:
-     static OrderBookEntry stringsToOBE(std::vector<std::string> strings);
-     
+     /** check the tokens of a csv row and add it to orders, or return what is wrong with it */
+     static RowError parseRow(const std::string_view* tokens, std::size_t count, std::vector<OrderBookEntry>& orders);
+
+     /** parse text, a finite number with nothing but spaces around it, into value.
+      * Returns false if it isn't one
+      * */
+     static bool parseDouble(std::string_view text, double& value);
+
 };
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "ConcurrentOrderBook.h"
+#include <thread>
+#include <functional>
+
+ConcurrentOrderBook::ReadGuard::ReadGuard(const ConcurrentOrderBook* _owner, int _epoch, int _stripe)
+: owner(_owner), epoch(_epoch), stripe(_stripe)
+{
+    int copy = owner->active.load();
+    pinned = &owner->books[copy];
+    pinnedVersion = owner->bookVersions[copy];
+}
+
+ConcurrentOrderBook::ReadGuard::ReadGuard(ReadGuard&& other)
+: owner(other.owner), epoch(other.epoch), stripe(other.stripe), pinned(other.pinned), pinnedVersion(other.pinnedVersion)
+{
+    other.owner = nullptr;
+}
+
+ConcurrentOrderBook::ReadGuard::~ReadGuard()
+{
+    if (owner != nullptr) {
+        owner->readers[epoch][stripe].count--;
+    }
+}
+
+/** return the pinned book */
+const OrderBook& ConcurrentOrderBook::ReadGuard::book() const
+{
+    return *pinned;
+}
+
+/** return the version of the pinned book */
+unsigned long ConcurrentOrderBook::ReadGuard::version() const
+{
+    return pinnedVersion;
+}
+
+/** construct an empty book */
+ConcurrentOrderBook::ConcurrentOrderBook()
+: bookVersions{0, 0}, active(0), epoch(0)
+{
+
+}
+
+/** construct, reading a csv data file */
+ConcurrentOrderBook::ConcurrentOrderBook(std::string filename)
+: bookVersions{0, 0}, active(0), epoch(0)
+{
+    books[0] = OrderBook{filename};
+    books[1] = books[0];
+}
+
+/** pin the current version of the book, never blocks */
+ConcurrentOrderBook::ReadGuard ConcurrentOrderBook::read() const
+{
+    int stripe = (int) (std::hash<std::thread::id>{}(std::this_thread::get_id()) % stripes);
+    int readerEpoch = epoch.load();
+    readers[readerEpoch][stripe].count++;
+    return ReadGuard{this, readerEpoch, stripe};
+}
+
+/** publish a new version with the segment appended */
+void ConcurrentOrderBook::appendOrders(const std::vector<OrderBookEntry>& segment)
+{
+    publish([&segment](OrderBook& book) { book.appendOrders(segment); });
+}
+
+/** publish a new version with the order inserted */
+void ConcurrentOrderBook::insertOrder(const OrderBookEntry& order)
+{
+    publish([&order](OrderBook& book) {
+        OrderBookEntry copy = order;
+        book.insertOrder(copy);
+    });
+}
+
+/** return the latest published version */
+unsigned long ConcurrentOrderBook::getVersion() const
+{
+    return read().version();
+}
+
+/** apply change to both copies, publishing in between */
+template <typename Change>
+void ConcurrentOrderBook::publish(Change change)
+{
+    std::lock_guard<std::mutex> lock{writerMutex};
+
+    // nobody reads the inactive copy, update it and make it the active one
+    int readCopy = active.load();
+    int writeCopy = 1 - readCopy;
+    change(books[writeCopy]);
+    bookVersions[writeCopy] = bookVersions[readCopy] + 1;
+    active.store(writeCopy);
+
+    // readers that may still hold the old copy are all in the current epoch or
+    // the one before. Move new readers to the other epoch and wait for both to drain,
+    // after that nobody can be reading the old copy anymore
+    int oldEpoch = epoch.load();
+    int newEpoch = 1 - oldEpoch;
+    waitForReaders(newEpoch);
+    epoch.store(newEpoch);
+    waitForReaders(oldEpoch);
+
+    // bring the old copy up to date
+    change(books[readCopy]);
+    bookVersions[readCopy] = bookVersions[writeCopy];
+}
+
+/** wait until no reader of epoch is left */
+void ConcurrentOrderBook::waitForReaders(int readerEpoch) const
+{
+    for (int stripe = 0; stripe < stripes; ++stripe)
+    {
+        while (readers[readerEpoch][stripe].count.load() != 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
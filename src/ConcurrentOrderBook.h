@@ -0,0 +1,90 @@
+#pragma once
+
+#include "OrderBook.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/** an order book that one writer thread can add to while any number of
+ * reader threads query it, without readers ever taking a lock.
+ *
+ * Two copies of the book are kept (left-right). Readers announce themselves
+ * in the current epoch and read the active copy, which nobody writes to while
+ * they hold it. The writer applies a change to the inactive copy, publishes it,
+ * waits for the readers of the previous epoch to leave and then replays the
+ * change on the other copy. Readers never wait and always see a whole segment
+ * or none of it, the writer pays for applying every change twice.
+ */
+class ConcurrentOrderBook
+{
+    public:
+        /** a pinned, consistent view of the book. The view does not change
+         * until the guard is destroyed, so keep guards short lived: the writer
+         * cannot publish the next version while an older one is pinned.
+         */
+        class ReadGuard
+        {
+            public:
+                ReadGuard(ReadGuard&& other);
+                ~ReadGuard();
+                ReadGuard(const ReadGuard&) = delete;
+                ReadGuard& operator=(const ReadGuard&) = delete;
+
+                /** return the pinned book */
+                const OrderBook& book() const;
+                /** return the version of the pinned book */
+                unsigned long version() const;
+
+            private:
+                friend class ConcurrentOrderBook;
+                ReadGuard(const ConcurrentOrderBook* owner, int epoch, int stripe);
+
+                const ConcurrentOrderBook* owner;
+                int epoch;
+                int stripe;
+                const OrderBook* pinned;
+                unsigned long pinnedVersion;
+        };
+
+        /** construct an empty book */
+        ConcurrentOrderBook();
+        /** construct, reading a csv data file */
+        ConcurrentOrderBook(std::string filename);
+
+        /** pin the current version of the book, never blocks */
+        ReadGuard read() const;
+
+        // writer side, one thread at a time
+        /** publish a new version with the segment appended */
+        void appendOrders(const std::vector<OrderBookEntry>& segment);
+        /** publish a new version with the order inserted */
+        void insertOrder(const OrderBookEntry& order);
+        /** return the latest published version */
+        unsigned long getVersion() const;
+
+    private:
+        /** apply change to both copies, publishing in between */
+        template <typename Change>
+        void publish(Change change);
+        /** wait until no reader of epoch is left */
+        void waitForReaders(int epoch) const;
+
+        // reader counts are striped over cache lines so readers on
+        // different threads don't fight over one counter
+        static const int stripes = 16;
+        struct alignas(64) ReaderCount
+        {
+            std::atomic<long> count{0};
+        };
+
+        OrderBook books[2];
+        // version of each copy, only written while that copy is inactive
+        unsigned long bookVersions[2];
+        // index of the copy readers use
+        std::atomic<int> active;
+        // epoch new readers announce themselves in
+        std::atomic<int> epoch;
+        mutable ReaderCount readers[2][stripes];
+        std::mutex writerMutex;
+};
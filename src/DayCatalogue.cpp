@@ -0,0 +1,402 @@
+#include "DayCatalogue.h"
+#include "CSVReader.h"
+#include "IngestPipeline.h"
+#include "OrderArchive.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+
+/** index every *.csv and *.mkrx file in directory, keep at most memoryBudget bytes of days loaded */
+DayCatalogue::DayCatalogue(std::string directory, std::size_t _memoryBudget)
+: memoryBudget(_memoryBudget), loadedBytes(0)
+{
+    std::error_code error;
+    for (const auto& file : std::filesystem::directory_iterator{directory, error})
+    {
+        if (file.path().extension() != ".csv" && file.path().extension() != ".mkrx") {
+            continue;
+        }
+        Day day{file.path().string(), "", ""};
+        if (readTimeRange(day.path, day.firstTime, day.lastTime)) {
+            days.push_back(day);
+        } else {
+            std::cout << "DayCatalogue::DayCatalogue no rows in " << day.path << std::endl;
+        }
+    }
+    if (error) {
+        std::cout << "DayCatalogue::DayCatalogue cannot read " << directory << ": " << error.message() << std::endl;
+    }
+    std::sort(days.begin(), days.end(), [](const Day& a, const Day& b) { return a.firstTime < b.firstTime; });
+    std::cout << "DayCatalogue::DayCatalogue indexed " << days.size() << " days in " << directory << std::endl;
+}
+
+DayCatalogue::~DayCatalogue()
+{
+    // prefetches still running hold nothing of ours but their futures, wait for them
+    std::map<std::size_t, std::shared_future<std::shared_ptr<const OrderBook>>> pending;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        pending = loading;
+    }
+    for (auto& load : pending)
+    {
+        load.second.wait();
+    }
+}
+
+/** return the amount of day files */
+std::size_t DayCatalogue::size() const
+{
+    return days.size();
+}
+
+/** return the partition holding timestamp, loading it if needed.
+ * Times between two days map to the earlier day, nullptr if the catalogue is empty
+ * */
+std::shared_ptr<const OrderBook> DayCatalogue::getPartitionFor(std::string timestamp)
+{
+    if (days.size() == 0) {
+        return nullptr;
+    }
+    return getDay(findDay(timestamp));
+}
+
+/** returns the earliest time of the first day */
+std::string DayCatalogue::getEarliestTime()
+{
+    if (days.size() == 0) {
+        return "";
+    }
+    return days[0].firstTime;
+}
+
+/** returns the next time after timestamp, moving on to the next day at the end of a day.
+ * If there is no next timestamp, wraps around to the start
+ * */
+std::string DayCatalogue::getNextTime(std::string timestamp)
+{
+    if (days.size() == 0) {
+        return "";
+    }
+    std::size_t index = findDay(timestamp);
+    if (timestamp < days[index].lastTime) {
+        return getDay(index)->getNextTime(timestamp);
+    }
+    // end of the day, the next one is usually prefetched by now
+    if (index + 1 < days.size()) {
+        return days[index + 1].firstTime;
+    }
+    return days[0].firstTime;
+}
+
+/** returns the time before timestamp, moving back to the previous day at the start of a day.
+ * "" if there is none
+ * */
+std::string DayCatalogue::getPreviousTime(std::string timestamp)
+{
+    if (days.size() == 0) {
+        return "";
+    }
+    std::size_t index = findDay(timestamp);
+    if (timestamp > days[index].firstTime) {
+        return getDay(index)->getPreviousTime(timestamp);
+    }
+    if (index > 0) {
+        return days[index - 1].lastTime;
+    }
+    return "";
+}
+
+/** returns the first time at or after timestamp, the latest time if there is none.
+ * Only the day holding it is loaded
+ * */
+std::string DayCatalogue::findTime(std::string timestamp)
+{
+    if (days.size() == 0) {
+        return "";
+    }
+    // the day ranges answer times at the edges of days without loading them
+    std::size_t index = findDay(timestamp);
+    if (timestamp <= days[index].firstTime) {
+        return days[index].firstTime;
+    }
+    if (timestamp > days[index].lastTime) {
+        return index + 1 < days.size() ? days[index + 1].firstTime : days[index].lastTime;
+    }
+    return getDay(index)->findTime(timestamp);
+}
+
+/** returns the time steps timestamps after timestamp, before it if steps is negative,
+ * crossing days as needed. Stops at the earliest and the latest time
+ * */
+std::string DayCatalogue::offsetTime(std::string timestamp, long steps)
+{
+    if (days.size() == 0) {
+        return "";
+    }
+    std::size_t index = findDay(timestamp);
+    while (true)
+    {
+        std::shared_ptr<const OrderBook> day = getDay(index);
+        const std::vector<std::string>& timestamps = day->getTimestamps();
+        // position of the time at or before timestamp within the day
+        long position = (long) (std::upper_bound(timestamps.begin(), timestamps.end(), timestamp) - timestamps.begin()) - 1;
+        long target = position + steps;
+        if (target >= 0 && target < (long) timestamps.size()) {
+            return timestamps[target];
+        }
+        if (target >= (long) timestamps.size()) {
+            if (index + 1 == days.size()) {
+                return day->getLatestTime();
+            }
+            // the first time of the next day is one step after the last of this one
+            steps = target - (long) timestamps.size();
+            index++;
+            timestamp = days[index].firstTime;
+        } else {
+            if (index == 0) {
+                return day->getEarliestTime();
+            }
+            // the last time of the previous day is one step before the first of this one
+            steps = target + 1;
+            index--;
+            timestamp = days[index].lastTime;
+        }
+    }
+}
+
+/** return min/max/sum/count of the product prices with timestamps in [fromTime, toTime], over all days */
+PriceSummary DayCatalogue::getPriceSummary(std::string product, OrderBookType type, std::string fromTime, std::string toTime)
+{
+    PriceSummary summary;
+    // only days overlapping the range are loaded
+    for (std::size_t index = 0; index < days.size(); ++index)
+    {
+        if (days[index].lastTime < fromTime || days[index].firstTime.compare(0, toTime.size(), toTime) > 0) {
+            continue;
+        }
+        summary.merge(getDay(index)->getPriceSummary(product, type, fromTime, toTime));
+    }
+    return summary;
+}
+
+/** return min/max/sum/count of the product prices in currentTime and the lastTimestamps before it, over all days */
+PriceSummary DayCatalogue::getWindowSummary(std::string product, std::string currentTime, int lastTimestamps, OrderBookType type)
+{
+    PriceSummary summary;
+    if (days.size() == 0 || lastTimestamps < 0) {
+        return summary;
+    }
+
+    // walk back from currentTime day by day until the window is covered
+    std::size_t index = findDay(currentTime);
+    std::size_t remaining = (std::size_t) lastTimestamps + 1;
+    std::string toTime = currentTime;
+    while (remaining > 0)
+    {
+        std::shared_ptr<const OrderBook> day = getDay(index);
+        const std::vector<std::string>& timestamps = day->getTimestamps();
+        std::size_t end = std::upper_bound(timestamps.begin(), timestamps.end(), toTime) - timestamps.begin();
+        std::size_t begin = end > remaining ? end - remaining : 0;
+        if (end > begin) {
+            summary.merge(day->getPriceSummary(product, type, timestamps[begin], timestamps[end - 1]));
+        }
+        remaining -= end - begin;
+        if (index == 0) {
+            break;
+        }
+        index--;
+        toTime = days[index].lastTime;
+    }
+    return summary;
+}
+
+/** return the amount of days loaded now and the bytes they hold */
+std::size_t DayCatalogue::getLoadedDays()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return loaded.size();
+}
+
+std::size_t DayCatalogue::getLoadedBytes()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return loadedBytes;
+}
+
+/** return the index of the day holding timestamp */
+std::size_t DayCatalogue::findDay(std::string timestamp) const
+{
+    // last day starting at or before timestamp
+    auto it = std::upper_bound(days.begin(), days.end(), timestamp,
+                               [](const std::string& time, const Day& day) { return time < day.firstTime; });
+    if (it == days.begin()) {
+        return 0;
+    }
+    return (it - days.begin()) - 1;
+}
+
+/** return the loaded day, loading it (or waiting for its prefetch) if needed */
+std::shared_ptr<const OrderBook> DayCatalogue::getDay(std::size_t index)
+{
+    std::shared_future<std::shared_ptr<const OrderBook>> pending;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        collectLoads(index);
+        auto it = loaded.find(index);
+        if (it != loaded.end()) {
+            recentlyUsed.remove(index);
+            recentlyUsed.push_front(index);
+            std::shared_ptr<const OrderBook> day = it->second.first;
+            prefetch(index + 1);
+            return day;
+        }
+        auto loadingIt = loading.find(index);
+        pending = loadingIt != loading.end() ? loadingIt->second : startLoading(index);
+    }
+
+    // load outside the lock, other days stay available meanwhile
+    std::shared_ptr<const OrderBook> day = pending.get();
+
+    std::lock_guard<std::mutex> lock{mutex};
+    if (loaded.count(index) == 0) {
+        std::size_t bytes = day->getMemoryUsage();
+        loaded[index] = std::make_pair(day, bytes);
+        loadedBytes += bytes;
+        recentlyUsed.push_front(index);
+        evict(index);
+    } else {
+        // collected while this query waited for it
+        recentlyUsed.remove(index);
+        recentlyUsed.push_front(index);
+    }
+    loading.erase(index);
+    prefetch(index + 1);
+    return day;
+}
+
+/** start loading a day in the background unless it is loaded or loading. mutex must be held */
+void DayCatalogue::prefetch(std::size_t index)
+{
+    if (index < days.size() && loaded.count(index) == 0 && loading.count(index) == 0) {
+        startLoading(index);
+    }
+}
+
+/** start loading a day, mutex must be held */
+std::shared_future<std::shared_ptr<const OrderBook>> DayCatalogue::startLoading(std::size_t index)
+{
+    std::string path = days[index].path;
+    std::shared_future<std::shared_ptr<const OrderBook>> load = std::async(std::launch::async, [path]()
+    {
+        std::shared_ptr<OrderBook> day = std::make_shared<OrderBook>();
+        if (OrderArchive::isArchive(path)) {
+            day->appendOrders(OrderArchive::read(path));
+        } else {
+            IngestPipeline pipeline{path};
+            pipeline.run(*day);
+        }
+        return std::shared_ptr<const OrderBook>{day};
+    }).share();
+    loading[index] = load;
+    return load;
+}
+
+/** move the days whose load finished into the loaded days, counted against the budget, never
+ * dropping keep. mutex must be held
+ * */
+void DayCatalogue::collectLoads(std::size_t keep)
+{
+    // a prefetch nobody asked for yet, e.g. after a jump elsewhere, would otherwise stay here unbudgeted
+    for (auto it = loading.begin(); it != loading.end();)
+    {
+        if (it->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+        std::shared_ptr<const OrderBook> day = it->second.get();
+        if (loaded.count(it->first) == 0) {
+            std::size_t bytes = day->getMemoryUsage();
+            loaded[it->first] = std::make_pair(day, bytes);
+            loadedBytes += bytes;
+            recentlyUsed.push_front(it->first);
+        }
+        it = loading.erase(it);
+    }
+    evict(keep);
+}
+
+/** drop least recently used days until the budget is met, never dropping keep. mutex must be held */
+void DayCatalogue::evict(std::size_t keep)
+{
+    // sessions still holding an evicted day keep it alive until they let go
+    auto it = recentlyUsed.end();
+    while (loadedBytes > memoryBudget && it != recentlyUsed.begin())
+    {
+        --it;
+        if (*it == keep) {
+            continue;
+        }
+        loadedBytes -= loaded[*it].second;
+        loaded.erase(*it);
+        it = recentlyUsed.erase(it);
+    }
+}
+
+/** set time to the timestamp of a csv row the book would load, leave it alone for a row it would reject */
+static void readRowTime(std::string_view line, std::string& time)
+{
+    std::string_view tokens[CSVReader::rowTokens];
+    std::size_t count = CSVReader::tokenise(line, ',', tokens, CSVReader::rowTokens);
+    std::vector<OrderBookEntry> row;
+    if (CSVReader::parseRow(tokens, count, row) == RowError::none) {
+        time = tokens[0];
+    }
+}
+
+/** read the first and last timestamp of a csv or archive file */
+bool DayCatalogue::readTimeRange(std::string path, std::string& firstTime, std::string& lastTime)
+{
+    // archives know the time range of every block
+    if (OrderArchive::isArchive(path)) {
+        for (const ArchiveBlock& block : OrderArchive::readIndex(path))
+        {
+            if (firstTime == "" || block.firstTime < firstTime) firstTime = block.firstTime;
+            if (lastTime == "" || block.lastTime > lastTime) lastTime = block.lastTime;
+        }
+        return firstTime != "";
+    }
+
+    std::ifstream file{path, std::ios::binary};
+    std::string line;
+    while (firstTime == "" && std::getline(file, line))
+    {
+        readRowTime(line, firstTime);
+    }
+    if (firstTime == "") {
+        return false;
+    }
+
+    // the last rows are in the last few kilobytes
+    file.clear();
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    std::streamoff tail = std::min<std::streamoff>(size, 64 * 1024);
+    file.seekg(size - tail);
+    std::string chunk(tail, '\0');
+    file.read(&chunk[0], tail);
+    std::size_t end = chunk.size();
+    while (lastTime == "" && end > 0)
+    {
+        std::size_t start = chunk.rfind('\n', end - 1);
+        start = start == std::string::npos ? 0 : start + 1;
+        readRowTime(std::string_view{chunk.data() + start, end - start}, lastTime);
+        end = start > 0 ? start - 1 : 0;
+    }
+    if (lastTime == "") {
+        lastTime = firstTime;
+    }
+    return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <future>
+#include "OrderBook.h"
+#include "PriceRangeTree.h"
+
+/** a dataset made of a directory of day files, one csv or archive (see OrderArchive) per day.
+ *
+ * On construction only the time range of every file is read. A day is
+ * loaded into its own OrderBook (a partition) the first time a query
+ * touches it, and the least recently used days are evicted when the loaded
+ * partitions exceed the memory budget. Whenever a day is used, the day after
+ * it is loaded in the background so stepping over midnight doesn't stall.
+ * Safe to use from several threads.
+ */
+class DayCatalogue
+{
+    public:
+        /** index every *.csv and *.mkrx file in directory, keep at most memoryBudget bytes of days loaded */
+        DayCatalogue(std::string directory, std::size_t memoryBudget);
+        ~DayCatalogue();
+
+        /** return the amount of day files */
+        std::size_t size() const;
+        /** return the partition holding timestamp, loading it if needed.
+         * Times between two days map to the earlier day, nullptr if the catalogue is empty
+         * */
+        std::shared_ptr<const OrderBook> getPartitionFor(std::string timestamp);
+
+        /** returns the earliest time of the first day */
+        std::string getEarliestTime();
+        /** returns the next time after timestamp, moving on to the next day at the end of a day.
+         * If there is no next timestamp, wraps around to the start
+         * */
+        std::string getNextTime(std::string timestamp);
+        /** returns the time before timestamp, moving back to the previous day at the start of a day.
+         * "" if there is none
+         * */
+        std::string getPreviousTime(std::string timestamp);
+        /** returns the first time at or after timestamp, the latest time if there is none.
+         * Only the day holding it is loaded
+         * */
+        std::string findTime(std::string timestamp);
+        /** returns the time steps timestamps after timestamp, before it if steps is negative,
+         * crossing days as needed. Stops at the earliest and the latest time
+         * */
+        std::string offsetTime(std::string timestamp, long steps);
+        /** return min/max/sum/count of the product prices with timestamps in [fromTime, toTime], over all days */
+        PriceSummary getPriceSummary(std::string product, OrderBookType type, std::string fromTime, std::string toTime);
+        /** return min/max/sum/count of the product prices in currentTime and the lastTimestamps before it, over all days */
+        PriceSummary getWindowSummary(std::string product, std::string currentTime, int lastTimestamps, OrderBookType type);
+
+        /** return the amount of days loaded now and the bytes they hold */
+        std::size_t getLoadedDays();
+        std::size_t getLoadedBytes();
+
+    private:
+        struct Day
+        {
+            std::string path;
+            std::string firstTime;
+            std::string lastTime;
+        };
+
+        /** return the index of the day holding timestamp */
+        std::size_t findDay(std::string timestamp) const;
+        /** return the loaded day, loading it (or waiting for its prefetch) if needed */
+        std::shared_ptr<const OrderBook> getDay(std::size_t index);
+        /** start loading a day in the background unless it is loaded or loading. mutex must be held */
+        void prefetch(std::size_t index);
+        /** start loading a day, mutex must be held */
+        std::shared_future<std::shared_ptr<const OrderBook>> startLoading(std::size_t index);
+        /** move the days whose load finished into the loaded days, counted against the budget, never
+         * dropping keep. mutex must be held
+         * */
+        void collectLoads(std::size_t keep);
+        /** drop least recently used days until the budget is met, never dropping keep. mutex must be held */
+        void evict(std::size_t keep);
+        /** read the first and last timestamp of a csv or archive file */
+        static bool readTimeRange(std::string path, std::string& firstTime, std::string& lastTime);
+
+        std::vector<Day> days;
+        std::size_t memoryBudget;
+
+        std::mutex mutex;
+        // loaded days and their size in bytes
+        std::map<std::size_t, std::pair<std::shared_ptr<const OrderBook>, std::size_t>> loaded;
+        std::size_t loadedBytes;
+        // most recently used first
+        std::list<std::size_t> recentlyUsed;
+        // days being loaded, by a query or a prefetch
+        std::map<std::size_t, std::shared_future<std::shared_ptr<const OrderBook>>> loading;
+};
@@ -0,0 +1,215 @@
+#include "IngestPipeline.h"
+#include "OrderBook.h"
+#include "CSVReader.h"
+#include "Trace.h"
+#include <fstream>
+#include <thread>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+/** seconds since start */
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+IngestPipeline::IngestPipeline(std::string _filename, std::size_t _batchSize, std::size_t _queueCapacity)
+: filename(_filename), batchSize(_batchSize), queueCapacity(_queueCapacity)
+{
+    for (const char* name : {"reader", "parser", "converter", "indexer"})
+    {
+        stats.push_back(IngestStageStats{name, 0, 0, 0, 0, 0, 0});
+    }
+}
+
+/** run all stages, adding every valid row to book. Returns the amount of rows added */
+std::size_t IngestPipeline::run(OrderBook& book)
+{
+    report = LoadReport{};
+    SPSCQueue<Lines> lines{queueCapacity};
+    SPSCQueue<TokenRows> tokenRows{queueCapacity};
+    SPSCQueue<Orders> orders{queueCapacity};
+
+    std::thread reader{[this, &lines]() { readStage(lines); }};
+    std::thread parser{[this, &lines, &tokenRows]() { parseStage(lines, tokenRows); }};
+    std::thread converter{[this, &tokenRows, &orders]() { convertStage(tokenRows, orders); }};
+    // the indexer owns the book, run it here
+    indexStage(orders, book);
+    reader.join();
+    parser.join();
+    converter.join();
+
+    stats[0].outputWaits = lines.getFullWaits();
+    stats[1].inputWaits = lines.getEmptyWaits();
+    stats[1].outputWaits = tokenRows.getFullWaits();
+    stats[2].inputWaits = tokenRows.getEmptyWaits();
+    stats[2].outputWaits = orders.getFullWaits();
+    stats[3].inputWaits = orders.getEmptyWaits();
+    return stats[3].items;
+}
+
+/** return the stats of every stage, in pipeline order */
+const std::vector<IngestStageStats>& IngestPipeline::getStats() const
+{
+    return stats;
+}
+
+/** return the rows loaded and rejected by the last run */
+const LoadReport& IngestPipeline::getReport() const
+{
+    return report;
+}
+
+/** print per stage throughput and back pressure */
+void IngestPipeline::printStats(std::ostream& out) const
+{
+    out << "stage\titems\titems/s\tbusy s\tstarved s\tblocked s\tstarved\tblocked" << "\n";
+    for (const IngestStageStats& stage : stats)
+    {
+        out << stage.name << "\t" << stage.items << "\t"
+            << (stage.busySeconds > 0 ? stage.items / stage.busySeconds : 0) << "\t"
+            << stage.busySeconds << "\t" << stage.inputWaitSeconds << "\t" << stage.outputWaitSeconds << "\t"
+            << stage.inputWaits << "\t" << stage.outputWaits << "\n";
+    }
+}
+
+void IngestPipeline::readStage(SPSCQueue<Lines>& output)
+{
+    IngestStageStats& stage = stats[0];
+    Trace::setThreadName("ingest read");
+    TraceScope scope{"IngestPipeline::readStage", "ingest", filename};
+    Clock::time_point start = Clock::now();
+
+    std::ifstream csvFile{filename, std::ios::binary};
+    std::vector<char> chunk(1 << 20);
+    std::string partial;
+    Lines batch;
+    batch.reserve(batchSize);
+    while (csvFile)
+    {
+        csvFile.read(chunk.data(), chunk.size());
+        std::streamsize got = csvFile.gcount();
+        std::size_t lineStart = 0;
+        for (std::streamsize i = 0; i < got; ++i)
+        {
+            if (chunk[i] != '\n') {
+                continue;
+            }
+            partial.append(chunk.data() + lineStart, i - lineStart);
+            batch.push_back(std::move(partial));
+            partial.clear();
+            lineStart = i + 1;
+            if (batch.size() == batchSize) {
+                stage.items += batch.size();
+                TraceScope waitScope{"IngestPipeline wait", "ingest"};
+                Clock::time_point pushStart = Clock::now();
+                output.push(std::move(batch));
+                stage.outputWaitSeconds += secondsSince(pushStart);
+                batch = Lines{};
+                batch.reserve(batchSize);
+            }
+        }
+        partial.append(chunk.data() + lineStart, got - lineStart);
+    }
+    // last line without a newline
+    if (partial.size() > 0) {
+        batch.push_back(partial);
+    }
+    stage.items += batch.size();
+    output.push(std::move(batch));
+    output.close();
+    stage.busySeconds = secondsSince(start) - stage.outputWaitSeconds;
+}
+
+void IngestPipeline::parseStage(SPSCQueue<Lines>& input, SPSCQueue<TokenRows>& output)
+{
+    IngestStageStats& stage = stats[1];
+    Trace::setThreadName("ingest parse");
+    Clock::time_point start = Clock::now();
+    Lines lines;
+    unsigned long lineNumber = 1;
+    while (true)
+    {
+        Clock::time_point popStart = Clock::now();
+        bool more = input.pop(lines);
+        stage.inputWaitSeconds += secondsSince(popStart);
+        if (!more) break;
+
+        TraceScope batchScope{"IngestPipeline::parseStage batch", "ingest"};
+        TokenRows rows;
+        rows.firstLine = lineNumber;
+        lineNumber += lines.size();
+        rows.rows.resize(lines.size());
+        for (std::size_t i = 0; i < lines.size(); ++i)
+        {
+            std::string& line = lines[i];
+            if (line.size() > 0 && line.back() == '\r') line.pop_back();
+            TokenRow& row = rows.rows[i];
+            row.count = CSVReader::tokenise(line, ',', row.tokens.data(), row.tokens.size());
+        }
+        // the tokens view the lines, which keep their place when the vector is moved
+        rows.lines = std::move(lines);
+        stage.items += rows.rows.size();
+
+        Clock::time_point pushStart = Clock::now();
+        output.push(std::move(rows));
+        stage.outputWaitSeconds += secondsSince(pushStart);
+    }
+    output.close();
+    stage.busySeconds = secondsSince(start) - stage.inputWaitSeconds - stage.outputWaitSeconds;
+}
+
+void IngestPipeline::convertStage(SPSCQueue<TokenRows>& input, SPSCQueue<Orders>& output)
+{
+    IngestStageStats& stage = stats[2];
+    Trace::setThreadName("ingest convert");
+    Clock::time_point start = Clock::now();
+    TokenRows rows;
+    while (true)
+    {
+        Clock::time_point popStart = Clock::now();
+        bool more = input.pop(rows);
+        stage.inputWaitSeconds += secondsSince(popStart);
+        if (!more) break;
+
+        TraceScope batchScope{"IngestPipeline::convertStage batch", "ingest"};
+        Orders orders;
+        orders.reserve(rows.rows.size());
+        for (std::size_t i = 0; i < rows.rows.size(); ++i)
+        {
+            const TokenRow& row = rows.rows[i];
+            RowError error = CSVReader::parseRow(row.tokens.data(), row.count, orders);
+            if (error == RowError::none) {
+                report.addRows();
+            } else {
+                report.addError(error, rows.firstLine + i);
+            }
+        }
+        stage.items += orders.size();
+
+        Clock::time_point pushStart = Clock::now();
+        output.push(std::move(orders));
+        stage.outputWaitSeconds += secondsSince(pushStart);
+    }
+    output.close();
+    stage.busySeconds = secondsSince(start) - stage.inputWaitSeconds - stage.outputWaitSeconds;
+}
+
+void IngestPipeline::indexStage(SPSCQueue<Orders>& input, OrderBook& book)
+{
+    IngestStageStats& stage = stats[3];
+    Clock::time_point start = Clock::now();
+    Orders orders;
+    while (true)
+    {
+        Clock::time_point popStart = Clock::now();
+        bool more = input.pop(orders);
+        stage.inputWaitSeconds += secondsSince(popStart);
+        if (!more) break;
+
+        book.appendOrders(orders);
+        stage.items += orders.size();
+    }
+    stage.busySeconds = secondsSince(start) - stage.inputWaitSeconds;
+}
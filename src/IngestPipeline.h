@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "OrderBookEntry.h"
+#include "SPSCQueue.h"
+#include "CSVReader.h"
+#include <array>
+#include <string_view>
+
+class OrderBook;
+
+/** throughput and waiting time of one ingest stage */
+struct IngestStageStats
+{
+    std::string name;
+    // lines, token rows or orders handled by the stage
+    unsigned long items;
+    double busySeconds;
+    // starved: waiting for the previous stage
+    double inputWaitSeconds;
+    // back pressure: waiting for the next stage to make room
+    double outputWaitSeconds;
+    // times the stage found its input queue empty / output queue full
+    unsigned long inputWaits;
+    unsigned long outputWaits;
+};
+
+/** loads a csv file into an order book with four stages on four threads:
+ * reader (raw file I/O, splits lines) -> parser (tokenises) ->
+ * converter (validates, converts to OrderBookEntry) -> indexer (adds to the book).
+ * Stages hand batches of rows to each other over bounded SPSC queues,
+ * so I/O and parsing overlap and the stats show which stage limits the load.
+ */
+class IngestPipeline
+{
+    public:
+        IngestPipeline(std::string filename, std::size_t batchSize = 1024, std::size_t queueCapacity = 64);
+        /** run all stages, adding every valid row to book. Returns the amount of rows added */
+        std::size_t run(OrderBook& book);
+        /** return the stats of every stage, in pipeline order */
+        const std::vector<IngestStageStats>& getStats() const;
+        /** print per stage throughput and back pressure */
+        void printStats(std::ostream& out) const;
+        /** return the rows loaded and rejected by the last run */
+        const LoadReport& getReport() const;
+
+    private:
+        typedef std::vector<std::string> Lines;
+        /** the tokens of a csv line, viewing it */
+        struct TokenRow
+        {
+            std::array<std::string_view, CSVReader::rowTokens> tokens;
+            // tokens in the line, can be more than fit
+            std::size_t count;
+        };
+        /** a batch of lines and their tokens, travelling together so the views stay valid */
+        struct TokenRows
+        {
+            // line number of the first line, 1 based
+            unsigned long firstLine;
+            Lines lines;
+            std::vector<TokenRow> rows;
+        };
+        typedef std::vector<OrderBookEntry> Orders;
+
+        void readStage(SPSCQueue<Lines>& output);
+        void parseStage(SPSCQueue<Lines>& input, SPSCQueue<TokenRows>& output);
+        void convertStage(SPSCQueue<TokenRows>& input, SPSCQueue<Orders>& output);
+        void indexStage(SPSCQueue<Orders>& input, OrderBook& book);
+
+        std::string filename;
+        std::size_t batchSize;
+        std::size_t queueCapacity;
+        std::vector<IngestStageStats> stats;
+        // only written by the converter
+        LoadReport report;
+};
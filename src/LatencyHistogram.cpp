@@ -0,0 +1,92 @@
+#include "LatencyHistogram.h"
+#include <cmath>
+
+LatencyHistogram::LatencyHistogram()
+: count(0), sum(0), max(0)
+{
+    for (std::atomic<unsigned long>& bucket : buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+/** add one duration */
+void LatencyHistogram::record(std::uint64_t nanoseconds)
+{
+    buckets[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+    std::uint64_t previous = max.load(std::memory_order_relaxed);
+    while (nanoseconds > previous && !max.compare_exchange_weak(previous, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+/** return the amount of durations recorded */
+unsigned long LatencyHistogram::getCount() const
+{
+    return count.load(std::memory_order_relaxed);
+}
+
+/** return the mean duration, 0 if none were recorded */
+double LatencyHistogram::getMean() const
+{
+    unsigned long recorded = getCount();
+    return recorded == 0 ? 0 : (double) sum.load(std::memory_order_relaxed) / recorded;
+}
+
+/** return the longest duration recorded */
+std::uint64_t LatencyHistogram::getMax() const
+{
+    return max.load(std::memory_order_relaxed);
+}
+
+/** return the duration percentile (0-100) of the recorded ones are at or below, 0 if none were recorded */
+std::uint64_t LatencyHistogram::getPercentile(double percentile) const
+{
+    // buckets may move on while they are summed up, that only blurs a percentile a little
+    unsigned long total = 0;
+    for (const std::atomic<unsigned long>& bucket : buckets)
+    {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+    unsigned long rank = (unsigned long) std::ceil(percentile / 100 * total);
+    rank = rank < 1 ? 1 : rank;
+    unsigned long seen = 0;
+    for (int bucket = 0; bucket < bucketCount; ++bucket)
+    {
+        seen += buckets[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            std::uint64_t value = bucketMax(bucket);
+            return value < getMax() ? value : getMax();
+        }
+    }
+    return getMax();
+}
+
+/** return the bucket of a value */
+int LatencyHistogram::bucketOf(std::uint64_t value)
+{
+    // values below 32 get a bucket each, above that 32 buckets per power of two
+    if (value < (std::uint64_t) subBuckets) {
+        return (int) value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int subBucket = (int) ((value >> (exponent - subBucketBits)) & (subBuckets - 1));
+    return (exponent - subBucketBits + 1) * subBuckets + subBucket;
+}
+
+/** return the largest value in a bucket */
+std::uint64_t LatencyHistogram::bucketMax(int bucket)
+{
+    if (bucket < subBuckets) {
+        return (std::uint64_t) bucket;
+    }
+    int exponent = bucket / subBuckets + subBucketBits - 1;
+    int subBucket = bucket % subBuckets;
+    std::uint64_t width = 1ull << (exponent - subBucketBits);
+    return ((std::uint64_t) (subBuckets + subBucket) << (exponent - subBucketBits)) + width - 1;
+}
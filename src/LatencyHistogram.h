@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/** a histogram of durations in nanoseconds, HDR style: buckets are spaced
+ * logarithmically and split into 32 linear sub-buckets each, so every recorded
+ * value is kept within ~3% from 1ns up to hours, in a fixed amount of memory.
+ *
+ * Recording is a few relaxed atomic adds, so sessions on several threads can
+ * share one histogram.
+ */
+class LatencyHistogram
+{
+    public:
+        LatencyHistogram();
+        /** add one duration */
+        void record(std::uint64_t nanoseconds);
+        /** return the amount of durations recorded */
+        unsigned long getCount() const;
+        /** return the mean duration, 0 if none were recorded */
+        double getMean() const;
+        /** return the longest duration recorded */
+        std::uint64_t getMax() const;
+        /** return the duration percentile (0-100) of the recorded ones are at or below, 0 if none were recorded */
+        std::uint64_t getPercentile(double percentile) const;
+
+    private:
+        static const int subBucketBits = 5;
+        static const int subBuckets = 1 << subBucketBits;
+        static const int bucketCount = (64 - subBucketBits + 1) * subBuckets;
+
+        /** return the bucket of a value */
+        static int bucketOf(std::uint64_t value);
+        /** return the largest value in a bucket */
+        static std::uint64_t bucketMax(int bucket);
+
+        std::atomic<unsigned long> buckets[bucketCount];
+        std::atomic<unsigned long> count;
+        std::atomic<std::uint64_t> sum;
+        std::atomic<std::uint64_t> max;
+};
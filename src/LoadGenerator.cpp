@@ -0,0 +1,192 @@
+#include "LoadGenerator.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <deque>
+#include <algorithm>
+#include <cstring>
+#include <charconv>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/** return whether address is a port number rather than a socket path */
+static bool isPortAddress(const std::string& address)
+{
+    return address.size() > 0 && address.find_first_not_of("0123456789") == std::string::npos;
+}
+
+/** return the port a port number address names, 0 if it is out of range */
+static unsigned short toPort(const std::string& address)
+{
+    unsigned long port = 0;
+    std::from_chars_result result = std::from_chars(address.data(), address.data() + address.size(), port);
+    if (result.ec != std::errc{} || port == 0 || port > 65535) {
+        return 0;
+    }
+    return (unsigned short) port;
+}
+
+/** commands are sent round robin, every connection keeps pipeline requests in flight */
+LoadGenerator::LoadGenerator(std::string _address,
+                             std::vector<std::string> _commands,
+                             unsigned int _connections,
+                             unsigned long _requests,
+                             unsigned int _pipeline)
+: address(_address),
+  commands(_commands),
+  connections(std::max(1u, _connections)),
+  requests(_requests),
+  pipeline(std::max(1u, _pipeline))
+{
+
+}
+
+/** run the load and print requests/s and p50/p90/p99/max latency, false if no connection could be made */
+bool LoadGenerator::run()
+{
+    std::vector<std::vector<double>> latencies(connections);
+    std::vector<std::thread> clients;
+    std::vector<char> succeeded(connections, 0);
+    if (isPortAddress(address) && toPort(address) == 0) {
+        std::cerr << "LoadGenerator::run port out of range " << address << std::endl;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < connections; ++i)
+    {
+        // spread the requests, the first connections take the remainder
+        unsigned long share = requests / connections + (i < requests % connections ? 1 : 0);
+        clients.emplace_back([this, i, share, &latencies, &succeeded]()
+        {
+            succeeded[i] = runConnection(share, latencies[i]);
+        });
+    }
+    for (std::thread& client : clients)
+    {
+        client.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<double> all;
+    for (unsigned int i = 0; i < connections; ++i)
+    {
+        all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+    }
+    if (std::count(succeeded.begin(), succeeded.end(), 0) == (long) connections) {
+        std::cerr << "LoadGenerator::run could not connect to " << address << std::endl;
+        return false;
+    }
+    if (all.size() == 0) {
+        std::cout << "no responses received" << std::endl;
+        return true;
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p)
+    {
+        return all[std::min(all.size() - 1, (std::size_t) (p * all.size()))];
+    };
+
+    std::cout << "connections: " << connections << " pipeline: " << pipeline << std::endl;
+    std::cout << "requests: " << all.size() << " in " << elapsed.count() << "s" << std::endl;
+    std::cout << "requests/s: " << all.size() / elapsed.count() << std::endl;
+    std::cout << "latency us p50: " << percentile(0.50)
+              << " p90: " << percentile(0.90)
+              << " p99: " << percentile(0.99)
+              << " max: " << all.back() << std::endl;
+    return true;
+}
+
+/** open a blocking connection to the server, -1 on failure */
+int LoadGenerator::connectToServer()
+{
+    int fd;
+    if (isPortAddress(address)) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(toPort(address));
+        if (fd < 0 || connect(fd, (sockaddr*) &addr, sizeof(addr)) != 0) {
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    } else {
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+        if (fd < 0 || connect(fd, (sockaddr*) &addr, sizeof(addr)) != 0) {
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+/** send requests over one connection, appending each latency in microseconds */
+bool LoadGenerator::runConnection(unsigned long share, std::vector<double>& latencies)
+{
+    int fd = connectToServer();
+    if (fd < 0) {
+        return false;
+    }
+    latencies.reserve(share);
+
+    // send times of the requests in flight, responses arrive in the same order
+    std::deque<std::chrono::steady_clock::time_point> inFlight;
+    unsigned long sent = 0;
+    std::string received;
+    char buffer[64 * 1024];
+    bool ok = true;
+
+    while (ok && latencies.size() < share)
+    {
+        // top up the pipeline
+        std::string batch;
+        while (sent < share && inFlight.size() < pipeline)
+        {
+            batch += commands[sent % commands.size()] + "\n";
+            inFlight.push_back(std::chrono::steady_clock::now());
+            sent++;
+        }
+        std::size_t offset = 0;
+        while (offset < batch.size())
+        {
+            ssize_t n = send(fd, batch.data() + offset, batch.size() - offset, MSG_NOSIGNAL);
+            if (n <= 0) {
+                ok = false;
+                break;
+            }
+            offset += n;
+        }
+
+        ssize_t n = ok ? recv(fd, buffer, sizeof(buffer), 0) : 0;
+        if (n <= 0) {
+            break;
+        }
+        received.append(buffer, n);
+
+        // every line holding a single "." ends one response
+        std::size_t start = 0;
+        std::size_t end;
+        while ((end = received.find('\n', start)) != std::string::npos)
+        {
+            if (end - start == 1 && received[start] == '.' && inFlight.size() > 0) {
+                std::chrono::duration<double, std::micro> latency = std::chrono::steady_clock::now() - inFlight.front();
+                latencies.push_back(latency.count());
+                inFlight.pop_front();
+            }
+            start = end + 1;
+        }
+        received.erase(0, start);
+    }
+    close(fd);
+    return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/** drives an AdvisorBotServer with many pipelined client connections
+ * and reports throughput and latency percentiles.
+ */
+class LoadGenerator
+{
+    public:
+        /** commands are sent round robin, every connection keeps pipeline requests in flight */
+        LoadGenerator(std::string address,
+                      std::vector<std::string> commands,
+                      unsigned int connections,
+                      unsigned long requests,
+                      unsigned int pipeline);
+        /** run the load and print requests/s and p50/p90/p99/max latency, false if no connection could be made */
+        bool run();
+
+    private:
+        /** open a blocking connection to the server, -1 on failure */
+        int connectToServer();
+        /** send requests over one connection, appending each latency in microseconds */
+        bool runConnection(unsigned long requests, std::vector<double>& latencies);
+
+        std::string address;
+        std::vector<std::string> commands;
+        unsigned int connections;
+        unsigned long requests;
+        unsigned int pipeline;
+};
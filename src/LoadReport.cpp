@@ -0,0 +1,103 @@
+#include "LoadReport.h"
+
+LoadReport::LoadReport(std::size_t _maxSamples)
+: maxSamples(_maxSamples), rows(0), errors{}
+{
+
+}
+
+/** count rows loaded */
+void LoadReport::addRows(unsigned long count)
+{
+    rows += count;
+}
+
+/** count a row rejected for error at lineNumber (1 based) */
+void LoadReport::addError(RowError error, unsigned long lineNumber)
+{
+    std::size_t kind = (std::size_t) error;
+    errors[kind]++;
+    if (samples[kind].size() < maxSamples) {
+        samples[kind].push_back(lineNumber);
+    }
+}
+
+/** add the counts of other, e.g. of another part of the same load */
+void LoadReport::merge(const LoadReport& other)
+{
+    rows += other.rows;
+    for (std::size_t kind = 0; kind < errorKinds; ++kind)
+    {
+        errors[kind] += other.errors[kind];
+        for (unsigned long lineNumber : other.samples[kind])
+        {
+            if (samples[kind].size() < maxSamples) {
+                samples[kind].push_back(lineNumber);
+            }
+        }
+    }
+}
+
+/** return the amount of rows loaded */
+unsigned long LoadReport::getRows() const
+{
+    return rows;
+}
+
+/** return the amount of rows rejected, for any reason */
+unsigned long LoadReport::getRejected() const
+{
+    unsigned long rejected = 0;
+    for (unsigned long count : errors)
+    {
+        rejected += count;
+    }
+    return rejected;
+}
+
+/** return the amount of rows rejected for error */
+unsigned long LoadReport::getErrors(RowError error) const
+{
+    return errors[(std::size_t) error];
+}
+
+/** return the first line numbers rejected for error */
+const std::vector<unsigned long>& LoadReport::getSamples(RowError error) const
+{
+    return samples[(std::size_t) error];
+}
+
+/** print loaded and rejected rows, one line per kind of error seen */
+void LoadReport::print(std::ostream& out) const
+{
+    out << "loaded " << rows << " rows, rejected " << getRejected() << "\n";
+    for (std::size_t kind = 0; kind < errorKinds; ++kind)
+    {
+        if (errors[kind] == 0) {
+            continue;
+        }
+        out << errorToString((RowError) kind) << ":\t" << errors[kind] << "\tlines";
+        for (unsigned long lineNumber : samples[kind])
+        {
+            out << " " << lineNumber;
+        }
+        out << (errors[kind] > samples[kind].size() ? " ..." : "") << "\n";
+    }
+}
+
+std::string LoadReport::errorToString(RowError error)
+{
+    if (error == RowError::fieldCount) {
+        return "wrong field count";
+    }
+    if (error == RowError::badPrice) {
+        return "bad price";
+    }
+    if (error == RowError::badAmount) {
+        return "bad amount";
+    }
+    if (error == RowError::unknownSide) {
+        return "unknown side";
+    }
+    return "none";
+}
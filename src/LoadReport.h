@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/** why a csv row of orders was rejected */
+enum class RowError{none, fieldCount, badPrice, badAmount, unknownSide};
+
+/** counts of the rows a load accepted and rejected, with the first few
+ * line numbers of every kind of rejected row so they can be looked up
+ */
+class LoadReport
+{
+    public:
+        LoadReport(std::size_t _maxSamples = 5);
+
+        /** count rows loaded */
+        void addRows(unsigned long count = 1);
+        /** count a row rejected for error at lineNumber (1 based) */
+        void addError(RowError error, unsigned long lineNumber);
+        /** add the counts of other, e.g. of another part of the same load */
+        void merge(const LoadReport& other);
+
+        /** return the amount of rows loaded */
+        unsigned long getRows() const;
+        /** return the amount of rows rejected, for any reason */
+        unsigned long getRejected() const;
+        /** return the amount of rows rejected for error */
+        unsigned long getErrors(RowError error) const;
+        /** return the first line numbers rejected for error */
+        const std::vector<unsigned long>& getSamples(RowError error) const;
+
+        /** print loaded and rejected rows, one line per kind of error seen */
+        void print(std::ostream& out) const;
+
+        static std::string errorToString(RowError error);
+
+    private:
+        static const std::size_t errorKinds = 5;
+
+        std::size_t maxSamples;
+        unsigned long rows;
+        std::array<unsigned long, errorKinds> errors;
+        std::array<std::vector<unsigned long>, errorKinds> samples;
+};
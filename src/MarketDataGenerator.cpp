@@ -0,0 +1,252 @@
+#include "MarketDataGenerator.h"
+#include "OrderArchive.h"
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+
+// the first products look like the real dataset, the rest are made up
+static const char* knownProducts[] = {"ETH/BTC", "DOGE/BTC", "BTC/USDT", "ETH/USDT", "DOGE/USDT"};
+static const double knownPrices[] = {0.0219, 0.00000031, 5350, 117, 0.00165};
+// units of 1e-8 in one
+static const double unitsPerOne = 1e8;
+
+MarketDataGenerator::MarketDataGenerator(MarketDataSettings _settings)
+: settings(_settings), randomState(_settings.seed), spareNormal(0), hasSpareNormal(false), rowsWritten(0), malformedWritten(0)
+{
+    for (unsigned int product = 0; product < settings.products; ++product)
+    {
+        if (product < 5) {
+            products.push_back(knownProducts[product]);
+            mids.push_back(knownPrices[product] * unitsPerOne);
+        } else {
+            products.push_back("COIN" + std::to_string(product) + "/BTC");
+            mids.push_back(std::exp(-9 + 8 * uniform()) * unitsPerOne);
+        }
+    }
+}
+
+/** return the products in the dataset */
+const std::vector<std::string>& MarketDataGenerator::getProducts() const
+{
+    return products;
+}
+
+/** write the dataset to filename, as an archive if it ends with .mkrx.
+ * Returns false if the file can't be written
+ * */
+bool MarketDataGenerator::write(std::string filename)
+{
+    std::int64_t startMicros = 0;
+    if (!OrderArchive::timestampToMicros(settings.startTime, startMicros)) {
+        std::cout << "MarketDataGenerator::write bad start time " << settings.startTime
+                  << ", expected e.g. 2020/03/17 17:01:24.884492" << std::endl;
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool archive = filename.size() > 5 && filename.substr(filename.size() - 5) == ".mkrx";
+    bool written = archive ? writeArchive(filename) : writeCSV(filename);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (written) {
+        std::cout << "MarketDataGenerator::write wrote " << rowsWritten << " rows (" << malformedWritten << " malformed) to "
+                  << filename << " in " << seconds << "s (" << rowsWritten / seconds << " rows/s)" << std::endl;
+    }
+    return written;
+}
+
+/** appends units of 1e-8 as a decimal, without trailing zeros */
+static void appendUnits(std::string& out, std::int64_t units)
+{
+    char digits[32];
+    int length = 0;
+    std::int64_t whole = units / 100000000;
+    std::int64_t fraction = units % 100000000;
+    do
+    {
+        digits[length++] = (char) ('0' + whole % 10);
+        whole /= 10;
+    } while (whole > 0);
+    while (length > 0)
+    {
+        out += digits[--length];
+    }
+    if (fraction > 0) {
+        int places = 8;
+        while (fraction % 10 == 0)
+        {
+            fraction /= 10;
+            places--;
+        }
+        out += '.';
+        char fractionDigits[8];
+        for (int place = places - 1; place >= 0; --place)
+        {
+            fractionDigits[place] = (char) ('0' + fraction % 10);
+            fraction /= 10;
+        }
+        out.append(fractionDigits, places);
+    }
+}
+
+bool MarketDataGenerator::writeCSV(std::string filename)
+{
+    std::ofstream file{filename, std::ios::binary};
+    if (!file.is_open()) {
+        std::cout << "MarketDataGenerator::write could not open " << filename << std::endl;
+        return false;
+    }
+
+    // rows are formatted by hand into a large buffer, streams are far too slow for 100M rows
+    const std::size_t flushSize = 4 << 20;
+    std::string buffer;
+    buffer.reserve(flushSize + 4096);
+    std::vector<Row> rows;
+    std::int64_t startMicros = 0;
+    OrderArchive::timestampToMicros(settings.startTime, startMicros);
+    std::int64_t interval = (std::int64_t) (settings.interval * 1e6);
+    for (unsigned long t = 0; t < settings.timestamps; ++t)
+    {
+        // the jitter stays below a tenth of the interval, so times keep increasing
+        std::int64_t jitter = interval > 10 ? (std::int64_t) (uniform() * (interval / 10)) : 0;
+        std::string timestamp = OrderArchive::microsToTimestamp(startMicros + (std::int64_t) t * interval + jitter);
+        generateTimestamp(rows);
+        for (const Row& row : rows)
+        {
+            std::size_t rowStart = buffer.size();
+            buffer += timestamp;
+            buffer += ',';
+            buffer += products[row.product];
+            buffer += row.ask ? ",ask," : ",bid,";
+            appendUnits(buffer, row.price);
+            buffer += ',';
+            appendUnits(buffer, row.amount);
+            buffer += '\n';
+
+            // break some rows the way real feeds do: letters in numbers, missing fields, blank lines
+            if (settings.malformedRate > 0 && uniform() < settings.malformedRate) {
+                std::string line = buffer.substr(rowStart);
+                buffer.resize(rowStart);
+                unsigned int kind = (unsigned int) (uniform() * 4);
+                if (kind == 0) {
+                    line[line.find(',', line.find(',', timestamp.size() + 1) + 1) + 3] = 'a';
+                } else if (kind == 1) {
+                    line[line.rfind(',') + 1] = 'a';
+                } else if (kind == 2) {
+                    line = line.substr(0, line.rfind(',')) + "\n";
+                } else {
+                    line = "\n";
+                }
+                buffer += line;
+                malformedWritten++;
+            }
+            rowsWritten++;
+        }
+        if (buffer.size() >= flushSize) {
+            file.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    file.write(buffer.data(), buffer.size());
+    file.close();
+    if (file.fail()) {
+        std::cout << "MarketDataGenerator::write could not write " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MarketDataGenerator::writeArchive(std::string filename)
+{
+    OrderArchiveWriter archive{filename, products};
+    if (!archive.isGood()) {
+        std::cout << "MarketDataGenerator::write could not open " << filename << std::endl;
+        return false;
+    }
+
+    // archives hold valid rows only, malformedRate doesn't apply
+    std::vector<Row> rows;
+    std::int64_t startMicros = 0;
+    OrderArchive::timestampToMicros(settings.startTime, startMicros);
+    std::int64_t interval = (std::int64_t) (settings.interval * 1e6);
+    OrderBookEntry order{0, 0, "", "", OrderBookType::ask};
+    for (unsigned long t = 0; t < settings.timestamps; ++t)
+    {
+        std::int64_t jitter = interval > 10 ? (std::int64_t) (uniform() * (interval / 10)) : 0;
+        order.timestamp = OrderArchive::microsToTimestamp(startMicros + (std::int64_t) t * interval + jitter);
+        generateTimestamp(rows);
+        for (const Row& row : rows)
+        {
+            // the same doubles the csv reader makes of the decimals
+            order.price = row.price / unitsPerOne;
+            order.amount = row.amount / unitsPerOne;
+            order.product = products[row.product];
+            order.orderType = row.ask ? OrderBookType::ask : OrderBookType::bid;
+            archive.add(order);
+            rowsWritten++;
+        }
+    }
+    return archive.close();
+}
+
+/** generate the rows of the next timestamp into rows */
+void MarketDataGenerator::generateTimestamp(std::vector<Row>& rows)
+{
+    rows.clear();
+    // every product and side gets an equal share of the rows, the first ones get the remainder
+    unsigned int slots = settings.products * 2;
+    for (unsigned int slot = 0; slot < slots; ++slot)
+    {
+        unsigned int product = slot / 2;
+        bool ask = slot % 2 == 1;
+        if (!ask) {
+            mids[product] *= std::exp(settings.volatility * normal());
+            if (mids[product] < 100) {
+                mids[product] = 100;
+            }
+        }
+        unsigned int levels = settings.rowsPerTimestamp / slots + (slot < settings.rowsPerTimestamp % slots ? 1 : 0);
+        double amountScale = unitsPerOne / std::sqrt(mids[product] / unitsPerOne);
+        for (unsigned int level = 0; level < levels; ++level)
+        {
+            // levels move away from the mid, crossing orders land on the other side of it
+            double offset = 0.0005 + level * 0.0002 + uniform() * 0.00005;
+            if (uniform() < settings.crossingRatio) {
+                offset = -uniform() * 0.002;
+            }
+            double price = mids[product] * (ask ? 1 + offset : 1 - offset);
+
+            // amounts are log normal with a random amount of decimals, like 0.21 or 7.44564869
+            static const std::int64_t scales[] = {100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1};
+            std::int64_t scale = scales[(int) (uniform() * 9)];
+            std::int64_t amountUnits = std::llround(std::exp(1.5 * normal()) * amountScale / scale) * scale;
+
+            rows.push_back(Row{product, ask, std::max<std::int64_t>(std::llround(price), 1), std::max<std::int64_t>(amountUnits, scale)});
+        }
+    }
+}
+
+/** uniform in [0, 1) */
+double MarketDataGenerator::uniform()
+{
+    // splitmix64
+    std::uint64_t z = (randomState += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/** standard normal */
+double MarketDataGenerator::normal()
+{
+    // Box-Muller gives two at a time, 1 - uniform() is never 0
+    if (hasSpareNormal) {
+        hasSpareNormal = false;
+        return spareNormal;
+    }
+    double radius = std::sqrt(-2 * std::log(1 - uniform()));
+    double angle = 6.283185307179586 * uniform();
+    spareNormal = radius * std::sin(angle);
+    hasSpareNormal = true;
+    return radius * std::cos(angle);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/** what a generated dataset looks like */
+struct MarketDataSettings
+{
+    unsigned int products = 5;
+    unsigned int rowsPerTimestamp = 440;
+    unsigned long timestamps = 1000;
+    // standard deviation of the mid price's log return per timestamp
+    double volatility = 0.001;
+    // share of orders priced on the wrong side of the mid, which the matching engine turns into sales
+    double crossingRatio = 0.02;
+    // share of csv rows written broken, the way 20200317.csv has some
+    double malformedRate = 0.0;
+    std::uint64_t seed = 42;
+    // the first timestamp, in the format of 20200317.csv
+    std::string startTime = "2020/03/17 17:01:24.884492";
+    // seconds between timestamps
+    double interval = 5;
+};
+
+/** writes synthetic order streams in the csv format of 20200317.csv or as an archive.
+ *
+ * Every product's mid price is a random walk, orders are laid out in levels around it
+ * on both sides. The same settings and seed always give the same file, on every
+ * platform: the random numbers don't come from the standard library's distributions.
+ */
+class MarketDataGenerator
+{
+    public:
+        MarketDataGenerator(MarketDataSettings settings);
+        /** write the dataset to filename, as an archive if it ends with .mkrx.
+         * Returns false if the start time is malformed or the file can't be written
+         * */
+        bool write(std::string filename);
+        /** return the products in the dataset */
+        const std::vector<std::string>& getProducts() const;
+
+    private:
+        /** one generated order, prices and amounts in units of 1e-8 */
+        struct Row
+        {
+            unsigned int product;
+            bool ask;
+            std::int64_t price;
+            std::int64_t amount;
+        };
+
+        /** generate the rows of the next timestamp into rows */
+        void generateTimestamp(std::vector<Row>& rows);
+        bool writeCSV(std::string filename);
+        bool writeArchive(std::string filename);
+
+        /** uniform in [0, 1) */
+        double uniform();
+        /** standard normal */
+        double normal();
+
+        MarketDataSettings settings;
+        std::vector<std::string> products;
+        // mid prices in units of 1e-8
+        std::vector<double> mids;
+        std::uint64_t randomState;
+        // the second normal of the last Box-Muller pair
+        double spareNormal;
+        bool hasSpareNormal;
+        unsigned long rowsWritten;
+        unsigned long malformedWritten;
+};
@@ -0,0 +1,372 @@
+#include "MarketExport.h"
+#include "OrderArchive.h"
+#include "BinaryCodec.h"
+#include "Trace.h"
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace BinaryCodec;
+
+// file: header, blocks, footer, trailer. Everything is little endian and 8 byte aligned.
+// header: magic, version, padding.
+// block: table, rows, first time, last time, then the columns, each padded to 8 bytes.
+// footer: product count, products (length, bytes), padding, block count, blocks (offset, table, rows, first time, last time).
+// trailer: footer offset, magic, padding.
+static const char exportMagic[4] = {'M', 'K', 'R', 'C'};
+static const unsigned char exportVersion = 1;
+static const std::size_t headerBytes = 8;
+static const std::size_t blockHeaderBytes = 24;
+static const std::size_t directoryEntryBytes = 32;
+static const std::size_t trailerBytes = 16;
+
+/** pad out to a multiple of 8 bytes, from where the string starts in the file */
+static void pad(std::string& out, std::uint64_t start)
+{
+    while ((start + out.size()) % 8 != 0)
+    {
+        out += '\0';
+    }
+}
+
+/** read a little endian value at pos of a mapped file */
+static std::uint64_t readFixed(const unsigned char* data, std::size_t pos, int bytes)
+{
+    std::uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+    {
+        value |= (std::uint64_t) data[pos + i] << (8 * i);
+    }
+    return value;
+}
+
+/** orders of a timestamp grouped by product and side, levels best price first */
+static bool compareForDepth(const OrderBookEntry& e1, const OrderBookEntry& e2)
+{
+    if (e1.product != e2.product) {
+        return e1.product < e2.product;
+    }
+    if (e1.orderType != e2.orderType) {
+        return e1.orderType < e2.orderType;
+    }
+    return e1.orderType == OrderBookType::bid ? e1.price > e2.price : e1.price < e2.price;
+}
+
+ExportSummary::ExportSummary()
+: depthRows(0),
+  tradeRows(0),
+  blocks(0),
+  depthAmount(0),
+  tradeAmount(0),
+  firstTime(std::numeric_limits<std::int64_t>::max()),
+  lastTime(std::numeric_limits<std::int64_t>::min())
+{
+
+}
+
+MarketExport::MarketExport(std::string filename, std::size_t _blockRows)
+: file(filename, std::ios::binary | std::ios::trunc), offset(0), blockRows(std::max<std::size_t>(_blockRows, 1)), closed(false)
+{
+    std::string header{exportMagic, 4};
+    header += (char) exportVersion;
+    pad(header, 0);
+    file.write(header.data(), header.size());
+    offset = header.size();
+}
+
+MarketExport::~MarketExport()
+{
+    close();
+}
+
+/** return false if the file couldn't be opened or written */
+bool MarketExport::isGood() const
+{
+    return file.good();
+}
+
+/** add the depth and the sales of one timestamp's orders of every product */
+bool MarketExport::addTimestamp(const std::string& timestamp, const std::vector<OrderBookEntry>& orders)
+{
+    std::int64_t time;
+    if (closed || !OrderArchive::timestampToMicros(timestamp, time)) {
+        return false;
+    }
+    std::vector<OrderBookEntry> sorted = orders;
+    std::sort(sorted.begin(), sorted.end(), compareForDepth);
+
+    std::vector<OrderBookEntry> asks;
+    std::vector<OrderBookEntry> bids;
+    for (std::size_t first = 0; first < sorted.size(); )
+    {
+        const std::string& product = sorted[first].product;
+        std::uint32_t productCode = getProductCode(product);
+        asks.clear();
+        bids.clear();
+        std::size_t end = first;
+        while (end < sorted.size() && sorted[end].product == product)
+        {
+            const OrderBookEntry& order = sorted[end];
+            if (order.orderType != OrderBookType::ask && order.orderType != OrderBookType::bid) {
+                ++end;
+                continue;
+            }
+            // one level per price, its orders follow each other
+            if (depth.time.size() > 0 && end > first
+                && sorted[end - 1].orderType == order.orderType && sorted[end - 1].price == order.price) {
+                depth.amount.back() += order.amount;
+                depth.orders.back()++;
+            } else {
+                if (depth.time.size() == blockRows) {
+                    writeBlock(ExportTable::depth);
+                }
+                depth.time.push_back(time);
+                depth.product.push_back(productCode);
+                depth.side.push_back((std::uint32_t) order.orderType);
+                depth.price.push_back(order.price);
+                depth.amount.push_back(order.amount);
+                depth.orders.push_back(1);
+            }
+            (order.orderType == OrderBookType::ask ? asks : bids).push_back(order);
+            ++end;
+        }
+
+        // the sales the time frame makes, its asks matched against its bids
+        if (asks.size() > 0 && bids.size() > 0) {
+            for (const OrderBookEntry& sale : OrderBook::matchOrders(asks, bids, product, timestamp))
+            {
+                if (trades.time.size() == blockRows) {
+                    writeBlock(ExportTable::trades);
+                }
+                trades.time.push_back(time);
+                trades.product.push_back(productCode);
+                trades.side.push_back((std::uint32_t) sale.orderType);
+                trades.price.push_back(sale.price);
+                trades.amount.push_back(sale.amount);
+            }
+        }
+        first = end;
+    }
+    return true;
+}
+
+/** write the last blocks and the footer */
+bool MarketExport::close()
+{
+    if (closed) {
+        return !file.fail();
+    }
+    writeBlock(ExportTable::depth);
+    writeBlock(ExportTable::trades);
+
+    std::uint64_t footerOffset = offset;
+    std::string footer;
+    putFixed(footer, products.size(), 4);
+    for (const std::string& product : products)
+    {
+        putFixed(footer, product.size(), 4);
+        footer += product;
+    }
+    pad(footer, footerOffset);
+    putFixed(footer, blocks.size(), 8);
+    for (const BlockEntry& block : blocks)
+    {
+        putFixed(footer, block.offset, 8);
+        putFixed(footer, (std::uint32_t) block.table, 4);
+        putFixed(footer, block.rows, 4);
+        putFixed(footer, (std::uint64_t) block.firstTime, 8);
+        putFixed(footer, (std::uint64_t) block.lastTime, 8);
+    }
+    putFixed(footer, footerOffset, 8);
+    footer.append(exportMagic, 4);
+    pad(footer, footerOffset);
+    file.write(footer.data(), footer.size());
+    file.close();
+    closed = true;
+    return !file.fail();
+}
+
+/** return the dictionary code of product, adding it the first time */
+std::uint32_t MarketExport::getProductCode(const std::string& product)
+{
+    auto it = productCodes.find(product);
+    if (it != productCodes.end()) {
+        return it->second;
+    }
+    productCodes.emplace(product, (std::uint32_t) products.size());
+    products.push_back(product);
+    return products.size() - 1;
+}
+
+/** write the table's rows as a block if there are any */
+void MarketExport::writeBlock(ExportTable table)
+{
+    TableBlock& rows = table == ExportTable::depth ? depth : trades;
+    std::size_t count = rows.time.size();
+    if (count == 0) {
+        return;
+    }
+    TraceScope scope{"MarketExport::writeBlock", "export", std::to_string(count) + " rows"};
+    std::string block;
+    block.reserve(blockHeaderBytes + count * 40 + 32);
+    putFixed(block, (std::uint32_t) table, 4);
+    putFixed(block, count, 4);
+    putFixed(block, (std::uint64_t) rows.time.front(), 8);
+    putFixed(block, (std::uint64_t) rows.time.back(), 8);
+    for (std::int64_t value : rows.time)
+    {
+        putFixed(block, (std::uint64_t) value, 8);
+    }
+    for (std::uint32_t value : rows.product)
+    {
+        putFixed(block, value, 4);
+    }
+    pad(block, offset);
+    for (std::uint32_t value : rows.side)
+    {
+        putFixed(block, value, 4);
+    }
+    pad(block, offset);
+    for (double value : rows.price)
+    {
+        putFixed(block, doubleToBits(value), 8);
+    }
+    for (double value : rows.amount)
+    {
+        putFixed(block, doubleToBits(value), 8);
+    }
+    if (table == ExportTable::depth) {
+        for (std::uint32_t value : rows.orders)
+        {
+            putFixed(block, value, 4);
+        }
+        pad(block, offset);
+    }
+
+    blocks.push_back(BlockEntry{offset, table, (std::uint32_t) count, rows.time.front(), rows.time.back()});
+    file.write(block.data(), block.size());
+    offset += block.size();
+    rows.time.clear();
+    rows.product.clear();
+    rows.side.clear();
+    rows.price.clear();
+    rows.amount.clear();
+    rows.orders.clear();
+}
+
+/** export every timestamp of book */
+bool MarketExport::write(std::string filename, const OrderBook& book)
+{
+    TraceScope scope{"MarketExport::write", "export", filename};
+    MarketExport exporter{filename};
+    if (!exporter.isGood()) {
+        std::cout << "MarketExport: could not open " << filename << std::endl;
+        return false;
+    }
+    // one timestamp's rows are held at a time, the book's rows are sorted by timestamp
+    std::vector<OrderBookEntry> orders;
+    const OrderStore& rows = book.getRows();
+    for (auto it = rows.begin(); it != rows.end(); )
+    {
+        std::string_view timestamp = it->timestamp;
+        orders.clear();
+        for (; it != rows.end() && it->timestamp == timestamp; ++it)
+        {
+            orders.push_back(it->toEntry());
+        }
+        if (!exporter.addTimestamp(std::string{timestamp}, orders)) {
+            std::cout << "MarketExport: skipped timestamp " << timestamp << ", it isn't like 2020/03/17 17:01:24.884492" << std::endl;
+        }
+    }
+    if (!exporter.close()) {
+        std::cout << "MarketExport: could not write " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/** map an export file and scan its columns */
+bool MarketExport::scan(std::string filename, ExportSummary& summary)
+{
+    TraceScope scope{"MarketExport::scan", "export", filename};
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    struct stat status;
+    if (fd < 0 || ::fstat(fd, &status) != 0) {
+        std::cout << "MarketExport: could not open " << filename << std::endl;
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+    std::size_t size = status.st_size;
+    void* mapped = size > 0 ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cout << "MarketExport: could not map " << filename << std::endl;
+        return false;
+    }
+    const unsigned char* data = static_cast<const unsigned char*>(mapped);
+
+    bool valid = size >= headerBytes + trailerBytes
+                 && std::equal(exportMagic, exportMagic + 4, data) && data[4] == exportVersion
+                 && std::equal(exportMagic, exportMagic + 4, data + size - trailerBytes + 8);
+    std::uint64_t footerOffset = valid ? readFixed(data, size - trailerBytes, 8) : 0;
+    valid = valid && footerOffset >= headerBytes && footerOffset + 4 <= size - trailerBytes;
+    if (valid) {
+        // skip the dictionary to the block directory
+        std::size_t pos = footerOffset;
+        std::uint64_t productCount = readFixed(data, pos, 4);
+        pos += 4;
+        for (std::uint64_t i = 0; i < productCount && valid; ++i)
+        {
+            valid = pos + 4 <= size - trailerBytes;
+            pos += valid ? 4 + readFixed(data, pos, 4) : 0;
+        }
+        pos = (pos + 7) / 8 * 8;
+        valid = valid && pos + 8 <= size - trailerBytes;
+        std::uint64_t blockCount = valid ? readFixed(data, pos, 8) : 0;
+        pos += 8;
+        valid = valid && blockCount <= (size - trailerBytes - pos) / directoryEntryBytes;
+        for (std::uint64_t i = 0; i < blockCount && valid; ++i, pos += directoryEntryBytes)
+        {
+            std::uint64_t blockOffset = readFixed(data, pos, 8);
+            ExportTable table = (ExportTable) readFixed(data, pos + 8, 4);
+            std::uint64_t rows = readFixed(data, pos + 12, 4);
+            // time, product, side, price, amount (and orders) columns, each padded to 8 bytes
+            std::uint64_t columnBytes = rows * 8 + (rows * 4 + 7) / 8 * 8 * 2 + rows * 16
+                                        + (table == ExportTable::depth ? (rows * 4 + 7) / 8 * 8 : 0);
+            valid = blockOffset % 8 == 0 && blockOffset >= headerBytes && blockOffset + blockHeaderBytes + columnBytes <= footerOffset
+                    && readFixed(data, blockOffset + 4, 4) == rows;
+            if (!valid) {
+                break;
+            }
+            summary.blocks++;
+            summary.firstTime = std::min(summary.firstTime, (std::int64_t) readFixed(data, blockOffset + 8, 8));
+            summary.lastTime = std::max(summary.lastTime, (std::int64_t) readFixed(data, blockOffset + 16, 8));
+            // the columns are read in place, as a research tool would (little endian hosts)
+            std::uint64_t amountOffset = blockOffset + blockHeaderBytes + rows * 8 + (rows * 4 + 7) / 8 * 8 * 2 + rows * 8;
+            const double* amounts = reinterpret_cast<const double*>(data + amountOffset);
+            double amount = 0;
+            for (std::uint64_t row = 0; row < rows; ++row)
+            {
+                amount += amounts[row];
+            }
+            if (table == ExportTable::depth) {
+                summary.depthRows += rows;
+                summary.depthAmount += amount;
+            } else {
+                summary.tradeRows += rows;
+                summary.tradeAmount += amount;
+            }
+        }
+    }
+    ::munmap(mapped, size);
+    if (!valid) {
+        std::cout << "MarketExport: " << filename << " is not an export" << std::endl;
+    }
+    return valid;
+}
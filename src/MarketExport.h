@@ -0,0 +1,103 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <unordered_map>
+#include "OrderBookEntry.h"
+#include "OrderBook.h"
+
+/** the tables of an export */
+enum class ExportTable{depth, trades};
+
+/** what a scan of an export found */
+struct ExportSummary
+{
+    ExportSummary();
+
+    std::uint64_t depthRows;
+    std::uint64_t tradeRows;
+    std::uint64_t blocks;
+    // sums of the amount columns, the depth on the book and the volume traded
+    double depthAmount;
+    double tradeAmount;
+    std::int64_t firstTime;
+    std::int64_t lastTime;
+};
+
+/** writes the market data this engine computes, for every timestamp the depth per price level
+ * of every product and side (L2) and the trade tape, the sales OrderBook::matchOrders makes of them,
+ * as a columnar binary file for research tools.
+ *
+ * The file is written as it goes: rows gather in a block per table, and a full block is
+ * written as one column after the other, every value fixed width little endian and every
+ * column starting at a multiple of 8 bytes. A footer written on close holds the product
+ * dictionary and a directory of the blocks (table, rows, time range, offset), and the file
+ * ends with the footer's offset and the magic. So a reader maps the file, reads the footer
+ * and then uses the columns in place, and the writer holds one block per table at most.
+ *
+ * depth columns:  time (int64 microseconds since 1970), product (uint32 dictionary code),
+ *                 side (uint32, OrderBookType: bid, ask), price (float64), amount (float64),
+ *                 orders (uint32)
+ * trades columns: time, product, side (uint32, OrderBookType: asksale, bidsale), price, amount
+ */
+class MarketExport
+{
+    public:
+        /** start an export file, blockRows rows per block and table */
+        MarketExport(std::string filename, std::size_t blockRows = 65536);
+        /** closes the file if close wasn't called */
+        ~MarketExport();
+        /** return false if the file couldn't be opened or written */
+        bool isGood() const;
+        /** add the depth and the sales of one timestamp's orders of every product, e.g. the
+         * rows of the timestamp in an OrderBook. False if the timestamp isn't like 2020/03/17 17:01:24.884492
+         * */
+        bool addTimestamp(const std::string& timestamp, const std::vector<OrderBookEntry>& orders);
+        /** write the last blocks and the footer, false if anything couldn't be written */
+        bool close();
+
+        /** export every timestamp of book, returning false if the file couldn't be written */
+        static bool write(std::string filename, const OrderBook& book);
+        /** map an export file and scan its columns, false if it isn't one */
+        static bool scan(std::string filename, ExportSummary& summary);
+
+    private:
+        /** the columns of the block of one table being filled */
+        struct TableBlock
+        {
+            std::vector<std::int64_t> time;
+            std::vector<std::uint32_t> product;
+            std::vector<std::uint32_t> side;
+            std::vector<double> price;
+            std::vector<double> amount;
+            // depth only
+            std::vector<std::uint32_t> orders;
+        };
+
+        /** a written block, as listed in the footer */
+        struct BlockEntry
+        {
+            std::uint64_t offset;
+            ExportTable table;
+            std::uint32_t rows;
+            std::int64_t firstTime;
+            std::int64_t lastTime;
+        };
+
+        /** return the dictionary code of product, adding it the first time */
+        std::uint32_t getProductCode(const std::string& product);
+        /** write the table's rows as a block if there are any */
+        void writeBlock(ExportTable table);
+
+        std::ofstream file;
+        std::uint64_t offset;
+        std::size_t blockRows;
+        TableBlock depth;
+        TableBlock trades;
+        std::unordered_map<std::string, std::uint32_t> productCodes;
+        std::vector<std::string> products;
+        std::vector<BlockEntry> blocks;
+        bool closed;
+};
@@ -0,0 +1,110 @@
+#include "MatchCache.h"
+#include "Metrics.h"
+#include <iostream>
+
+MatchCache::MatchCache()
+: hits(0), misses(0)
+{
+
+}
+
+/** return the cached result of product at timestamp, nullptr if it has to be matched */
+const MatchResult* MatchCache::lookup(const std::string& product, const std::string& timestamp)
+{
+    static std::atomic<unsigned long>& allHits = Metrics::global().counter("matchcache.hits");
+    static std::atomic<unsigned long>& allMisses = Metrics::global().counter("matchcache.misses");
+    auto it = results.find(makeKey(product, timestamp));
+    if (it == results.end()) {
+        misses++;
+        allMisses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    hits++;
+    allHits.fetch_add(1, std::memory_order_relaxed);
+    return &it->second;
+}
+
+/** remember the sales matchAsksToBids made of product at timestamp in book */
+void MatchCache::store(const std::string& product, const std::string& timestamp, const std::vector<OrderBookEntry>& sales, const OrderBook& book)
+{
+    std::string key = makeKey(product, timestamp);
+    if (userTimeframes.count(key) > 0) {
+        return;
+    }
+    MatchResult result;
+    for (const OrderBookEntry& sale : sales)
+    {
+        if (sale.username != "dataset") {
+            return;
+        }
+        result.sales.push_back({sale.price, sale.amount});
+    }
+    // the extremes matchAsksToBids prints, from the book's price summaries of the time frame.
+    // matchAsksToBids takes the first half of getOrdersByBidAsk, the asks, for the bids
+    PriceSummary asks = book.getPriceSummary(product, OrderBookType::bid, timestamp, timestamp);
+    PriceSummary bids = book.getPriceSummary(product, OrderBookType::ask, timestamp, timestamp);
+    result.matched = asks.count > 0 && bids.count > 0;
+    result.maxAsk = asks.max;
+    result.minAsk = asks.min;
+    result.maxBid = bids.max;
+    result.minBid = bids.min;
+    results[key] = std::move(result);
+}
+
+/** one of our orders went into product at timestamp, match it live from now on */
+void MatchCache::markUserOrder(const std::string& product, const std::string& timestamp)
+{
+    std::string key = makeKey(product, timestamp);
+    results.erase(key);
+    userTimeframes.insert(key);
+}
+
+/** forget everything, then mark the time frames of every order in book that isn't the dataset's */
+void MatchCache::reset(const OrderBook& book)
+{
+    results.clear();
+    userTimeframes.clear();
+    for (const OrderRow& row : book.getRows())
+    {
+        if (row.username != "dataset") {
+            userTimeframes.insert(makeKey(row.product, row.timestamp));
+        }
+    }
+}
+
+/** print what matchAsksToBids prints for the result */
+void MatchCache::print(const MatchResult& result)
+{
+    // the same lines, without flushing after every one
+    if (!result.matched) {
+        std::cout << " OrderBook::matchAsksToBids no bids or asks" << "\n";
+        return;
+    }
+    std::cout << "max ask " << result.maxAsk << "\n";
+    std::cout << "min ask " << result.minAsk << "\n";
+    std::cout << "max bid " << result.maxBid << "\n";
+    std::cout << "min bid " << result.minBid << "\n";
+}
+
+/** return amount of lookups that found a result */
+unsigned long MatchCache::getHits() const
+{
+    return hits;
+}
+
+/** return amount of lookups that did not find a result */
+unsigned long MatchCache::getMisses() const
+{
+    return misses;
+}
+
+/** build the key of a time frame */
+std::string MatchCache::makeKey(std::string_view product, std::string_view timestamp)
+{
+    std::string key;
+    key.reserve(product.size() + timestamp.size() + 1);
+    key.append(product.data(), product.size());
+    key += '|';
+    key.append(timestamp.data(), timestamp.size());
+    return key;
+}
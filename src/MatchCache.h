@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <unordered_set>
+#include "OrderBookEntry.h"
+#include "OrderBook.h"
+
+/** the outcome of matching one product at one timestamp, as matchAsksToBids reports it */
+struct MatchResult
+{
+    // false if there were no asks or no bids to match
+    bool matched;
+    double maxAsk;
+    double minAsk;
+    double maxBid;
+    double minBid;
+    // price and amount of every sale, in the order they were made
+    std::vector<std::pair<double, double>> sales;
+};
+
+/** remembers the matching of the time frames (product and timestamp) that hold dataset orders only.
+ * The dataset's orders of a time frame never change, so neither do their sales: a time frame is
+ * matched once and replayed from here every time the simulation comes back to it, after wrapping
+ * around to the start or jumping back. Once one of our orders goes into a time frame it is
+ * matched live, as our sales settle into the wallet
+ */
+class MatchCache
+{
+    public:
+        MatchCache();
+        /** return the cached result of product at timestamp, nullptr if it has to be matched */
+        const MatchResult* lookup(const std::string& product, const std::string& timestamp);
+        /** remember the sales matchAsksToBids made of product at timestamp in book, unless one of
+         * our orders is in the time frame
+         * */
+        void store(const std::string& product, const std::string& timestamp, const std::vector<OrderBookEntry>& sales, const OrderBook& book);
+        /** one of our orders went into product at timestamp, match it live from now on */
+        void markUserOrder(const std::string& product, const std::string& timestamp);
+        /** forget everything, then mark the time frames of every order in book that isn't the dataset's */
+        void reset(const OrderBook& book);
+        /** print what matchAsksToBids prints for the result */
+        static void print(const MatchResult& result);
+
+        /** return amount of lookups that found a result */
+        unsigned long getHits() const;
+        /** return amount of lookups that did not find a result */
+        unsigned long getMisses() const;
+
+    private:
+        /** build the key of a time frame */
+        static std::string makeKey(std::string_view product, std::string_view timestamp);
+
+        std::unordered_map<std::string, MatchResult> results;
+        // time frames holding one of our orders
+        std::unordered_set<std::string> userTimeframes;
+        unsigned long hits;
+        unsigned long misses;
+};
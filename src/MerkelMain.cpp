@@ -1,22 +1,33 @@
 #include "MerkelMain.h"
 #include <iostream>
+#include <fstream>
 #include <vector>
 #include "OrderBookEntry.h"
 #include "CSVReader.h"
+#include "Trace.h"
+#include "SimulationCheckpoint.h"
+#include <algorithm>
+#include <charconv>
+#include <cctype>
 
-MerkelMain::MerkelMain()
+MerkelMain::MerkelMain(std::string dataFile)
+: baseFile(dataFile)
 {
-
+    if (dataFile != "") {
+        orderBook = OrderBook{dataFile};
+    }
 }
 
 void MerkelMain::init()
 {
     int input;
-    currentTime = orderBook.getEarliestTime();
-
-    wallet.insertCurrency("BTC", 10);
+    // a restored simulation carries on where it was
+    if (currentTime == "") {
+        start();
+    }
 
-    while(true)
+    // until the input ends, e.g. a scripted run
+    while(std::cin)
     {
         printMenu();
         input = getUserOption();
@@ -25,6 +36,14 @@ void MerkelMain::init()
 }
 
 
+/** set up the start of a simulation over the dataset */
+void MerkelMain::start()
+{
+    currentTime = orderBook.getEarliestTime();
+    wallet.insertCurrency("BTC", 10);
+    takeCheckpoint();
+}
+
 void MerkelMain::printMenu()
 {
     // 1 print help
@@ -39,6 +58,14 @@ void MerkelMain::printMenu()
     std::cout << "5: Print wallet " << std::endl;
     // 6 continue   
     std::cout << "6: Continue " << std::endl;
+    // 7 jump to a time
+    std::cout << "7: Go to time " << std::endl;
+    // 8 step back
+    std::cout << "8: Go back " << std::endl;
+    // 9 save the simulation
+    std::cout << "9: Save checkpoint " << std::endl;
+    // 10 load a saved simulation
+    std::cout << "10: Restore checkpoint " << std::endl;
 
     std::cout << "============== " << std::endl;
 
@@ -88,8 +115,8 @@ void MerkelMain::enterAsk()
     std::string input;
     std::getline(std::cin, input);
 
-    std::vector<std::string> tokens = CSVReader::tokenise(input, ',');
-    if (tokens.size() != 3)
+    std::string_view tokens[3];
+    if (CSVReader::tokenise(input, ',', tokens, 3) != 3)
     {
         std::cout << "MerkelMain::enterAsk Bad input! " << input << std::endl;
     }
@@ -106,7 +133,7 @@ void MerkelMain::enterAsk()
             if (wallet.canFulfillOrder(obe))
             {
                 std::cout << "Wallet looks good. " << std::endl;
-                orderBook.insertOrder(obe);
+                insertUserOrder(obe);
             }
             else {
                 std::cout << "Wallet has insufficient funds . " << std::endl;
@@ -124,8 +151,8 @@ void MerkelMain::enterBid()
     std::string input;
     std::getline(std::cin, input);
 
-    std::vector<std::string> tokens = CSVReader::tokenise(input, ',');
-    if (tokens.size() != 3)
+    std::string_view tokens[3];
+    if (CSVReader::tokenise(input, ',', tokens, 3) != 3)
     {
         std::cout << "MerkelMain::enterBid Bad input! " << input << std::endl;
     }
@@ -143,7 +170,7 @@ void MerkelMain::enterBid()
             if (wallet.canFulfillOrder(obe))
             {
                 std::cout << "Wallet looks good. " << std::endl;
-                orderBook.insertOrder(obe);
+                insertUserOrder(obe);
             }
             else {
                 std::cout << "Wallet has insufficient funds . " << std::endl;
@@ -160,34 +187,371 @@ void MerkelMain::printWallet()
     std::cout << wallet.toString() << std::endl;
 }
         
-void MerkelMain::gotoNextTimeframe()
+void MerkelMain::gotoNextTimeframe(bool verbose)
 {
-    std::cout << "Going to next time frame. " << std::endl;
+    TraceScope scope{"MerkelMain::gotoNextTimeframe", "match", currentTime};
+    if (verbose) std::cout << "Going to next time frame. " << std::endl;
+    std::vector<OrderBookEntry> ourSales;
     for (std::string p : orderBook.getKnownProducts())
     {
-        std::cout << "matching " << p << std::endl;
-        std::vector<OrderBookEntry> sales =  orderBook.matchAsksToBids(p, currentTime);
-        std::cout << "Sales: " << sales.size() << std::endl;
+        TraceScope productScope{"MerkelMain::gotoNextTimeframe product", "match", p};
+        if (verbose) std::cout << "matching " << p << std::endl;
+        // a time frame of dataset orders only was matched before, and it has none of our sales
+        const MatchResult* cached = matchCache.lookup(p, currentTime);
+        if (cached != nullptr) {
+            if (verbose) {
+                MatchCache::print(*cached);
+                std::cout << "Sales: " << cached->sales.size() << std::endl;
+                for (const std::pair<double, double>& sale : cached->sales)
+                {
+                    std::cout << "Sale price: " << sale.first << " amount " << sale.second << std::endl; 
+                }
+            }
+            continue;
+        }
+        std::vector<OrderBookEntry> sales =  orderBook.matchAsksToBids(p, currentTime, !verbose);
+        matchCache.store(p, currentTime, sales, orderBook);
+        if (verbose) {
+            std::cout << "Sales: " << sales.size() << std::endl;
+            for (OrderBookEntry& sale : sales)
+            {
+                std::cout << "Sale price: " << sale.price << " amount " << sale.amount << std::endl; 
+            }
+        }
         for (OrderBookEntry& sale : sales)
         {
-            std::cout << "Sale price: " << sale.price << " amount " << sale.amount << std::endl; 
-            if (sale.username == "simuser")
+            if (sale.username == "simuser") {
+                ourSales.push_back(sale);
+            }
+        }
+    }
+    settleTimeframe(ourSales);
+}
+
+/** settle our sales of the current time frame and move on to the next */
+void MerkelMain::settleTimeframe(const std::vector<OrderBookEntry>& sales)
+{
+    // update the wallet with our own sales
+    wallet.processSales(sales, "simuser");
+    journalEvent(JournalRecord{JournalRecordType::timeframe, currentTime, sales}, false);
+
+    std::string nextTime = orderBook.getNextTime(currentTime);
+    bool wrapped = nextTime <= currentTime;
+    currentTime = nextTime;
+    if (wrapped) {
+        // wrapped around to the start, the checkpoints ahead belong to the previous run
+        checkpoints.clear();
+        takeCheckpoint();
+    } else if (++stepsSinceCheckpoint >= checkpointInterval) {
+        takeCheckpoint();
+    }
+    if (!replaying && autoCheckpointInterval > 0 && ++stepsSinceSave >= autoCheckpointInterval) {
+        saveCheckpoint(autoCheckpointFile);
+    }
+}
+
+void MerkelMain::enterGoto()
+{
+    std::cout << "Go to a time, or a number of time frames forward or back, eg 2020/03/17 17:05 or +10 or -10" << std::endl;
+    std::string input;
+    std::getline(std::cin, input);
+    if (input.size() > 1 && (input[0] == '+' || input[0] == '-')) {
+        long steps = 0;
+        std::from_chars_result result = std::from_chars(input.data() + 1, input.data() + input.size(), steps);
+        if (result.ec != std::errc{} || result.ptr != input.data() + input.size()) {
+            std::cout << "MerkelMain::enterGoto Bad input! " << input << std::endl;
+            return;
+        }
+        gotoTime(orderBook.offsetTime(currentTime, input[0] == '-' ? -steps : steps));
+        return;
+    }
+    if (input.size() == 0 || !std::isdigit((unsigned char) input[0])) {
+        std::cout << "MerkelMain::enterGoto Bad input! " << input << std::endl;
+        return;
+    }
+    gotoTime(orderBook.findTime(input));
+}
+
+void MerkelMain::gotoPreviousTimeframe()
+{
+    std::string previousTime = orderBook.getPreviousTime(currentTime);
+    if (previousTime == "") {
+        std::cout << "Already at the first time frame" << std::endl;
+        return;
+    }
+    gotoTime(previousTime);
+}
+
+/** move the simulation to target: forward by matching every time frame on the way,
+ * back by restoring the latest checkpoint at or before target and matching from there
+ * */
+void MerkelMain::gotoTime(std::string target)
+{
+    TraceScope scope{"MerkelMain::gotoTime", "match", target};
+    // the jump is one event, replaying it matches the same time frames again
+    journalEvent(JournalRecord{JournalRecordType::jump, target, {}}, false);
+    bool wasReplaying = replaying;
+    replaying = true;
+    if (target < checkpoints.front().time) {
+        // a restored simulation doesn't know what came before it
+        std::cout << "Can't go back before " << checkpoints.front().time << std::endl;
+        target = checkpoints.front().time;
+    }
+    if (target < currentTime) {
+        // checkpoints.front() is at or before target, so there always is one
+        auto checkpoint = std::upper_bound(checkpoints.begin(), checkpoints.end(), target,
+                                           [](const std::string& time, const Checkpoint& c) { return time < c.time; }) - 1;
+        currentTime = checkpoint->time;
+        wallet = checkpoint->wallet;
+        // keep our orders from before the checkpoint and the ones entered after it at a time before
+        // target, matching forward to target trades them again; the rest weren't entered yet at target
+        std::vector<OrderBookEntry> earlierOrders{userOrders.begin(), userOrders.begin() + checkpoint->userOrders};
+        for (auto order = userOrders.begin() + checkpoint->userOrders; order != userOrders.end(); ++order)
+        {
+            if (order->timestamp < target) {
+                earlierOrders.push_back(*order);
+            }
+        }
+        if (earlierOrders.size() < userOrders.size()) {
+            // undo our later orders: start over from the book as loaded with the earlier ones
+            userOrders = std::move(earlierOrders);
+            orderBook = *datasetBook;
+            for (OrderBookEntry& order : userOrders)
             {
-                // update the wallet
-                wallet.processSale(sale);
+                orderBook.insertOrder(order);
             }
         }
-        
+        checkpoints.erase(checkpoint + 1, checkpoints.end());
+        stepsSinceCheckpoint = 0;
+    }
+    // match every time frame up to the target, stopping if the book wraps around
+    while (currentTime < target)
+    {
+        std::string previousTime = currentTime;
+        gotoNextTimeframe(false);
+        if (currentTime <= previousTime) {
+            break;
+        }
+    }
+    replaying = wasReplaying;
+    std::cout << "Current time is: " << currentTime << std::endl;
+}
+
+/** add an order of ours to the book, logging it so checkpoints can undo it */
+void MerkelMain::insertUserOrder(OrderBookEntry& order)
+{
+    if (!datasetBook) {
+        datasetBook = std::make_unique<OrderBook>(orderBook);
     }
+    userOrders.push_back(order);
+    orderBook.insertOrder(order);
+    matchCache.markUserOrder(order.product, order.timestamp);
+    // the order is confirmed once it is on disk
+    journalEvent(JournalRecord{JournalRecordType::order, "", {order}}, true);
+}
 
-    currentTime = orderBook.getNextTime(currentTime);
+/** remember the state at the current time */
+void MerkelMain::takeCheckpoint()
+{
+    checkpoints.push_back(Checkpoint{currentTime, wallet, userOrders.size()});
+    stepsSinceCheckpoint = 0;
+}
+
+/** write the whole simulation to a checkpoint file */
+bool MerkelMain::saveCheckpoint(std::string filename)
+{
+    stepsSinceSave = 0;
+    if (!SimulationCheckpoint::write(filename, saveSequence + 1, currentTime, orderBook, wallet)) {
+        return false;
+    }
+    ++saveSequence;
+    std::cout << "Saved checkpoint " << filename << " at " << currentTime << std::endl;
+    // a journal starts over from the checkpoint and a simulation recovered from it can't go
+    // back before it, so from here on neither can this one, as after a restore.
+    // Without a journal the jumps back keep their history
+    if (journalFile != "") {
+        userOrders.clear();
+        datasetBook.reset();
+        checkpoints.clear();
+        takeCheckpoint();
+    }
+    // everything journaled so far is in the checkpoint
+    baseFile = filename;
+    baseIsCheckpoint = true;
+    restartJournal();
+    return true;
+}
+
+/** continue the simulation saved in a checkpoint file */
+bool MerkelMain::restore(std::string filename)
+{
+    if (!SimulationCheckpoint::read(filename, saveSequence, currentTime, orderBook, wallet)) {
+        return false;
+    }
+    // our orders are part of the restored book now, there is no going back before it
+    userOrders.clear();
+    datasetBook.reset();
+    matchCache.reset(orderBook);
+    checkpoints.clear();
+    takeCheckpoint();
+    stepsSinceSave = 0;
+    baseFile = filename;
+    baseIsCheckpoint = true;
+    restartJournal();
+    std::cout << "Restored " << filename << " at " << currentTime << ", " << orderBook.getRowCount() << " orders" << std::endl;
+    return true;
+}
+
+/** save a checkpoint to filename every so many time frames, 0 to stop */
+void MerkelMain::setAutoCheckpoint(std::string filename, unsigned int timeframes)
+{
+    autoCheckpointFile = filename;
+    autoCheckpointInterval = timeframes;
+    stepsSinceSave = 0;
+}
+
+/** journal the simulation to filename, recovering the simulation it records if it exists */
+bool MerkelMain::openJournal(std::string filename)
+{
+    std::ifstream existing{filename};
+    if (!existing.is_open()) {
+        if (currentTime == "") {
+            start();
+        }
+        journalFile = filename;
+        restartJournal();
+        return journal.isOpen();
+    }
+    existing.close();
+
+    std::vector<JournalRecord> records;
+    if (!OrderJournal::read(filename, records)) {
+        return false;
+    }
+    if (records.size() == 0 || (records[0].type != JournalRecordType::dataset && records[0].type != JournalRecordType::checkpoint)) {
+        std::cout << "MerkelMain::openJournal " << filename << " doesn't say where the simulation started" << std::endl;
+        return false;
+    }
+    // journalFile is set once the simulation is recovered, so restoring or replaying adds nothing to the journal
+    if (records[0].type == JournalRecordType::checkpoint) {
+        if (!restore(records[0].text)) {
+            return false;
+        }
+        // a crash between saving over the checkpoint and starting the journal over leaves a
+        // checkpoint that already holds every event of the journal
+        if (saveSequence > records[0].save) {
+            std::cout << "MerkelMain::openJournal " << records[0].text << " was saved after " << filename
+                      << " was written, continuing from it" << std::endl;
+            journalFile = filename;
+            restartJournal();
+            return journal.isOpen();
+        }
+        if (saveSequence < records[0].save) {
+            std::cout << "MerkelMain::openJournal " << records[0].text << " is older than the checkpoint " << filename << " starts from" << std::endl;
+            return false;
+        }
+    } else {
+        if (records[0].text != baseFile || baseIsCheckpoint || currentTime != "") {
+            orderBook = OrderBook{records[0].text};
+            wallet = Wallet{};
+            userOrders.clear();
+            datasetBook.reset();
+            matchCache.reset(orderBook);
+            checkpoints.clear();
+            baseFile = records[0].text;
+            baseIsCheckpoint = false;
+        }
+        start();
+    }
+    replaying = true;
+    std::size_t replayed = 1;
+    for (; replayed < records.size(); ++replayed)
+    {
+        if (!replay(records[replayed])) {
+            break;
+        }
+    }
+    replaying = false;
+    if (replayed < records.size()) {
+        std::cout << "MerkelMain::openJournal " << filename << " record " << replayed << " doesn't fit the simulation, stopped there" << std::endl;
+        return false;
+    }
+    std::cout << "Recovered " << records.size() - 1 << " events from " << filename << ", current time is " << currentTime << std::endl;
+    journalFile = filename;
+    return journal.open(filename);
+}
+
+/** apply an event read from the journal, false if it doesn't fit the simulation */
+bool MerkelMain::replay(const JournalRecord& record)
+{
+    if (record.type == JournalRecordType::order && record.orders.size() == 1) {
+        OrderBookEntry order = record.orders[0];
+        insertUserOrder(order);
+        return true;
+    }
+    if (record.type == JournalRecordType::timeframe && record.text == currentTime) {
+        // the sales were journaled, so the time frame needn't be matched again
+        settleTimeframe(record.orders);
+        return true;
+    }
+    if (record.type == JournalRecordType::jump) {
+        gotoTime(record.text);
+        return true;
+    }
+    return false;
+}
+
+/** add an event to the journal, waiting until it is on disk if durable */
+void MerkelMain::journalEvent(const JournalRecord& record, bool durable)
+{
+    if (replaying || !journal.isOpen()) {
+        return;
+    }
+    std::uint64_t sequence = journal.append(record);
+    if (durable && !journal.commit(sequence)) {
+        std::cout << "MerkelMain::journalEvent could not write the journal " << journalFile << std::endl;
+    }
+}
+
+/** start the journal over from the dataset or checkpoint the simulation is based on now */
+void MerkelMain::restartJournal()
+{
+    if (journalFile == "") {
+        return;
+    }
+    JournalRecordType type = baseIsCheckpoint ? JournalRecordType::checkpoint : JournalRecordType::dataset;
+    journal.create(journalFile, JournalRecord{type, baseFile, {}, baseIsCheckpoint ? saveSequence : 0});
+}
+
+void MerkelMain::enterSave()
+{
+    std::cout << "Save the simulation to file: " << std::endl;
+    std::string filename;
+    std::getline(std::cin, filename);
+    if (filename == "") {
+        std::cout << "MerkelMain::enterSave Bad input! " << std::endl;
+        return;
+    }
+    saveCheckpoint(filename);
+}
+
+void MerkelMain::enterRestore()
+{
+    std::cout << "Restore the simulation from file: " << std::endl;
+    std::string filename;
+    std::getline(std::cin, filename);
+    if (filename == "") {
+        std::cout << "MerkelMain::enterRestore Bad input! " << std::endl;
+        return;
+    }
+    restore(filename);
 }
  
 int MerkelMain::getUserOption()
 {
     int userOption = 0;
     std::string line;
-    std::cout << "Type in 1-6" << std::endl;
+    std::cout << "Type in 1-10" << std::endl;
     std::getline(std::cin, line);
     try{
         userOption = std::stoi(line);
@@ -203,7 +567,7 @@ void MerkelMain::processUserOption(int userOption)
 {
     if (userOption == 0) // bad input
     {
-        std::cout << "Invalid choice. Choose 1-6" << std::endl;
+        std::cout << "Invalid choice. Choose 1-10" << std::endl;
     }
     if (userOption == 1) 
     {
@@ -228,5 +592,21 @@ void MerkelMain::processUserOption(int userOption)
     if (userOption == 6) 
     {
         gotoNextTimeframe();
+    }
+    if (userOption == 7) 
+    {
+        enterGoto();
+    }
+    if (userOption == 8) 
+    {
+        gotoPreviousTimeframe();
+    }
+    if (userOption == 9) 
+    {
+        enterSave();
+    }
+    if (userOption == 10) 
+    {
+        enterRestore();
     }       
 }
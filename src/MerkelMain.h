@@ -1,17 +1,30 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <cstdint>
 #include "OrderBookEntry.h"
 #include "OrderBook.h"
 #include "Wallet.h"
+#include "OrderJournal.h"
+#include "MatchCache.h"
 
 
 class MerkelMain
 {
     public:
-        MerkelMain();
+        /** simulate over dataFile, or over nothing until a checkpoint is restored if it is "" */
+        MerkelMain(std::string dataFile = "20200317.csv");
         /** Call this to start the sim */
         void init();
+        /** continue the simulation saved in a checkpoint file, see SimulationCheckpoint */
+        bool restore(std::string filename);
+        /** save a checkpoint to filename every so many time frames, 0 to stop */
+        void setAutoCheckpoint(std::string filename, unsigned int timeframes);
+        /** journal the simulation to filename, see OrderJournal. If the journal exists the simulation
+         * it records is recovered first, from its dataset or checkpoint and the events after it
+         * */
+        bool openJournal(std::string filename);
     private: 
         void printMenu();
         void printHelp();
@@ -19,14 +32,79 @@ class MerkelMain
         void enterAsk();
         void enterBid();
         void printWallet();
-        void gotoNextTimeframe();
+        /** set up the start of a simulation over the dataset */
+        void start();
+        /** match the current time frame and move on to the next, printing the sales if verbose */
+        void gotoNextTimeframe(bool verbose = true);
+        /** settle our sales of the current time frame and move on to the next */
+        void settleTimeframe(const std::vector<OrderBookEntry>& sales);
+        /** ask for a time, +n or -n time frames and go there */
+        void enterGoto();
+        /** go back one time frame */
+        void gotoPreviousTimeframe();
+        /** move the simulation to target: forward by matching every time frame on the way,
+         * back by restoring the latest checkpoint at or before target and matching from there
+         * */
+        void gotoTime(std::string target);
+        /** add an order of ours to the book, logging it so checkpoints can undo it */
+        void insertUserOrder(OrderBookEntry& order);
+        /** remember the state at the current time */
+        void takeCheckpoint();
+        /** write the whole simulation to a checkpoint file */
+        bool saveCheckpoint(std::string filename);
+        /** ask for a file name and save a checkpoint to it */
+        void enterSave();
+        /** ask for a file name and restore the checkpoint in it */
+        void enterRestore();
+        /** add an event to the journal, waiting until it is on disk if durable */
+        void journalEvent(const JournalRecord& record, bool durable);
+        /** start the journal over from the dataset or checkpoint the simulation is based on now */
+        void restartJournal();
+        /** apply an event read from the journal, false if it doesn't fit the simulation */
+        bool replay(const JournalRecord& record);
         int getUserOption();
         void processUserOption(int userOption);
 
+        /** what the simulation looked like at the start of a time frame, before matching it */
+        struct Checkpoint
+        {
+            std::string time;
+            Wallet wallet;
+            // amount of userOrders inserted by then
+            std::size_t userOrders;
+        };
+
         std::string currentTime;
 
-        OrderBook orderBook{"20200317.csv"};
+        OrderBook orderBook;
 
         Wallet wallet;
 
+        // orders we made, in the order they were inserted
+        std::vector<OrderBookEntry> userOrders;
+        // the book as loaded, kept from our first order on to undo our orders
+        std::unique_ptr<OrderBook> datasetBook;
+        // the sales of the time frames without our orders, matched once
+        MatchCache matchCache;
+        // sorted by time, none later than currentTime
+        std::vector<Checkpoint> checkpoints;
+        // time frames matched since the last checkpoint
+        unsigned int stepsSinceCheckpoint = 0;
+        // a checkpoint every this many time frames bounds how far a jump back replays
+        static const unsigned int checkpointInterval = 64;
+        // file and interval of the automatic checkpoint files, none if the interval is 0
+        std::string autoCheckpointFile;
+        unsigned int autoCheckpointInterval = 0;
+        unsigned int stepsSinceSave = 0;
+
+        // the dataset or checkpoint file the simulation started from
+        std::string baseFile;
+        bool baseIsCheckpoint = false;
+        // the save sequence of the checkpoint last saved or restored, see SimulationCheckpoint
+        std::uint64_t saveSequence = 0;
+        OrderJournal journal;
+        std::string journalFile;
+        // while replaying a journal or jumping in time nothing is journaled or checkpointed
+        bool replaying = false;
+
 };
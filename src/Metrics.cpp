@@ -0,0 +1,97 @@
+#include "Metrics.h"
+#include "AllocationCounter.h"
+#include <iomanip>
+
+Metrics::Metrics()
+{
+
+}
+
+/** return the metrics of the process */
+Metrics& Metrics::global()
+{
+    // never destroyed, threads still running at exit may record into it
+    static Metrics* metrics = new Metrics();
+    return *metrics;
+}
+
+/** return the histogram with this name, creating it on first use */
+LatencyHistogram& Metrics::histogram(std::string name)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    std::unique_ptr<LatencyHistogram>& histogram = histograms[name];
+    if (!histogram) {
+        histogram.reset(new LatencyHistogram());
+    }
+    return *histogram;
+}
+
+/** return the counter with this name, creating it on first use */
+std::atomic<unsigned long>& Metrics::counter(std::string name)
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    std::unique_ptr<std::atomic<unsigned long>>& counter = counters[name];
+    if (!counter) {
+        counter.reset(new std::atomic<unsigned long>(0));
+    }
+    return *counter;
+}
+
+/** print p50/p90/p99/max in microseconds of every used histogram whose name starts with prefix */
+void Metrics::printLatencies(std::ostream& out, std::string prefix) const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    out << std::fixed << std::setprecision(1);
+    for (auto const& histogram : histograms)
+    {
+        const LatencyHistogram& latencies = *histogram.second;
+        if (histogram.first.compare(0, prefix.size(), prefix) != 0 || latencies.getCount() == 0) {
+            continue;
+        }
+        out << histogram.first.substr(prefix.size()) << ":" << "\t"
+            << latencies.getPercentile(50) / 1000.0 << "\t"
+            << latencies.getPercentile(90) / 1000.0 << "\t"
+            << latencies.getPercentile(99) / 1000.0 << "\t"
+            << latencies.getMax() / 1000.0 << "\t"
+            << latencies.getCount() << "\n";
+    }
+    out << std::defaultfloat << std::setprecision(6);
+}
+
+/** print every counter and the allocations */
+void Metrics::printCounters(std::ostream& out) const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    for (auto const& counter : counters)
+    {
+        out << counter.first << ":" << "\t" << counter.second->load(std::memory_order_relaxed) << "\n";
+    }
+    out << "allocations:" << "\t" << AllocationCounter::getAllocations() << "\n";
+}
+
+/** write every histogram and counter as one JSON object */
+void Metrics::writeJson(std::ostream& out) const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    out << "{\"latencies\":{";
+    bool first = true;
+    for (auto const& histogram : histograms)
+    {
+        const LatencyHistogram& latencies = *histogram.second;
+        out << (first ? "" : ",") << "\"" << histogram.first << "\":{"
+            << "\"count\":" << latencies.getCount()
+            << ",\"mean_ns\":" << (std::uint64_t) latencies.getMean()
+            << ",\"p50_ns\":" << latencies.getPercentile(50)
+            << ",\"p90_ns\":" << latencies.getPercentile(90)
+            << ",\"p99_ns\":" << latencies.getPercentile(99)
+            << ",\"max_ns\":" << latencies.getMax() << "}";
+        first = false;
+    }
+    out << "},\"counters\":{";
+    first = true;
+    for (auto const& counter : counters)
+    {
+        out << "\"" << counter.first << "\":" << counter.second->load(std::memory_order_relaxed) << ",";
+    }
+    out << "\"allocations\":" << AllocationCounter::getAllocations() << "}}";
+}
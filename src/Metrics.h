@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include "LatencyHistogram.h"
+
+/** process wide latency histograms and counters, by name.
+ *
+ * Looking a name up takes a lock, so hot paths look their histogram or counter
+ * up once and keep the reference, e.g. in a function local static:
+ *
+ *     static LatencyHistogram& matchLatency = Metrics::global().histogram("orderbook.match");
+ *     ScopedTimer timer{matchLatency};
+ *
+ * Histograms and counters are never removed, references stay valid.
+ */
+class Metrics
+{
+    public:
+        /** return the metrics of the process */
+        static Metrics& global();
+        /** return the histogram with this name, creating it on first use */
+        LatencyHistogram& histogram(std::string name);
+        /** return the counter with this name, creating it on first use */
+        std::atomic<unsigned long>& counter(std::string name);
+
+        /** print p50/p90/p99/max in microseconds of every used histogram whose name starts with prefix */
+        void printLatencies(std::ostream& out, std::string prefix) const;
+        /** print every counter and the allocations, see AllocationCounter */
+        void printCounters(std::ostream& out) const;
+        /** write every histogram and counter and the allocations as one JSON object */
+        void writeJson(std::ostream& out) const;
+
+    private:
+        Metrics();
+
+        mutable std::mutex mutex;
+        std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms;
+        std::map<std::string, std::unique_ptr<std::atomic<unsigned long>>> counters;
+};
+
+/** records the time from its construction to its destruction in a histogram */
+class ScopedTimer
+{
+    public:
+        // inline, timers sit on hot paths
+        ScopedTimer(LatencyHistogram& _histogram)
+        : histogram(_histogram), start(std::chrono::steady_clock::now())
+        {
+        }
+        ~ScopedTimer()
+        {
+            histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        LatencyHistogram& histogram;
+        std::chrono::steady_clock::time_point start;
+};
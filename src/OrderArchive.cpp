@@ -0,0 +1,737 @@
+#include "OrderArchive.h"
+#include "BinaryCodec.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// file: magic, version, product dictionary, block count (0: up to the end of the file), blocks.
+// block: first / last time, min / max price, rows, payload bytes, payload.
+static const char archiveMagic[4] = {'M', 'K', 'R', 'X'};
+static const unsigned char archiveVersion = 1;
+static const std::size_t blockHeaderBytes = 8 + 8 + 8 + 8 + 4 + 4;
+// every product has one code per book type
+static const unsigned int bookTypes = 5;
+// block count of an archive that was written as a stream
+static const unsigned long unknownBlocks = ~0ul;
+
+using namespace BinaryCodec;
+
+// prices and amounts are stored as decimal mantissas with up to maxScale digits after the point
+static const std::size_t maxScale = 14;
+static const double powersOfTen[16] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+static const unsigned char decimalPrices = 0;
+static const unsigned char xorPrices = 1;
+// an amount encoded as scale 15 is followed by its raw bits
+static const std::uint64_t rawAmount = 15;
+
+/** the mantissa of value with scale digits after the point, false unless mantissa / 10^scale gives value back exactly */
+static bool toDecimal(double value, int scale, std::int64_t& mantissa)
+{
+    double scaled = value * powersOfTen[scale];
+    if (!(std::fabs(scaled) < 9007199254740992.0)) {
+        return false;
+    }
+    mantissa = std::llround(scaled);
+    return mantissa / powersOfTen[scale] == value;
+}
+
+/** the least digits after the point that represent value exactly, -1 if there are none */
+static int decimalScale(double value, std::int64_t& mantissa)
+{
+    for (int scale = 0; scale <= (int) maxScale; ++scale)
+    {
+        if (toDecimal(value, scale, mantissa)) {
+            return scale;
+        }
+    }
+    return -1;
+}
+
+/** days since 1970/01/01 of a civil date */
+static std::int64_t daysFromCivil(std::int64_t year, unsigned int month, unsigned int day)
+{
+    year -= month <= 2;
+    std::int64_t era = (year >= 0 ? year : year - 399) / 400;
+    unsigned int yearOfEra = (unsigned int) (year - era * 400);
+    unsigned int dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + (std::int64_t) dayOfEra - 719468;
+}
+
+/** civil date of days since 1970/01/01 */
+static void civilFromDays(std::int64_t days, int& year, unsigned int& month, unsigned int& day)
+{
+    days += 719468;
+    std::int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned int dayOfEra = (unsigned int) (days - era * 146097);
+    unsigned int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    unsigned int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    unsigned int monthIndex = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    year = (int) (yearOfEra + era * 400 + (month <= 2));
+}
+
+/** convert 2020/03/17 17:01:24.884492 to microseconds since 1970, false if it is not in that format */
+bool OrderArchive::timestampToMicros(const std::string& timestamp, std::int64_t& micros)
+{
+    static const char pattern[] = "dddd/dd/dd dd:dd:dd.dddddd";
+    if (timestamp.size() != sizeof pattern - 1) {
+        return false;
+    }
+    for (std::size_t i = 0; i < timestamp.size(); ++i)
+    {
+        bool digit = timestamp[i] >= '0' && timestamp[i] <= '9';
+        if (pattern[i] == 'd' ? !digit : timestamp[i] != pattern[i]) {
+            return false;
+        }
+    }
+    auto number = [&timestamp](std::size_t pos, std::size_t length)
+    {
+        std::int64_t value = 0;
+        for (std::size_t i = pos; i < pos + length; ++i)
+        {
+            value = value * 10 + (timestamp[i] - '0');
+        }
+        return value;
+    };
+    std::int64_t days = daysFromCivil(number(0, 4), (unsigned int) number(5, 2), (unsigned int) number(8, 2));
+    std::int64_t seconds = number(11, 2) * 3600 + number(14, 2) * 60 + number(17, 2);
+    micros = (days * 86400 + seconds) * 1000000 + number(20, 6);
+    return true;
+}
+
+/** convert microseconds since 1970 back to 2020/03/17 17:01:24.884492 */
+std::string OrderArchive::microsToTimestamp(std::int64_t micros)
+{
+    std::int64_t seconds = micros >= 0 ? micros / 1000000 : (micros - 999999) / 1000000;
+    std::int64_t days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+    unsigned int secondOfDay = (unsigned int) (seconds - days * 86400);
+    int year;
+    unsigned int month, day;
+    civilFromDays(days, year, month, day);
+    char text[64];
+    std::snprintf(text, sizeof text, "%04d/%02u/%02u %02u:%02u:%02u.%06u",
+                  year, month, day, secondOfDay / 3600, secondOfDay / 60 % 60, secondOfDay % 60,
+                  (unsigned int) (micros - seconds * 1000000));
+    return text;
+}
+
+/** writes values of up to 64 bits into a byte string, most significant bit first */
+class BitWriter
+{
+    public:
+        BitWriter(std::string& _out) : out(_out), pending(0), pendingBits(0) {}
+        void write(std::uint64_t value, int bits)
+        {
+            if (bits > 32) {
+                write(value >> 32, bits - 32);
+                bits = 32;
+            }
+            value &= bits == 64 ? ~0ull : (1ull << bits) - 1;
+            pending = (pending << bits) | value;
+            pendingBits += bits;
+            while (pendingBits >= 8)
+            {
+                pendingBits -= 8;
+                out += (char) ((pending >> pendingBits) & 0xff);
+            }
+        }
+        void flush()
+        {
+            if (pendingBits > 0) {
+                out += (char) ((pending << (8 - pendingBits)) & 0xff);
+                pendingBits = 0;
+            }
+        }
+    private:
+        std::string& out;
+        std::uint64_t pending;
+        int pendingBits;
+};
+
+/** reads what BitWriter wrote */
+class BitReader
+{
+    public:
+        BitReader(const std::string& _in, std::size_t _pos, std::size_t _end) : in(_in), pos(_pos), end(_end), pending(0), pendingBits(0) {}
+        std::uint64_t read(int bits)
+        {
+            if (bits > 32) {
+                std::uint64_t high = read(bits - 32);
+                return (high << 32) | read(32);
+            }
+            while (pendingBits < bits)
+            {
+                if (pos >= end) {
+                    throw std::runtime_error{"OrderArchive: truncated block"};
+                }
+                pending = (pending << 8) | (unsigned char) in[pos++];
+                pendingBits += 8;
+            }
+            pendingBits -= bits;
+            return (pending >> pendingBits) & ((1ull << bits) - 1);
+        }
+    private:
+        const std::string& in;
+        std::size_t pos;
+        std::size_t end;
+        std::uint64_t pending;
+        int pendingBits;
+};
+
+/** the previous value of one product and side, prices and amounts are XORed against it */
+struct XorState
+{
+    std::uint64_t previous = 0;
+    int leading = -1;
+    int trailing = 0;
+};
+
+/** appends value as the XOR against the previous value, leaving out the zero bits on both ends.
+ * 0: same value, 10: meaningful bits fit the previous window, 11: new window follows
+ * */
+static void putXor(BitWriter& bits, XorState& state, double value)
+{
+    std::uint64_t valueBits = doubleToBits(value);
+    std::uint64_t difference = valueBits ^ state.previous;
+    state.previous = valueBits;
+    if (difference == 0) {
+        bits.write(0, 1);
+        return;
+    }
+    int leading = std::min(__builtin_clzll(difference), 31);
+    int trailing = __builtin_ctzll(difference);
+    if (state.leading >= 0 && leading >= state.leading && trailing >= state.trailing) {
+        bits.write(2, 2);
+        bits.write(difference >> state.trailing, 64 - state.leading - state.trailing);
+        return;
+    }
+    int meaningful = 64 - leading - trailing;
+    bits.write(3, 2);
+    bits.write(leading, 5);
+    bits.write(meaningful - 1, 6);
+    bits.write(difference >> trailing, meaningful);
+    state.leading = leading;
+    state.trailing = trailing;
+}
+
+static double getXor(BitReader& bits, XorState& state)
+{
+    if (bits.read(1) == 1) {
+        if (bits.read(1) == 1) {
+            state.leading = (int) bits.read(5);
+            int meaningful = (int) bits.read(6) + 1;
+            state.trailing = 64 - state.leading - meaningful;
+        }
+        std::uint64_t difference = bits.read(64 - state.leading - state.trailing) << state.trailing;
+        state.previous ^= difference;
+    }
+    return bitsToDouble(state.previous);
+}
+
+/** the parts of an archive file every reader needs */
+struct ArchiveFile
+{
+    std::string data;
+    std::vector<std::string> products;
+    unsigned long blocks;
+    // position of the first block
+    std::size_t pos;
+};
+
+/** read a whole archive file and its dictionary */
+static bool openArchive(std::string filename, ArchiveFile& file)
+{
+    std::ifstream in{filename, std::ios::binary};
+    if (!in.is_open()) {
+        std::cout << "OrderArchive: could not open " << filename << std::endl;
+        return false;
+    }
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    file.data = contents.str();
+    if (file.data.size() < 5 || file.data.compare(0, 4, archiveMagic, 4) != 0 || (unsigned char) file.data[4] != archiveVersion) {
+        std::cout << "OrderArchive: " << filename << " is not an archive" << std::endl;
+        return false;
+    }
+    try {
+        file.pos = 5;
+        std::size_t products = getVarint(file.data, file.pos);
+        if (products > file.data.size()) {
+            throw std::runtime_error{"OrderArchive: corrupt dictionary"};
+        }
+        file.products.resize(products);
+        for (std::string& product : file.products)
+        {
+            std::size_t length = getVarint(file.data, file.pos);
+            product = file.data.substr(file.pos, length);
+            file.pos += length;
+        }
+        // archives written as a stream don't know their block count, they end with the file
+        file.blocks = getVarint(file.data, file.pos);
+        if (file.blocks == 0) {
+            file.blocks = unknownBlocks;
+        }
+    } catch (const std::exception& e) {
+        std::cout << "OrderArchive: " << filename << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/** encode one block of rows, codes are the product / side code of every row */
+static void writeBlock(std::string& out,
+                       const std::vector<OrderBookEntry>& orders,
+                       const std::vector<std::int64_t>& micros,
+                       const std::vector<unsigned int>& codes,
+                       std::size_t first,
+                       std::size_t last,
+                       std::size_t codeCount)
+{
+    std::string payload;
+
+    // timestamps: runs of equal time, each stored as its distance from the previous run.
+    // The first run starts from the earliest time, which is in the block header
+    std::int64_t firstMicros = *std::min_element(micros.begin() + first, micros.begin() + last);
+    std::int64_t lastMicros = *std::max_element(micros.begin() + first, micros.begin() + last);
+    std::size_t runs = 0;
+    std::string timeRuns;
+    std::int64_t previousTime = firstMicros;
+    for (std::size_t i = first; i < last; ++runs)
+    {
+        std::size_t end = i;
+        while (end < last && micros[end] == micros[i]) end++;
+        putVarint(timeRuns, zigzag(micros[i] - previousTime));
+        putVarint(timeRuns, end - i);
+        previousTime = micros[i];
+        i = end;
+    }
+    putVarint(payload, runs);
+    payload += timeRuns;
+
+    // product and side: runs of one dictionary code
+    runs = 0;
+    std::string codeRuns;
+    for (std::size_t i = first; i < last; ++runs)
+    {
+        std::size_t end = i;
+        while (end < last && codes[end] == codes[i]) end++;
+        putVarint(codeRuns, codes[i]);
+        putVarint(codeRuns, end - i);
+        i = end;
+    }
+    putVarint(payload, runs);
+    payload += codeRuns;
+
+    double minPrice = orders[first].price;
+    double maxPrice = orders[first].price;
+    for (std::size_t i = first; i < last; ++i)
+    {
+        minPrice = std::min(minPrice, orders[i].price);
+        maxPrice = std::max(maxPrice, orders[i].price);
+    }
+
+    // prices: decimals at one scale for the block, each the difference from the last price
+    // of its product and side. Prices that aren't short decimals are XORed instead
+    int priceScale = 0;
+    std::int64_t mantissa = 0;
+    for (std::size_t i = first; i < last && priceScale >= 0; ++i)
+    {
+        int scale = decimalScale(orders[i].price, mantissa);
+        priceScale = scale < 0 ? -1 : std::max(priceScale, scale);
+    }
+    for (std::size_t i = first; i < last && priceScale >= 0; ++i)
+    {
+        if (!toDecimal(orders[i].price, priceScale, mantissa)) {
+            priceScale = -1;
+        }
+    }
+    if (priceScale >= 0) {
+        payload += (char) decimalPrices;
+        putVarint(payload, priceScale);
+        std::vector<std::int64_t> previous(codeCount, 0);
+        for (std::size_t i = first; i < last; ++i)
+        {
+            toDecimal(orders[i].price, priceScale, mantissa);
+            putVarint(payload, zigzag(mantissa - previous[codes[i]]));
+            previous[codes[i]] = mantissa;
+        }
+    } else {
+        payload += (char) xorPrices;
+        std::string xorBytes;
+        BitWriter bits{xorBytes};
+        std::vector<XorState> previous(codeCount);
+        for (std::size_t i = first; i < last; ++i)
+        {
+            putXor(bits, previous[codes[i]], orders[i].price);
+        }
+        bits.flush();
+        putVarint(payload, xorBytes.size());
+        payload += xorBytes;
+    }
+
+    // amounts: each a decimal with its own scale in the low 4 bits, or the raw double
+    for (std::size_t i = first; i < last; ++i)
+    {
+        int scale = decimalScale(orders[i].amount, mantissa);
+        if (scale < 0) {
+            putVarint(payload, rawAmount);
+            putFixed(payload, doubleToBits(orders[i].amount), 8);
+        } else {
+            putVarint(payload, zigzag(mantissa) << 4 | (std::uint64_t) scale);
+        }
+    }
+
+    putFixed(out, (std::uint64_t) firstMicros, 8);
+    putFixed(out, (std::uint64_t) lastMicros, 8);
+    putFixed(out, doubleToBits(minPrice), 8);
+    putFixed(out, doubleToBits(maxPrice), 8);
+    putFixed(out, last - first, 4);
+    putFixed(out, payload.size(), 4);
+    out += payload;
+}
+
+/** decode one block, appending the rows within the time and price bounds to orders.
+ * The micros bounds are a cheap prefilter, the time bounds decide
+ * */
+static void readBlock(const ArchiveFile& file,
+                      std::size_t pos,
+                      const std::string& fromTime,
+                      const std::string& toTime,
+                      std::int64_t fromMicros,
+                      std::int64_t toMicros,
+                      double minPrice,
+                      double maxPrice,
+                      std::vector<OrderBookEntry>& orders)
+{
+    std::size_t rows = getFixed(file.data, pos + 32, 4);
+    std::size_t end = pos + blockHeaderBytes + getFixed(file.data, pos + 36, 4);
+    pos += blockHeaderBytes;
+
+    // expand the runs to one timestamp and one code per row
+    std::vector<std::int64_t> micros;
+    micros.reserve(rows);
+    std::int64_t time = (std::int64_t) getFixed(file.data, pos - blockHeaderBytes, 8);
+    std::size_t runs = getVarint(file.data, pos);
+    for (std::size_t run = 0; run < runs; ++run)
+    {
+        time += unzigzag(getVarint(file.data, pos));
+        std::size_t length = getVarint(file.data, pos);
+        if (length > rows - micros.size()) {
+            throw std::runtime_error{"OrderArchive: corrupt block"};
+        }
+        micros.insert(micros.end(), length, time);
+    }
+    std::vector<unsigned int> codes;
+    codes.reserve(rows);
+    runs = getVarint(file.data, pos);
+    for (std::size_t run = 0; run < runs; ++run)
+    {
+        unsigned int code = (unsigned int) getVarint(file.data, pos);
+        std::size_t length = getVarint(file.data, pos);
+        if (length > rows - codes.size()) {
+            throw std::runtime_error{"OrderArchive: corrupt block"};
+        }
+        codes.insert(codes.end(), length, code);
+    }
+    if (micros.size() != rows || codes.size() != rows) {
+        throw std::runtime_error{"OrderArchive: corrupt block"};
+    }
+
+    std::size_t codeCount = file.products.size() * bookTypes;
+    for (unsigned int code : codes)
+    {
+        if (code >= codeCount) {
+            throw std::runtime_error{"OrderArchive: corrupt block"};
+        }
+    }
+
+    std::vector<double> prices(rows);
+    if (pos >= end) {
+        throw std::runtime_error{"OrderArchive: truncated block"};
+    }
+    unsigned char priceEncoding = file.data[pos++];
+    if (priceEncoding == decimalPrices) {
+        std::size_t scale = getVarint(file.data, pos);
+        if (scale > maxScale) {
+            throw std::runtime_error{"OrderArchive: corrupt block"};
+        }
+        std::vector<std::int64_t> previous(codeCount, 0);
+        for (std::size_t i = 0; i < rows; ++i)
+        {
+            previous[codes[i]] += unzigzag(getVarint(file.data, pos));
+            prices[i] = previous[codes[i]] / powersOfTen[scale];
+        }
+    } else {
+        std::size_t xorBytes = getVarint(file.data, pos);
+        BitReader bits{file.data, pos, std::min(pos + xorBytes, end)};
+        std::vector<XorState> previous(codeCount);
+        for (std::size_t i = 0; i < rows; ++i)
+        {
+            prices[i] = getXor(bits, previous[codes[i]]);
+        }
+        pos += xorBytes;
+    }
+
+    std::string timestamp;
+    std::int64_t timestampMicros = 0;
+    for (std::size_t i = 0; i < rows; ++i)
+    {
+        std::uint64_t encoded = getVarint(file.data, pos);
+        double amount;
+        if (encoded == rawAmount) {
+            if (pos + 8 > end) {
+                throw std::runtime_error{"OrderArchive: truncated block"};
+            }
+            amount = bitsToDouble(getFixed(file.data, pos, 8));
+            pos += 8;
+        } else {
+            amount = unzigzag(encoded >> 4) / powersOfTen[encoded & 0xf];
+        }
+
+        if (micros[i] < fromMicros || micros[i] > toMicros || prices[i] < minPrice || prices[i] > maxPrice) {
+            continue;
+        }
+        // rows of one run share the timestamp text
+        if (timestamp == "" || micros[i] != timestampMicros) {
+            timestampMicros = micros[i];
+            timestamp = OrderArchive::microsToTimestamp(timestampMicros);
+        }
+        if (timestamp < fromTime || (toTime != "" && timestamp > toTime)) {
+            continue;
+        }
+        orders.emplace_back(prices[i], amount, timestamp, file.products[codes[i] / bookTypes], (OrderBookType) (codes[i] % bookTypes));
+    }
+}
+
+OrderArchive::OrderArchive()
+{
+
+}
+
+/** write orders to an archive file, in the order given. Returns false if the
+ * file can't be written or a timestamp isn't in the expected format
+ * */
+bool OrderArchive::write(std::string filename, const std::vector<OrderBookEntry>& orders, std::size_t blockRows)
+{
+    // dictionary of products, in order of appearance
+    std::map<std::string, unsigned int> productIds;
+    std::vector<std::string> products;
+    std::vector<std::int64_t> micros(orders.size());
+    std::vector<unsigned int> codes(orders.size());
+    for (std::size_t i = 0; i < orders.size(); ++i)
+    {
+        if (!timestampToMicros(orders[i].timestamp, micros[i])) {
+            std::cout << "OrderArchive::write bad timestamp " << orders[i].timestamp << std::endl;
+            return false;
+        }
+        auto it = productIds.find(orders[i].product);
+        if (it == productIds.end()) {
+            it = productIds.emplace(orders[i].product, (unsigned int) products.size()).first;
+            products.push_back(orders[i].product);
+        }
+        codes[i] = it->second * bookTypes + (unsigned int) orders[i].orderType;
+    }
+
+    std::string out{archiveMagic, 4};
+    out += (char) archiveVersion;
+    putVarint(out, products.size());
+    for (const std::string& product : products)
+    {
+        putVarint(out, product.size());
+        out += product;
+    }
+    blockRows = std::max<std::size_t>(blockRows, 1);
+    putVarint(out, (orders.size() + blockRows - 1) / blockRows);
+    for (std::size_t first = 0; first < orders.size(); first += blockRows)
+    {
+        writeBlock(out, orders, micros, codes, first, std::min(first + blockRows, orders.size()), products.size() * bookTypes);
+    }
+
+    std::ofstream file{filename, std::ios::binary};
+    file.write(out.data(), out.size());
+    if (!file) {
+        std::cout << "OrderArchive::write could not write " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/** start an archive of rows of the given products */
+OrderArchiveWriter::OrderArchiveWriter(std::string filename, std::vector<std::string> products, std::size_t _blockRows)
+: file(filename, std::ios::binary), codeCount(products.size() * bookTypes), blockRows(std::max<std::size_t>(_blockRows, 1)), closed(false)
+{
+    std::string header{archiveMagic, 4};
+    header += (char) archiveVersion;
+    putVarint(header, products.size());
+    for (const std::string& product : products)
+    {
+        productIds.emplace(product, (unsigned int) productIds.size());
+        putVarint(header, product.size());
+        header += product;
+    }
+    // the block count isn't known yet, readers go on to the end of the file
+    putVarint(header, 0);
+    file.write(header.data(), header.size());
+    orders.reserve(blockRows);
+    micros.reserve(blockRows);
+    codes.reserve(blockRows);
+}
+
+OrderArchiveWriter::~OrderArchiveWriter()
+{
+    close();
+}
+
+/** return false if the file couldn't be opened or written */
+bool OrderArchiveWriter::isGood() const
+{
+    return file.good();
+}
+
+/** add a row at the end, false if its product isn't in the dictionary or its timestamp is bad */
+bool OrderArchiveWriter::add(const OrderBookEntry& order)
+{
+    std::int64_t time;
+    auto it = productIds.find(order.product);
+    if (closed || it == productIds.end() || !OrderArchive::timestampToMicros(order.timestamp, time)) {
+        return false;
+    }
+    orders.push_back(order);
+    micros.push_back(time);
+    codes.push_back(it->second * bookTypes + (unsigned int) order.orderType);
+    if (orders.size() == blockRows) {
+        writeBlock();
+    }
+    return true;
+}
+
+/** write the last block, false if anything couldn't be written */
+bool OrderArchiveWriter::close()
+{
+    if (!closed) {
+        writeBlock();
+        file.close();
+        closed = true;
+    }
+    return !file.fail();
+}
+
+/** encode and write the buffered rows */
+void OrderArchiveWriter::writeBlock()
+{
+    if (orders.size() == 0) {
+        return;
+    }
+    std::string block;
+    ::writeBlock(block, orders, micros, codes, 0, orders.size(), codeCount);
+    file.write(block.data(), block.size());
+    orders.clear();
+    micros.clear();
+    codes.clear();
+}
+
+/** read every row of an archive file */
+std::vector<OrderBookEntry> OrderArchive::read(std::string filename)
+{
+    return read(filename, "", "");
+}
+
+/** read the rows with timestamps in [fromTime, toTime] and prices in [minPrice, maxPrice],
+ * only decoding the blocks that can hold such rows
+ * */
+std::vector<OrderBookEntry> OrderArchive::read(std::string filename,
+                                               std::string fromTime,
+                                               std::string toTime,
+                                               double minPrice,
+                                               double maxPrice)
+{
+    std::vector<OrderBookEntry> orders;
+    ArchiveFile file;
+    if (!openArchive(filename, file)) {
+        return orders;
+    }
+
+    // bounds compare as text like everywhere else, so they may be cut short (2020/03/17 17:01).
+    // Completed to full timestamps they give the block skipping a range at least as wide
+    std::int64_t fromMicros = std::numeric_limits<std::int64_t>::min();
+    std::int64_t toMicros = std::numeric_limits<std::int64_t>::max();
+    const std::string earliest = "0000/01/01 00:00:00.000000";
+    const std::string latest = "9999/19/39 29:59:59.999999";
+    if (fromTime.size() > earliest.size() || !timestampToMicros(fromTime + earliest.substr(fromTime.size()), fromMicros)) {
+        fromMicros = std::numeric_limits<std::int64_t>::min();
+    }
+    if (toTime == "" || toTime.size() > latest.size() || !timestampToMicros(toTime + latest.substr(toTime.size()), toMicros)) {
+        toMicros = std::numeric_limits<std::int64_t>::max();
+    }
+
+    try {
+        std::size_t pos = file.pos;
+        for (unsigned long block = 0; block < file.blocks; ++block)
+        {
+            if (pos == file.data.size() && file.blocks == unknownBlocks) {
+                break;
+            }
+            if (pos + blockHeaderBytes > file.data.size()) {
+                throw std::runtime_error{"OrderArchive: truncated file"};
+            }
+            std::int64_t firstMicros = (std::int64_t) getFixed(file.data, pos, 8);
+            std::int64_t lastMicros = (std::int64_t) getFixed(file.data, pos + 8, 8);
+            double blockMin = bitsToDouble(getFixed(file.data, pos + 16, 8));
+            double blockMax = bitsToDouble(getFixed(file.data, pos + 24, 8));
+            std::size_t next = pos + blockHeaderBytes + getFixed(file.data, pos + 36, 4);
+            if (next > file.data.size()) {
+                throw std::runtime_error{"OrderArchive: truncated file"};
+            }
+            // skip blocks the query doesn't touch
+            if (lastMicros >= fromMicros && firstMicros <= toMicros && blockMax >= minPrice && blockMin <= maxPrice) {
+                readBlock(file, pos, fromTime, toTime, fromMicros, toMicros, minPrice, maxPrice, orders);
+            }
+            pos = next;
+        }
+    } catch (const std::exception& e) {
+        std::cout << "OrderArchive::read " << filename << ": " << e.what() << std::endl;
+    }
+    return orders;
+}
+
+/** read the block headers only */
+std::vector<ArchiveBlock> OrderArchive::readIndex(std::string filename)
+{
+    std::vector<ArchiveBlock> index;
+    ArchiveFile file;
+    if (!openArchive(filename, file)) {
+        return index;
+    }
+    std::size_t pos = file.pos;
+    for (unsigned long block = 0; block < file.blocks && pos + blockHeaderBytes <= file.data.size(); ++block)
+    {
+        ArchiveBlock header;
+        header.firstTime = microsToTimestamp((std::int64_t) getFixed(file.data, pos, 8));
+        header.lastTime = microsToTimestamp((std::int64_t) getFixed(file.data, pos + 8, 8));
+        header.minPrice = bitsToDouble(getFixed(file.data, pos + 16, 8));
+        header.maxPrice = bitsToDouble(getFixed(file.data, pos + 24, 8));
+        header.rows = getFixed(file.data, pos + 32, 4);
+        header.bytes = getFixed(file.data, pos + 36, 4);
+        index.push_back(header);
+        pos += blockHeaderBytes + header.bytes;
+    }
+    return index;
+}
+
+/** return whether filename is an archive rather than a csv file */
+bool OrderArchive::isArchive(std::string filename)
+{
+    std::ifstream file{filename, std::ios::binary};
+    char magic[4] = {};
+    file.read(magic, 4);
+    return file && std::memcmp(magic, archiveMagic, 4) == 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <limits>
+#include <map>
+#include <fstream>
+#include <cstdint>
+#include "OrderBookEntry.h"
+
+/** what a reader knows about a block of an archive without decoding it */
+struct ArchiveBlock
+{
+    // first and last timestamp of the rows in the block
+    std::string firstTime;
+    std::string lastTime;
+    double minPrice;
+    double maxPrice;
+    unsigned long rows;
+    // encoded size of the rows
+    unsigned long bytes;
+};
+
+/** a compact binary file of order book rows, the archive counterpart of a csv data file.
+ *
+ * Rows are stored in blocks of a few thousand, every column compressed on its own:
+ * timestamps as runs of (microseconds since the previous run, row count),
+ * product and side as runs of a dictionary code, prices as decimal mantissas at one
+ * scale per block, each a zigzag varint of the difference from the previous price of
+ * the same product and side (a block with a price that isn't a short decimal XORs the
+ * raw bits against the previous price instead, leaving out the zero bits on both ends),
+ * and amounts as varint decimals with their own scale, or the raw double if they
+ * aren't one. Every block starts with its time range and price range, so a reader
+ * skips the blocks a query doesn't touch without decoding them.
+ *
+ * Timestamps must look like 2020/03/17 17:01:24.884492.
+ */
+class OrderArchive
+{
+    public:
+        OrderArchive();
+
+        /** write orders to an archive file, in the order given. Returns false if the
+         * file can't be written or a timestamp isn't in the expected format
+         * */
+        static bool write(std::string filename, const std::vector<OrderBookEntry>& orders, std::size_t blockRows = 4096);
+        /** read every row of an archive file */
+        static std::vector<OrderBookEntry> read(std::string filename);
+        /** read the rows with timestamps in [fromTime, toTime] and prices in [minPrice, maxPrice],
+         * only decoding the blocks that can hold such rows
+         * */
+        static std::vector<OrderBookEntry> read(std::string filename,
+                                                std::string fromTime,
+                                                std::string toTime,
+                                                double minPrice = -std::numeric_limits<double>::infinity(),
+                                                double maxPrice = std::numeric_limits<double>::infinity());
+        /** read the block headers only */
+        static std::vector<ArchiveBlock> readIndex(std::string filename);
+        /** return whether filename is an archive rather than a csv file */
+        static bool isArchive(std::string filename);
+
+        /** convert 2020/03/17 17:01:24.884492 to microseconds since 1970, false if it is not in that format */
+        static bool timestampToMicros(const std::string& timestamp, std::int64_t& micros);
+        /** convert microseconds since 1970 back to 2020/03/17 17:01:24.884492 */
+        static std::string microsToTimestamp(std::int64_t micros);
+};
+
+/** writes an archive a block at a time, for datasets too large to hold in memory.
+ * The products must be known up front
+ */
+class OrderArchiveWriter
+{
+    public:
+        /** start an archive of rows of the given products */
+        OrderArchiveWriter(std::string filename, std::vector<std::string> products, std::size_t blockRows = 4096);
+        ~OrderArchiveWriter();
+        /** return false if the file couldn't be opened or written */
+        bool isGood() const;
+        /** add a row at the end, false if its product isn't in the dictionary or its timestamp is bad */
+        bool add(const OrderBookEntry& order);
+        /** write the last block, false if anything couldn't be written */
+        bool close();
+
+    private:
+        /** encode and write the buffered rows */
+        void writeBlock();
+
+        std::ofstream file;
+        std::map<std::string, unsigned int> productIds;
+        std::size_t codeCount;
+        std::size_t blockRows;
+        // rows of the block being filled, with their times and product / side codes
+        std::vector<OrderBookEntry> orders;
+        std::vector<std::int64_t> micros;
+        std::vector<unsigned int> codes;
+        bool closed;
+};
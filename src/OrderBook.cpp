@@ -1,78 +1,92 @@
 #include "OrderBook.h"
 #include "CSVReader.h"
+#include "IngestPipeline.h"
+#include "OrderArchive.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <map>
+#include <limits>
 #include <algorithm>
 #include <iostream>
 
-
-/** construct, reading a csv data file */
-OrderBook::OrderBook(std::string filename)
+/** rows of the book visited by linear scans */
+static std::atomic<unsigned long>& rowsScanned()
 {
-    orders = CSVReader::readCSV(filename);
+    static std::atomic<unsigned long>& counter = Metrics::global().counter("orderbook.rows_scanned");
+    return counter;
 }
 
-/** return vector of all know products in the dataset*/
-std::vector<std::string> OrderBook::getKnownProducts()
+// whether loading a csv file prints the stats of the ingest stages
+static bool printLoadStats = false;
+
+/** construct an empty order book */
+OrderBook::OrderBook()
 {
-    std::vector<std::string> products;
 
-    std::map<std::string,bool> prodMap;
+}
 
-    for (OrderBookEntry& e : orders)
-    {
-        prodMap[e.product] = true;
+/** construct, reading a csv data file or an archive */
+OrderBook::OrderBook(std::string filename)
+{
+    static LatencyHistogram& loadLatency = Metrics::global().histogram("orderbook.load");
+    ScopedTimer timer{loadLatency};
+    TraceScope scope{"OrderBook::OrderBook", "ingest", filename};
+    if (OrderArchive::isArchive(filename)) {
+        appendOrders(OrderArchive::read(filename));
+        loadReport.addRows(orders.size());
+        std::cout << "OrderBook::OrderBook read " << orders.size() << " entries from archive" << std::endl;
+        return;
     }
-    
-    // now flatten the map to a vector of strings
-    for (auto const& e : prodMap)
-    {
-        products.push_back(e.first);
+
+    // reading, parsing, converting and indexing run as a pipeline on separate threads
+    IngestPipeline pipeline{filename};
+    std::size_t loaded = pipeline.run(*this);
+    std::cout << "OrderBook::OrderBook read " << loaded << " entries" << std::endl;
+    loadReport = pipeline.getReport();
+    if (loadReport.getRejected() > 0) {
+        loadReport.print(std::cout);
+    }
+    if (printLoadStats) {
+        pipeline.printStats(std::cout);
     }
+}
 
+/** return vector of all know products in the dataset*/
+std::vector<std::string> OrderBook::getKnownProducts() const
+{
+    // the catalogue is maintained as orders arrive, so this is a plain copy
     return products;
 }
 
 /** return wether a product exists in timestamp or not*/
-bool OrderBook::isProductInTimestamp(std::string product, std::string timestamp, OrderBookType type)
+bool OrderBook::isProductInTimestamp(std::string product, std::string timestamp, OrderBookType type) const
 {
-    std::vector<std::string> products = getKnownProducts(timestamp, type);
-    if (std::find(products.begin(), products.end(), product) == products.end()) {
+    auto timestampIt = timestampPositions.find(timestamp);
+    auto productIt = productIds.find(product);
+    if (timestampIt == timestampPositions.end() || productIt == productIds.end()) {
         return false;
     }
-    return true;
+
+    const std::vector<bool>* presence = getPresence(timestampIt->second, type);
+    return presence != nullptr && productIt->second < presence->size() && (*presence)[productIt->second];
 }
 
 /** return wether a product exists in last timesteps or not*/
-bool OrderBook::isProductInTimestamp(std::string product, std::string currentTime, OrderBookType type, int lastTimestamps)
+bool OrderBook::isProductInTimestamp(std::string product, std::string currentTime, OrderBookType type, int lastTimestamps) const
 {
-    int passedTimestamps = 0;
-    bool isInTimestamp = false;
-    std::string lastReadTimestamp = "-1";
-    
-    // traverser all orders reveresed (from end to start)
-    for (auto it = orders.rbegin(); it != orders.rend(); ++it)
-    {   
-        // verify we scan the orders previous to current time
-        if (!isInTimestamp && it->timestamp == currentTime) {
-            isInTimestamp = true;
-        }
-
-        // verify we scan the orders within the last amount of requested timestamps
-        if (passedTimestamps >= lastTimestamps + 1) {
-            return false;
-        }
-
-        // if the last read timestamp isn't the current timestamp
-        if (lastReadTimestamp != it->timestamp) {
-            // if read at least one timestamps and we're in the timestamp window
-            if (lastReadTimestamp != "-1" && isInTimestamp) {
-                passedTimestamps = passedTimestamps + 1;
-            }
-            lastReadTimestamp = it->timestamp;
-        }
+    auto timestampIt = timestampPositions.find(currentTime);
+    auto productIt = productIds.find(product);
+    if (timestampIt == timestampPositions.end() || productIt == productIds.end() || lastTimestamps < 0) {
+        return false;
+    }
 
-        // if we're in the time window, and the product & type exist
-        if (isInTimestamp && it->orderType == type && it->product == product) {
+    // the window is the current timestamp and the lastTimestamps before it
+    int last = (int) timestampIt->second;
+    int first = std::max(0, last - lastTimestamps);
+    for (int pos = last; pos >= first; --pos)
+    {
+        const std::vector<bool>* presence = getPresence(pos, type);
+        if (presence != nullptr && productIt->second < presence->size() && (*presence)[productIt->second]) {
             return true;
         }
     }
@@ -80,57 +94,84 @@ bool OrderBook::isProductInTimestamp(std::string product, std::string currentTim
 }
 
 /** calcs avg for product in last timestamps */
-double OrderBook::calcProductInTimestampsAvg(std::string product, std::string currentTime, int lastTimestamps, OrderBookType type)
+double OrderBook::calcProductInTimestampsAvg(std::string product, std::string currentTime, int lastTimestamps, OrderBookType type) const
 {
-    int passedTimestamps = 0;
-    bool isInTimestamp = false;
-    double sum = 0;
-    int amountOfProducts = 0;
-    std::string lastReadTimestamp = "-1";
-
-    // traverser all orders reveresed (from end to start)
-    for (auto it = orders.rbegin(); it != orders.rend(); ++it)
-    {   
-        // verify we scan the orders previous to current time
-        if (!isInTimestamp && it->timestamp == currentTime) {
-            isInTimestamp = true;
-        }
+    return getWindowSummary(product, currentTime, lastTimestamps, type).avg();
+}
 
-        // verify we scan the orders within the last amount of requested timestamps
-        if (passedTimestamps >= lastTimestamps + 1) {
-            break;
-        }
+/** return min/max/sum/count of the product prices in currentTime and the lastTimestamps before it */
+PriceSummary OrderBook::getWindowSummary(std::string product, std::string currentTime, int lastTimestamps, OrderBookType type) const
+{
+    TraceScope scope{"OrderBook::getWindowSummary", "query", product};
+    PriceSummary summary;
+    auto timestampIt = timestampPositions.find(currentTime);
+    auto productIt = productIds.find(product);
+    if (timestampIt != timestampPositions.end() && productIt != productIds.end() && lastTimestamps >= 0) {
+        unsigned int last = timestampIt->second;
+        unsigned int first = last >= (unsigned int) lastTimestamps ? last - lastTimestamps : 0;
+        summary = getPriceSummary(productIt->second, type, first, last);
+    }
+    return summary;
+}
 
-        // if the last read timestamp isn't the current timestamp
-        if (lastReadTimestamp != it->timestamp) {
-            // if read at least one timestamps and we're in the timestamp window
-            if (lastReadTimestamp != "-1" && isInTimestamp) {
-                passedTimestamps = passedTimestamps + 1;
-            }
-            lastReadTimestamp = it->timestamp;
-        }
+/** return min/max/sum/count of the product prices with timestamps in [fromTime, toTime] */
+PriceSummary OrderBook::getPriceSummary(std::string product, OrderBookType type, std::string fromTime, std::string toTime) const
+{
+    TraceScope scope{"OrderBook::getPriceSummary", "query", product};
+    auto productIt = productIds.find(product);
+    if (productIt == productIds.end()) {
+        return PriceSummary{};
+    }
 
-        // if we're in the time window, and the product & type exist
-        if (isInTimestamp && it->orderType == type && it->product == product) {
-            sum = sum + it->price;
-            amountOfProducts = amountOfProducts + 1;
-        }
+    // timestamps compare lexicographically, so the bounds need not exist in the book.
+    // A bound cut short (2020/03/17 17:01:55) takes in every timestamp it is the start of
+    auto first = std::lower_bound(timestamps.begin(), timestamps.end(), fromTime);
+    auto last = std::upper_bound(timestamps.begin(), timestamps.end(), toTime,
+                                 [](const std::string& bound, const std::string& time) { return time.compare(0, bound.size(), bound) > 0; });
+    if (first >= last) {
+        return PriceSummary{};
     }
 
-    return sum / amountOfProducts;
+    return getPriceSummary(productIt->second, type,
+                           (unsigned int) (first - timestamps.begin()),
+                           (unsigned int) (last - timestamps.begin()) - 1);
+}
+
+/** return the price summary of a product id over timestamp positions [first, last] */
+PriceSummary OrderBook::getPriceSummary(unsigned int productId, OrderBookType type, unsigned int first, unsigned int last) const
+{
+    const std::vector<PriceRangeTree>* ranges = nullptr;
+    if (type == OrderBookType::ask) {
+        ranges = &askRanges;
+    } else if (type == OrderBookType::bid) {
+        ranges = &bidRanges;
+    }
+    if (ranges == nullptr || productId >= ranges->size()) {
+        return PriceSummary{};
+    }
+    return (*ranges)[productId].query(first, last);
 }
 
 /** gets all orders for product in last timesteps */
-std::vector<double> OrderBook::getOrdersInTimesteps(std::string product, std::string currentTime, int timesteps, OrderBookType type)
+std::vector<double> OrderBook::getOrdersInTimesteps(std::string product, std::string currentTime, int timesteps, OrderBookType type) const
 {
     int passedTimestamps = 0;
     bool isInTimestamp = false;
-    std::string lastReadTimestamp = "-1";
+    std::string_view lastReadTimestamp = "-1";
     std::vector<double> prices;
 
-    // traverser all orders reveresed (from end to start)
-    for (auto it = orders.rbegin(); it != orders.rend(); ++it)
+    // traverser the orders reveresed, starting at the last one of currentTime: rows are sorted by
+    // timestamp, so the later ones are skipped with a binary search rather than read
+    auto after = std::upper_bound(orders.begin(), orders.end(), currentTime,
+                                  [](const std::string& time, const OrderRow& row) { return time < row.timestamp; });
+    if (after != orders.end()) {
+        // as if the later rows had been read, the window counts currentTime as one step then
+        lastReadTimestamp = after->timestamp;
+    }
+    unsigned long scanned = 0;
+    for (auto it = std::make_reverse_iterator(after); it != orders.rend(); ++it)
     {   
+        scanned++;
         // verify we scan the orders previous to current time
         if (!isInTimestamp && it->timestamp == currentTime) {
             isInTimestamp = true;
@@ -155,13 +196,15 @@ std::vector<double> OrderBook::getOrdersInTimesteps(std::string product, std::st
             prices.push_back(it->price);
         }
     }
+    rowsScanned().fetch_add(scanned, std::memory_order_relaxed);
 
     return prices;
 }
 
 /** calcs prediction for product in last timestamps */
-double OrderBook::calcProductPrediction(std::string product, std::string currentTime, int timesteps, OrderBookType type, std::string requestedOperator)
+double OrderBook::calcProductPrediction(std::string product, std::string currentTime, int timesteps, OrderBookType type, std::string requestedOperator) const
 {   
+    TraceScope scope{"OrderBook::calcProductPrediction", "query", product};
     // calcing the prediction is done in the following way:
     // get all orders of the product. (to predict ask we take all bids, to predict bid we take all asks)
     // sort them by price
@@ -169,20 +212,24 @@ double OrderBook::calcProductPrediction(std::string product, std::string current
     // if min is requested - calculate p10 price
 
     std::vector<double> orders = getOrdersInTimesteps(product, currentTime, timesteps, type);
+    if (orders.size() == 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
     std::sort(std::begin(orders), std::end(orders));
 
-    int amountOfItems = (int) (0.1 * orders.size()); // calc the amount of items to take only p90
+    // calc the amount of items to take only p90, at least one so a short window still has an answer
+    std::size_t amountOfItems = std::max<std::size_t>(1, orders.size() / 10);
     
     if (requestedOperator == "min") {
         double sum = 0;
-        for(int i = 0; i < amountOfItems; i++) 
+        for(std::size_t i = 0; i < amountOfItems; i++) 
         {
             sum = sum + orders[i];
         }
         return sum / amountOfItems;
     } else {
         double sum = 0;
-        for(int i = orders.size()-1; i >= orders.size() - amountOfItems; i--) 
+        for(std::size_t i = orders.size() - amountOfItems; i < orders.size(); i++) 
         {
             sum = sum + orders[i];
         }
@@ -190,74 +237,117 @@ double OrderBook::calcProductPrediction(std::string product, std::string current
     }
 }
 
+/** predicts the next max or min price of product with a model maintained as orders arrive */
+double OrderBook::calcProductPrediction(std::string product, std::string currentTime, int timesteps, OrderBookType type, std::string requestedOperator, PredictionModel model) const
+{
+    if (model == PredictionModel::percentile) {
+        return calcProductPrediction(product, currentTime, timesteps, type, requestedOperator);
+    }
+    TraceScope scope{"OrderBook::calcProductPrediction model", "query", product};
+    double prediction = std::numeric_limits<double>::quiet_NaN();
+    auto productIt = productIds.find(product);
+    // the models are read at the last timestamp at or before currentTime
+    auto timestampIt = std::upper_bound(timestamps.begin(), timestamps.end(), currentTime);
+    if (productIt == productIds.end() || timestampIt == timestamps.begin() || timesteps <= 0
+        || (requestedOperator != "max" && requestedOperator != "min") || (type != OrderBookType::ask && type != OrderBookType::bid)) {
+        return prediction;
+    }
+    unsigned int position = (unsigned int) (timestampIt - timestamps.begin()) - 1;
+    unsigned int productId = productIt->second;
+    const std::vector<PriceModels>& models = type == OrderBookType::ask ? askModels : bidModels;
+
+    // every model reads the highest (max) or lowest (min) prices of the requested side
+    bool high = requestedOperator == "max";
+    bool found = false;
+    if (productId < models.size()) {
+        if (model == PredictionModel::ewma) {
+            found = models[productId].getEwma(position, timesteps, high, prediction);
+        } else if (model == PredictionModel::trend) {
+            found = models[productId].getTrend(position, timesteps, high, prediction);
+        } else {
+            found = models[productId].getVolumeWeighted(position, timesteps, high, prediction);
+        }
+    }
+    return found ? prediction : std::numeric_limits<double>::quiet_NaN();
+}
+
 /** return vector of all know products in the dataset that match the timestamp*/
-std::vector<std::string> OrderBook::getKnownProducts(std::string timestamp, OrderBookType type)
+std::vector<std::string> OrderBook::getKnownProducts(std::string timestamp, OrderBookType type) const
 {
-    std::vector<std::string> products;
+    std::vector<std::string> productsInTimestamp;
 
-    std::map<std::string,bool> prodMap;
+    auto timestampIt = timestampPositions.find(timestamp);
+    if (timestampIt == timestampPositions.end()) {
+        return productsInTimestamp;
+    }
+    const std::vector<bool>* presence = getPresence(timestampIt->second, type);
+    if (presence == nullptr) {
+        return productsInTimestamp;
+    }
 
-    for (OrderBookEntry& e : orders)
+    // products is sorted, so the result is sorted as well
+    for (const std::string& product : products)
     {
-        if (e.timestamp == timestamp && e.orderType == type)
-        {
-            prodMap[e.product] = true;
+        unsigned int id = productIds.find(product)->second;
+        if (id < presence->size() && (*presence)[id]) {
+            productsInTimestamp.push_back(product);
         }
     }
-    
-    // now flatten the map to a vector of strings
-    for (auto const& e : prodMap)
-    {
-    products.push_back(e.first);
-    }
 
-    return products;
+    return productsInTimestamp;
 }
 
 /** return pair of vectors of Orders each with different bookType*/
-std::pair<std::vector<OrderBookEntry>, std::vector<OrderBookEntry>> OrderBook::getOrdersByBidAsk(std::string product, std::string timestamp)
+std::pair<std::vector<OrderBookEntry>, std::vector<OrderBookEntry>> OrderBook::getOrdersByBidAsk(std::string product, std::string timestamp) const
 {
     std::vector<OrderBookEntry> asks_sub;
     std::vector<OrderBookEntry> bids_sub;
     
-    for (OrderBookEntry& e : orders)
+    // rows are sorted by timestamp, only the timestamp's own rows are read
+    auto first = std::lower_bound(orders.begin(), orders.end(), timestamp,
+                                  [](const OrderRow& row, const std::string& time) { return row.timestamp < time; });
+    unsigned long scanned = 0;
+    for (auto it = first; it != orders.end() && it->timestamp == timestamp; ++it)
     {
-        if (e.timestamp > timestamp) {
-            break;
-        }
+        const OrderRow& e = *it;
+        scanned++;
 
-        if (e.product == product && 
-            e.timestamp == timestamp )
+        if (e.product == product)
             {
                 if (e.orderType == OrderBookType::ask) {
-                    asks_sub.push_back(e);
+                    asks_sub.push_back(e.toEntry());
                 } else if (e.orderType == OrderBookType::bid) {
-                    bids_sub.push_back(e);
+                    bids_sub.push_back(e.toEntry());
                 }
             }
     }
+    rowsScanned().fetch_add(scanned, std::memory_order_relaxed);
     return std::make_pair(asks_sub, bids_sub);
 }
 
 /** return vector of Orders according to the sent filters*/
 std::vector<OrderBookEntry> OrderBook::getOrders(OrderBookType type, 
                                         std::string product, 
-                                        std::string timestamp)
+                                        std::string timestamp) const
 {
+    TraceScope scope{"OrderBook::getOrders", "query", product};
     std::vector<OrderBookEntry> orders_sub;
-    for (OrderBookEntry& e : orders)
+    unsigned long scanned = 0;
+    for (const OrderRow& e : orders)
     {
         if (e.timestamp > timestamp) {
             break;
         }
+        scanned++;
 
         if (e.orderType == type && 
             e.product == product && 
             e.timestamp == timestamp )
             {
-                orders_sub.push_back(e);
+                orders_sub.push_back(e.toEntry());
             }
     }
+    rowsScanned().fetch_add(scanned, std::memory_order_relaxed);
     return orders_sub;
 }
 
@@ -265,7 +355,7 @@ std::vector<OrderBookEntry> OrderBook::getOrders(OrderBookType type,
 double OrderBook::getHighPrice(std::vector<OrderBookEntry>& orders)
 {
     double max = orders[0].price;
-    for (OrderBookEntry& e : orders)
+    for (const OrderBookEntry& e : orders)
     {
         if (e.price > max)max = e.price;
     }
@@ -276,69 +366,302 @@ double OrderBook::getHighPrice(std::vector<OrderBookEntry>& orders)
 double OrderBook::getLowPrice(std::vector<OrderBookEntry>& orders)
 {
     double min = orders[0].price;
-    for (OrderBookEntry& e : orders)
+    for (const OrderBookEntry& e : orders)
     {
         if (e.price < min)min = e.price;
     }
     return min;
 }
 
-std::string OrderBook::getEarliestTime()
+std::string OrderBook::getEarliestTime() const
 {
-    return orders[0].timestamp;
+    if (orders.size() == 0) {
+        return "";
+    }
+    return std::string{orders[0].timestamp};
 }
 
-std::string OrderBook::getNextTime(std::string timestamp)
+std::string OrderBook::getNextTime(std::string timestamp) const
 {
-    std::string next_timestamp = "";
-    for (OrderBookEntry& e : orders)
+    TraceScope scope{"OrderBook::getNextTime", "query"};
+    // timestamps is the sorted index of distinct times, so this is a binary search
+    auto next = std::upper_bound(timestamps.begin(), timestamps.end(), timestamp);
+    if (next == timestamps.end())
     {
-        if (e.timestamp > timestamp) 
+        return getEarliestTime();
+    }
+    return *next;
+}
+
+/** returns the time before the sent time in the orderbook, "" if there is none */
+std::string OrderBook::getPreviousTime(std::string timestamp) const
+{
+    auto next = std::lower_bound(timestamps.begin(), timestamps.end(), timestamp);
+    if (next == timestamps.begin()) {
+        return "";
+    }
+    return *(next - 1);
+}
+
+/** returns the latest time in the orderbook */
+std::string OrderBook::getLatestTime() const
+{
+    if (timestamps.size() == 0) {
+        return "";
+    }
+    return timestamps.back();
+}
+
+/** returns the first time at or after the sent time, which may be partial (e.g. 2020/03/17 17:05).
+ * The latest time if there is none
+ * */
+std::string OrderBook::findTime(std::string timestamp) const
+{
+    auto found = std::lower_bound(timestamps.begin(), timestamps.end(), timestamp);
+    if (found == timestamps.end()) {
+        return getLatestTime();
+    }
+    return *found;
+}
+
+/** returns the time steps timestamps after the sent time, before it if steps is negative.
+ * Stops at the earliest and the latest time
+ * */
+std::string OrderBook::offsetTime(std::string timestamp, long steps) const
+{
+    if (timestamps.size() == 0) {
+        return "";
+    }
+    // position of the time at or before timestamp
+    long position = (long) (std::upper_bound(timestamps.begin(), timestamps.end(), timestamp) - timestamps.begin()) - 1;
+    position = std::max(0L, std::min((long) timestamps.size() - 1, position + steps));
+    return timestamps[position];
+}
+
+void OrderBook::insertOrder(OrderBookEntry& order)
+{
+    static LatencyHistogram& insertLatency = Metrics::global().histogram("orderbook.insert");
+    ScopedTimer timer{insertLatency};
+    TraceScope scope{"OrderBook::insertOrder", "ingest"};
+    // orders are kept sorted, so place it after the last order with the same timestamp
+    // instead of sorting the whole book again
+    orders.insert(order);
+    indexOrder(order);
+}
+
+/** add a segment of orders, sorted by timestamp, e.g. the next rows of a feed */
+void OrderBook::appendOrders(const std::vector<OrderBookEntry>& segment)
+{
+    if (segment.size() == 0) {
+        return;
+    }
+    bool continuesBook = orders.size() == 0 || !(segment.front().timestamp < orders.back().timestamp);
+    if (continuesBook && std::is_sorted(segment.begin(), segment.end(), OrderBookEntry::compareByTimestamp)) {
+        // the common case, the segment continues the book
+        static LatencyHistogram& indexLatency = Metrics::global().histogram("orderbook.index");
+        ScopedTimer timer{indexLatency};
+        TraceScope scope{"OrderBook::appendOrders", "ingest", std::to_string(segment.size()) + " rows"};
+        orders.reserve(segment.size());
+        for (const OrderBookEntry& e : segment)
         {
-            next_timestamp = e.timestamp;
-            break;
+            orders.append(e);
+            indexOrder(e);
         }
+        return;
     }
-    if (next_timestamp == "")
+    for (OrderBookEntry e : segment)
     {
-        next_timestamp = orders[0].timestamp;
+        insertOrder(e);
     }
-    return next_timestamp;
 }
 
-void OrderBook::insertOrder(OrderBookEntry& order)
+/** return all distinct timestamps in the book, sorted */
+const std::vector<std::string>& OrderBook::getTimestamps() const
+{
+    return timestamps;
+}
+
+/** return an estimate of the memory held by the book, in bytes */
+std::size_t OrderBook::getMemoryUsage() const
+{
+    std::size_t bytes = orders.getMemoryUsage();
+    bytes += timestamps.size() * (sizeof(std::string) + 32 + 2 * sizeof(std::vector<bool>));
+    bytes += 2 * products.size() * timestamps.size() * 2 * sizeof(PriceSummary);
+    for (const std::vector<PriceModels>* models : {&askModels, &bidModels})
+    {
+        for (const PriceModels& model : *models)
+        {
+            bytes += model.getMemoryUsage();
+        }
+    }
+    return bytes;
+}
+
+/** return the amount of orders in the book */
+std::size_t OrderBook::getRowCount() const
+{
+    return orders.size();
+}
+
+/** return every order in the book, sorted by timestamp */
+const OrderStore& OrderBook::getRows() const
+{
+    return orders;
+}
+
+/** return the rows loaded and rejected when the book was read from its file */
+const LoadReport& OrderBook::getLoadReport() const
+{
+    return loadReport;
+}
+
+/** print the stats of the ingest stages when a csv file is loaded */
+void OrderBook::setPrintLoadStats(bool print)
+{
+    printLoadStats = print;
+}
+
+/** return the version of the product's data, bumped whenever one of its orders is added */
+unsigned long OrderBook::getProductVersion(std::string product) const
 {
-    orders.push_back(order);
-    std::sort(orders.begin(), orders.end(), OrderBookEntry::compareByTimestamp);
+    auto productIt = productIds.find(product);
+    if (productIt == productIds.end()) {
+        return 0;
+    }
+    return productVersions[productIt->second];
+}
+
+/** adds the order's product and timestamp to the catalogue and presence index */
+void OrderBook::indexOrder(const OrderBookEntry& order)
+{
+    // product catalogue
+    auto productIt = productIds.find(order.product);
+    if (productIt == productIds.end()) {
+        productIt = productIds.emplace(order.product, (unsigned int) productIds.size()).first;
+        products.insert(std::upper_bound(products.begin(), products.end(), order.product), order.product);
+        productVersions.push_back(0);
+    }
+    unsigned int productId = productIt->second;
+    productVersions[productId]++;
+
+    // timestamp index, data arrives sorted so this is nearly always an append
+    auto timestampIt = timestampPositions.find(order.timestamp);
+    if (timestampIt == timestampPositions.end()) {
+        auto insertAt = std::upper_bound(timestamps.begin(), timestamps.end(), order.timestamp);
+        unsigned int pos = (unsigned int) (insertAt - timestamps.begin());
+        timestamps.insert(insertAt, order.timestamp);
+        askPresence.insert(askPresence.begin() + pos, std::vector<bool>());
+        bidPresence.insert(bidPresence.begin() + pos, std::vector<bool>());
+        for (PriceRangeTree& range : askRanges)
+        {
+            range.insertPosition(pos);
+        }
+        for (PriceRangeTree& range : bidRanges)
+        {
+            range.insertPosition(pos);
+        }
+        for (std::vector<PriceModels>* models : {&askModels, &bidModels})
+        {
+            for (PriceModels& model : *models)
+            {
+                model.insertPosition(pos);
+            }
+        }
+        // timestamps after the inserted one moved up by one position
+        for (unsigned int i = pos; i < timestamps.size(); ++i)
+        {
+            timestampPositions[timestamps[i]] = i;
+        }
+        timestampIt = timestampPositions.find(order.timestamp);
+    }
+
+    std::vector<bool>* presence = nullptr;
+    std::vector<PriceRangeTree>* ranges = nullptr;
+    std::vector<PriceModels>* models = nullptr;
+    if (order.orderType == OrderBookType::ask) {
+        presence = &askPresence[timestampIt->second];
+        ranges = &askRanges;
+        models = &askModels;
+    } else if (order.orderType == OrderBookType::bid) {
+        presence = &bidPresence[timestampIt->second];
+        ranges = &bidRanges;
+        models = &bidModels;
+    } else {
+        return;
+    }
+    if (presence->size() <= productId) {
+        presence->resize(productIds.size(), false);
+    }
+    (*presence)[productId] = true;
+
+    if (ranges->size() <= productId) {
+        ranges->resize(productIds.size());
+    }
+    (*ranges)[productId].addPrice(timestampIt->second, order.price);
+
+    if (models->size() <= productId) {
+        models->resize(productIds.size());
+    }
+    (*models)[productId].addOrder(timestampIt->second, order.price, order.amount);
 }
 
-std::vector<OrderBookEntry> OrderBook::matchAsksToBids(std::string product, std::string timestamp)
+/** return the presence bits of the type for the timestamp at position, or nullptr */
+const std::vector<bool>* OrderBook::getPresence(unsigned int timestampPos, OrderBookType type) const
 {
+    if (type == OrderBookType::ask) {
+        return &askPresence[timestampPos];
+    }
+    if (type == OrderBookType::bid) {
+        return &bidPresence[timestampPos];
+    }
+    return nullptr;
+}
+
+/** match the orders of product at timestamp, printing their price extremes unless quiet */
+std::vector<OrderBookEntry> OrderBook::matchAsksToBids(std::string product, std::string timestamp, bool quiet) const
+{
+    static LatencyHistogram& matchLatency = Metrics::global().histogram("orderbook.match");
+    ScopedTimer timer{matchLatency};
+    TraceScope scope{"OrderBook::matchAsksToBids", "match", product};
     std::pair<std::vector<OrderBookEntry>, std::vector<OrderBookEntry>> orders = getOrdersByBidAsk(product, timestamp);
     std::vector<OrderBookEntry> bids = orders.first;
     std::vector<OrderBookEntry> asks = orders.second;
 
-    // sales = []
-    std::vector<OrderBookEntry> sales; 
-
     // I put in a little check to ensure we have bids and asks
     // to process.
     if (asks.size() == 0 || bids.size() == 0)
     {
-        std::cout << " OrderBook::matchAsksToBids no bids or asks" << std::endl;
+        if (!quiet) std::cout << " OrderBook::matchAsksToBids no bids or asks" << std::endl;
+        return std::vector<OrderBookEntry>{};
+    }
+
+    std::vector<OrderBookEntry> sales = matchOrders(asks, bids, product, timestamp);
+    if (quiet) {
         return sales;
     }
+    std::cout << "max ask " << asks[asks.size()-1].price << std::endl;
+    std::cout << "min ask " << asks[0].price << std::endl;
+    std::cout << "max bid " << bids[0].price << std::endl;
+    std::cout << "min bid " << bids[bids.size()-1].price << std::endl;
+    return sales;
+}
+
+/** match asks against bids of one product and timestamp, e.g. the book's orders and our own,
+ * returning the sales. Sorts asks lowest first and bids highest first, amounts are used up in place
+ * */
+std::vector<OrderBookEntry> OrderBook::matchOrders(std::vector<OrderBookEntry>& asks,
+                                                   std::vector<OrderBookEntry>& bids,
+                                                   const std::string& product,
+                                                   const std::string& timestamp)
+{
+    // sales = []
+    std::vector<OrderBookEntry> sales; 
 
     // sort asks lowest first
     std::sort(asks.begin(), asks.end(), OrderBookEntry::compareByPriceAsc);
     // sort bids highest first
     std::sort(bids.begin(), bids.end(), OrderBookEntry::compareByPriceDesc);
     // for ask in asks:
-    std::cout << "max ask " << asks[asks.size()-1].price << std::endl;
-    std::cout << "min ask " << asks[0].price << std::endl;
-    std::cout << "max bid " << bids[0].price << std::endl;
-    std::cout << "min bid " << bids[bids.size()-1].price << std::endl;
-    
     for (OrderBookEntry& ask : asks)
     {
     //     for bid in bids:
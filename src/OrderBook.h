@@ -1,52 +1,135 @@
 #pragma once
 #include "OrderBookEntry.h"
 #include "CSVReader.h"
+#include "PriceRangeTree.h"
+#include "PriceModels.h"
+#include "OrderStore.h"
 #include <string>
 #include <vector>
+#include <unordered_map>
 
 class OrderBook
 {
     public:
-    /** construct, reading a csv data file */
+    /** construct an empty order book */
+        OrderBook();
+    /** construct, reading a csv data file or an archive (see OrderArchive) */
         OrderBook(std::string filename);
     /** return vector of all know products in the dataset*/
-        std::vector<std::string> getKnownProducts();
+        std::vector<std::string> getKnownProducts() const;
     /** return vector of all know products in the dataset that match the timestamp*/
-        std::vector<std::string> getKnownProducts(std::string timestamp, OrderBookType type);
+        std::vector<std::string> getKnownProducts(std::string timestamp, OrderBookType type) const;
     /** return wether a product exists in timestamp or not*/
-        bool isProductInTimestamp(std::string product, std::string timestamp, OrderBookType type);
+        bool isProductInTimestamp(std::string product, std::string timestamp, OrderBookType type) const;
     /** return wether a product exists in last timesteps or not*/
-        bool isProductInTimestamp(std::string product, std::string currentTime, OrderBookType type, int lastTimestamps);
+        bool isProductInTimestamp(std::string product, std::string currentTime, OrderBookType type, int lastTimestamps) const;
     /** calcs prediction for product in last timestamps */
-        double calcProductPrediction(std::string product, std::string currentTime, int timesteps, OrderBookType type, std::string requestedOperator);
+        double calcProductPrediction(std::string product, std::string currentTime, int timesteps, OrderBookType type, std::string requestedOperator) const;
+    /** predicts the next max or min price of product's orders of type with a model maintained as orders
+     * arrive (see PriceModels), from the timesteps timestamps up to currentTime. NaN if there is too little
+     * data, or for an operator other than max / min or a type other than ask / bid
+     * */
+        double calcProductPrediction(std::string product, std::string currentTime, int timesteps, OrderBookType type, std::string requestedOperator, PredictionModel model) const;
     /** calcs avg for product in last timestamps */
-        double calcProductInTimestampsAvg(std::string product, std::string currentTime, int lastTimestamps, OrderBookType type);
+        double calcProductInTimestampsAvg(std::string product, std::string currentTime, int lastTimestamps, OrderBookType type) const;
+    /** return min/max/sum/count of the product prices with timestamps in [fromTime, toTime].
+     * toTime may be cut short, it then takes in every timestamp it is the start of
+     * */
+        PriceSummary getPriceSummary(std::string product, OrderBookType type, std::string fromTime, std::string toTime) const;
+    /** return min/max/sum/count of the product prices in currentTime and the lastTimestamps before it */
+        PriceSummary getWindowSummary(std::string product, std::string currentTime, int lastTimestamps, OrderBookType type) const;
     /** gets all orders for product in last timesteps */
-        std::vector<double> getOrdersInTimesteps(std::string product, std::string currentTime, int timesteps, OrderBookType type);
-    /** return pair of vectors of Orders each with different bookType*/
-        std::pair<std::vector<OrderBookEntry>, std::vector<OrderBookEntry>> getOrdersByBidAsk(std::string product, std::string timestamp);
+        std::vector<double> getOrdersInTimesteps(std::string product, std::string currentTime, int timesteps, OrderBookType type) const;
+    /** return pair of vectors of Orders each with different bookType, the asks first */
+        std::pair<std::vector<OrderBookEntry>, std::vector<OrderBookEntry>> getOrdersByBidAsk(std::string product, std::string timestamp) const;
     /** return vector of Orders according to the sent filters*/
         std::vector<OrderBookEntry> getOrders(OrderBookType type, 
                                               std::string product, 
-                                              std::string timestamp);
+                                              std::string timestamp) const;
 
         /** returns the earliest time in the orderbook*/
-        std::string getEarliestTime();
+        std::string getEarliestTime() const;
         /** returns the next time after the 
          * sent time in the orderbook  
          * If there is no next timestamp, wraps around to the start
          * */
-        std::string getNextTime(std::string timestamp);
+        std::string getNextTime(std::string timestamp) const;
+        /** returns the time before the sent time in the orderbook, "" if there is none */
+        std::string getPreviousTime(std::string timestamp) const;
+        /** returns the latest time in the orderbook */
+        std::string getLatestTime() const;
+        /** returns the first time at or after the sent time, which may be partial (e.g. 2020/03/17 17:05).
+         * The latest time if there is none
+         * */
+        std::string findTime(std::string timestamp) const;
+        /** returns the time steps timestamps after the sent time, before it if steps is negative.
+         * Stops at the earliest and the latest time
+         * */
+        std::string offsetTime(std::string timestamp, long steps) const;
 
         void insertOrder(OrderBookEntry& order);
+        /** add a segment of orders, sorted by timestamp, e.g. the next rows of a feed */
+        void appendOrders(const std::vector<OrderBookEntry>& segment);
+
+        /** return all distinct timestamps in the book, sorted */
+        const std::vector<std::string>& getTimestamps() const;
+        /** return an estimate of the memory held by the book, in bytes */
+        std::size_t getMemoryUsage() const;
+        /** return the amount of orders in the book */
+        std::size_t getRowCount() const;
+        /** return every order in the book, sorted by timestamp */
+        const OrderStore& getRows() const;
+        /** return the rows loaded and rejected when the book was read from its file */
+        const LoadReport& getLoadReport() const;
+        /** print the throughput and waiting time of every ingest stage when a csv file is loaded, off by default */
+        static void setPrintLoadStats(bool print);
 
-        std::vector<OrderBookEntry> matchAsksToBids(std::string product, std::string timestamp);
+        /** return the version of the product's data, bumped whenever one of its orders is added */
+        unsigned long getProductVersion(std::string product) const;
+
+        /** match the orders of product at timestamp, printing their price extremes unless quiet */
+        std::vector<OrderBookEntry> matchAsksToBids(std::string product, std::string timestamp, bool quiet = false) const;
+        /** match asks against bids of one product and timestamp, e.g. the book's orders and our own,
+         * returning the sales. Sorts asks lowest first and bids highest first, amounts are used up in place
+         * */
+        static std::vector<OrderBookEntry> matchOrders(std::vector<OrderBookEntry>& asks,
+                                                       std::vector<OrderBookEntry>& bids,
+                                                       const std::string& product,
+                                                       const std::string& timestamp);
 
         static double getHighPrice(std::vector<OrderBookEntry>& orders);
         static double getLowPrice(std::vector<OrderBookEntry>& orders);
 
     private:
-        std::vector<OrderBookEntry> orders;
+        /** adds the order's product and timestamp to the catalogue and presence index */
+        void indexOrder(const OrderBookEntry& order);
+        /** return the presence bits of the type for the timestamp at position, or nullptr */
+        const std::vector<bool>* getPresence(unsigned int timestampPos, OrderBookType type) const;
+        /** return the price summary of a product id over timestamp positions [first, last] */
+        PriceSummary getPriceSummary(unsigned int productId, OrderBookType type, unsigned int first, unsigned int last) const;
+
+        // sorted by timestamp, strings are interned in the store's arena
+        OrderStore orders;
+        LoadReport loadReport;
 
+        // known products, kept sorted as new ones arrive
+        std::vector<std::string> products;
+        // product -> id, ids are assigned in order of arrival and never change
+        std::unordered_map<std::string, unsigned int> productIds;
+        // per product id, amount of orders added so far, used as the data version
+        std::vector<unsigned long> productVersions;
+        // distinct timestamps, sorted
+        std::vector<std::string> timestamps;
+        // timestamp -> position in timestamps
+        std::unordered_map<std::string, unsigned int> timestampPositions;
+        // per timestamp position, which product ids have asks / bids
+        std::vector<std::vector<bool>> askPresence;
+        std::vector<std::vector<bool>> bidPresence;
+        // per product id, price summaries over timestamp positions
+        std::vector<PriceRangeTree> askRanges;
+        std::vector<PriceRangeTree> bidRanges;
+        // per product id, predictors over the ask and bid levels
+        std::vector<PriceModels> askModels;
+        std::vector<PriceModels> bidModels;
 
 };
@@ -17,7 +17,7 @@ OrderBookEntry::OrderBookEntry( double _price,
     
 }
 
-OrderBookType OrderBookEntry::stringToOrderBookType(std::string s)
+OrderBookType OrderBookEntry::stringToOrderBookType(std::string_view s)
 {
   if (s == "ask")
   {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 enum class OrderBookType{bid, ask, unknown, asksale, bidsale};
 
@@ -16,19 +17,19 @@ class OrderBookEntry
                         OrderBookType _orderType, 
                         std::string username = "dataset");
 
-        static OrderBookType stringToOrderBookType(std::string s);
+        static OrderBookType stringToOrderBookType(std::string_view s);
 
         static std::string bookTypeToString(OrderBookType bookType);
 
-        static bool compareByTimestamp(OrderBookEntry& e1, OrderBookEntry& e2)
+        static bool compareByTimestamp(const OrderBookEntry& e1, const OrderBookEntry& e2)
         {
             return e1.timestamp < e2.timestamp;
         }  
-        static bool compareByPriceAsc(OrderBookEntry& e1, OrderBookEntry& e2)
+        static bool compareByPriceAsc(const OrderBookEntry& e1, const OrderBookEntry& e2)
         {
             return e1.price < e2.price;
         }
-         static bool compareByPriceDesc(OrderBookEntry& e1, OrderBookEntry& e2)
+         static bool compareByPriceDesc(const OrderBookEntry& e1, const OrderBookEntry& e2)
         {
             return e1.price > e2.price;
         }
@@ -0,0 +1,371 @@
+#include "OrderJournal.h"
+#include "BinaryCodec.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace BinaryCodec;
+
+// file: magic, version, records.
+// record: payload length, payload, checksum of the payload.
+// payload: type, text, save sequence, order count, orders (timestamp, product, username, side, price bits, amount bits).
+// version 1 payloads have no save sequence.
+static const char journalMagic[4] = {'M', 'K', 'R', 'J'};
+static const unsigned char journalVersion = 2;
+static const std::size_t headerBytes = 5;
+// appending waits for the writer once this much is waiting
+static const std::size_t maxPendingBytes = 1 << 20;
+
+/** FNV-1a, enough to tell a torn record from a whole one */
+static std::uint32_t checksum(const char* data, std::size_t size)
+{
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ (unsigned char) data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void putString(std::string& out, const std::string& value)
+{
+    putVarint(out, value.size());
+    out += value;
+}
+
+static std::string getString(const std::string& in, std::size_t& pos)
+{
+    std::size_t length = getVarint(in, pos);
+    if (length > in.size() - pos) {
+        throw std::runtime_error{"truncated string"};
+    }
+    std::string value = in.substr(pos, length);
+    pos += length;
+    return value;
+}
+
+/** append record to out as it is stored in the file */
+static void encodeRecord(std::string& out, const JournalRecord& record)
+{
+    std::string payload;
+    payload += (char) record.type;
+    putString(payload, record.text);
+    putVarint(payload, record.save);
+    putVarint(payload, record.orders.size());
+    for (const OrderBookEntry& order : record.orders)
+    {
+        putString(payload, order.timestamp);
+        putString(payload, order.product);
+        putString(payload, order.username);
+        putVarint(payload, (unsigned int) order.orderType);
+        putFixed(payload, doubleToBits(order.price), 8);
+        putFixed(payload, doubleToBits(order.amount), 8);
+    }
+    putVarint(out, payload.size());
+    out += payload;
+    putFixed(out, checksum(payload.data(), payload.size()), 4);
+}
+
+/** decode the record at pos of a journal of this version, false if it is torn or damaged */
+static bool decodeRecord(const std::string& in, std::size_t& pos, JournalRecord& record, unsigned char version)
+{
+    std::size_t start = pos;
+    try {
+        std::size_t length = getVarint(in, pos);
+        if (length > in.size() - pos || in.size() - pos - length < 4
+            || getFixed(in, pos + length, 4) != checksum(in.data() + pos, length)) {
+            pos = start;
+            return false;
+        }
+        std::string payload = in.substr(pos, length);
+        std::size_t field = 0;
+        unsigned char type = payload.at(field++);
+        if (type > (unsigned char) JournalRecordType::jump) {
+            throw std::runtime_error{"unknown record"};
+        }
+        record.type = (JournalRecordType) type;
+        record.text = getString(payload, field);
+        record.save = version < 2 ? 0 : getVarint(payload, field);
+        std::size_t count = getVarint(payload, field);
+        record.orders.clear();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::string timestamp = getString(payload, field);
+            std::string product = getString(payload, field);
+            std::string username = getString(payload, field);
+            std::uint64_t orderType = getVarint(payload, field);
+            if (field + 16 > payload.size() || orderType > (unsigned int) OrderBookType::bidsale) {
+                throw std::runtime_error{"damaged order"};
+            }
+            record.orders.push_back(OrderBookEntry{bitsToDouble(getFixed(payload, field, 8)),
+                                                   bitsToDouble(getFixed(payload, field + 8, 8)),
+                                                   timestamp,
+                                                   product,
+                                                   (OrderBookType) orderType,
+                                                   username});
+            field += 16;
+        }
+        pos += length + 4;
+        return true;
+    } catch (const std::exception& e) {
+        pos = start;
+        return false;
+    }
+}
+
+/** read a whole journal file, false if it can't be opened or isn't a journal */
+static bool readFile(std::string filename, std::string& contents)
+{
+    std::ifstream file{filename, std::ios::binary};
+    if (!file.is_open()) {
+        return false;
+    }
+    std::ostringstream data;
+    data << file.rdbuf();
+    contents = data.str();
+    return contents.size() >= headerBytes && contents.compare(0, 4, journalMagic, 4) == 0
+        && (unsigned char) contents[4] >= 1 && (unsigned char) contents[4] <= journalVersion;
+}
+
+/** write all of data to fd, false on an error */
+static bool writeAll(int fd, const char* data, std::size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+/** sync the directory holding filename, so a file renamed into it stays there after a crash */
+static bool syncDirectory(const std::string& filename)
+{
+    std::size_t slash = filename.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : filename.substr(0, slash);
+    int directoryFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (directoryFd < 0) {
+        return false;
+    }
+    bool synced = ::fsync(directoryFd) == 0;
+    ::close(directoryFd);
+    return synced;
+}
+
+OrderJournal::OrderJournal()
+: fd(-1), lastAppended(0), lastCommitted(0), commits(0), stopping(false), failed(false)
+{
+
+}
+
+OrderJournal::~OrderJournal()
+{
+    close();
+}
+
+/** write contents to filename, replacing it in one step. It is on disk, name and all, once this returns true */
+static bool replaceFile(const std::string& filename, const std::string& contents)
+{
+    // written aside and renamed over the old file, so there always is a whole one
+    std::string partial = filename + ".partial";
+    int partialFd = ::open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (partialFd < 0) {
+        std::cout << "OrderJournal: could not open " << partial << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    bool written = writeAll(partialFd, contents.data(), contents.size()) && ::fsync(partialFd) == 0;
+    ::close(partialFd);
+    if (!written || std::rename(partial.c_str(), filename.c_str()) != 0 || !syncDirectory(filename)) {
+        std::cout << "OrderJournal: could not write " << filename << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/** start a new journal at filename whose first record is start, replacing an older one in one step */
+bool OrderJournal::create(std::string filename, const JournalRecord& start)
+{
+    close();
+    std::string contents{journalMagic, 4};
+    contents += (char) journalVersion;
+    encodeRecord(contents, start);
+    if (!replaceFile(filename, contents)) {
+        return false;
+    }
+    return open(filename);
+}
+
+/** open an existing journal to append to it, cutting off a torn record at the end */
+bool OrderJournal::open(std::string filename)
+{
+    close();
+    std::string contents;
+    if (!readFile(filename, contents)) {
+        std::cout << "OrderJournal: " << filename << " is not a journal" << std::endl;
+        return false;
+    }
+    std::size_t end = headerBytes;
+    JournalRecord record;
+    while (decodeRecord(contents, end, record, contents[4]))
+    {
+    }
+    std::size_t torn = contents.size() - end;
+    // records are appended in the current version, so an older journal is rewritten in it first
+    if ((unsigned char) contents[4] != journalVersion) {
+        std::string upgraded{journalMagic, 4};
+        upgraded += (char) journalVersion;
+        std::size_t pos = headerBytes;
+        while (decodeRecord(contents, pos, record, contents[4]))
+        {
+            encodeRecord(upgraded, record);
+        }
+        if (!replaceFile(filename, upgraded)) {
+            return false;
+        }
+        std::cout << "OrderJournal: rewrote " << filename << " in the current version" << std::endl;
+        end = upgraded.size();
+    }
+
+    fd = ::open(filename.c_str(), O_WRONLY);
+    if (fd < 0 || ::ftruncate(fd, end) != 0 || ::lseek(fd, end, SEEK_SET) < 0) {
+        std::cout << "OrderJournal: could not open " << filename << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        return false;
+    }
+    if (torn > 0) {
+        std::cout << "OrderJournal: cut off " << torn << " bytes of a torn record at the end of " << filename << std::endl;
+    }
+    stopping = false;
+    failed = false;
+    writer = std::thread{&OrderJournal::writeLoop, this};
+    return true;
+}
+
+/** add a record, returning its sequence number */
+std::uint64_t OrderJournal::append(const JournalRecord& record)
+{
+    TraceScope scope{"OrderJournal::append", "journal"};
+    std::string encoded;
+    encodeRecord(encoded, record);
+    std::unique_lock<std::mutex> lock{mutex};
+    // a full buffer means the disk is behind, wait for it rather than grow without bound
+    committed.wait(lock, [this]() { return pending.size() < maxPendingBytes || failed || stopping; });
+    // after a failed write nothing more is committed, commit() reports it
+    if (!failed) {
+        pending += encoded;
+    }
+    ++lastAppended;
+    appended.notify_one();
+    return lastAppended;
+}
+
+/** wait until the record with this sequence number and every one before it are on disk */
+bool OrderJournal::commit(std::uint64_t sequence)
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    committed.wait(lock, [this, sequence]() { return lastCommitted >= sequence || failed || fd < 0; });
+    return lastCommitted >= sequence;
+}
+
+/** commit everything and stop the writer */
+void OrderJournal::close()
+{
+    if (!writer.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+        appended.notify_one();
+    }
+    writer.join();
+    ::close(fd);
+    fd = -1;
+    committed.notify_all();
+}
+
+/** return whether a journal is open */
+bool OrderJournal::isOpen() const
+{
+    return fd >= 0;
+}
+
+/** return the amount of syncs so far */
+std::uint64_t OrderJournal::getCommits() const
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return commits;
+}
+
+/** write and sync whatever was appended until the journal is closed */
+void OrderJournal::writeLoop()
+{
+    static LatencyHistogram& commitLatency = Metrics::global().histogram("journal.commit");
+    Trace::setThreadName("journal writer");
+    std::string group;
+    std::unique_lock<std::mutex> lock{mutex};
+    while (true)
+    {
+        appended.wait(lock, [this]() { return pending.size() > 0 || stopping; });
+        if (pending.size() == 0) {
+            return;
+        }
+        // everything appended so far is one group, what comes in meanwhile is the next one
+        group.swap(pending);
+        std::uint64_t groupEnd = lastAppended;
+        lock.unlock();
+        bool written;
+        {
+            ScopedTimer timer{commitLatency};
+            TraceScope scope{"OrderJournal::commit", "journal", std::to_string(group.size()) + " bytes"};
+            written = writeAll(fd, group.data(), group.size()) && ::fdatasync(fd) == 0;
+        }
+        group.clear();
+        lock.lock();
+        if (!written) {
+            std::cout << "OrderJournal: could not write the journal: " << std::strerror(errno) << std::endl;
+            failed = true;
+            pending.clear();
+            committed.notify_all();
+            return;
+        }
+        lastCommitted = groupEnd;
+        ++commits;
+        committed.notify_all();
+    }
+}
+
+/** read every whole record of a journal */
+bool OrderJournal::read(std::string filename, std::vector<JournalRecord>& records)
+{
+    std::string contents;
+    if (!readFile(filename, contents)) {
+        std::cout << "OrderJournal: " << filename << " is not a journal" << std::endl;
+        return false;
+    }
+    std::size_t pos = headerBytes;
+    JournalRecord record;
+    while (decodeRecord(contents, pos, record, contents[4]))
+    {
+        records.push_back(record);
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "OrderBookEntry.h"
+
+enum class JournalRecordType{dataset, checkpoint, order, timeframe, jump};
+
+/** one event of a simulation */
+struct JournalRecord
+{
+    JournalRecordType type;
+    // the file the simulation started from (dataset, checkpoint), the time matched
+    // (timeframe) or the time jumped to (jump)
+    std::string text;
+    // the order entered (order) or our sales settled in the time frame (timeframe)
+    std::vector<OrderBookEntry> orders;
+    // the save sequence stored in the checkpoint file (checkpoint), see SimulationCheckpoint
+    std::uint64_t save = 0;
+};
+
+/** an append-only log of what happened in a simulation since it started from a dataset
+ * or a checkpoint: the orders we entered, the sales settled into the wallet every time
+ * frame and the jumps in time. Replaying it on top of its starting point gives back the
+ * simulation as it was.
+ *
+ * Records are length prefixed and checksummed, so a record torn by a crash is found and
+ * cut off when the journal is opened again. Appending only encodes the record into a
+ * buffer. A writer thread writes the buffer and syncs it to disk, and every record
+ * appended while one sync is running goes to disk with the next one (group commit), so
+ * durability costs one sync per group rather than one per order. The buffer is bounded,
+ * appending waits for the writer once it is full
+ */
+class OrderJournal
+{
+    public:
+        OrderJournal();
+        /** commits what was appended and closes the file */
+        ~OrderJournal();
+
+        /** start a new journal at filename whose first record is start, replacing an older one in one step.
+         * The new journal and its name are on disk once it returns true
+         * */
+        bool create(std::string filename, const JournalRecord& start);
+        /** open an existing journal to append to it, cutting off a torn record at the end */
+        bool open(std::string filename);
+        /** add a record, returning its sequence number. It is on disk once commit(sequence) returns */
+        std::uint64_t append(const JournalRecord& record);
+        /** wait until the record with this sequence number and every one before it are on disk.
+         * Returns false if the journal couldn't be written
+         * */
+        bool commit(std::uint64_t sequence);
+        /** commit everything and stop the writer */
+        void close();
+        /** return whether a journal is open */
+        bool isOpen() const;
+        /** return the amount of syncs so far, each committing a group of records */
+        std::uint64_t getCommits() const;
+
+        /** read every whole record of a journal, false if it can't be opened or isn't a journal */
+        static bool read(std::string filename, std::vector<JournalRecord>& records);
+
+    private:
+        /** write and sync whatever was appended until the journal is closed */
+        void writeLoop();
+
+        int fd;
+        std::thread writer;
+        mutable std::mutex mutex;
+        // signalled when records are appended or the journal closes
+        std::condition_variable appended;
+        // signalled when a group is on disk
+        std::condition_variable committed;
+        // encoded records waiting for the writer
+        std::string pending;
+        std::uint64_t lastAppended;
+        std::uint64_t lastCommitted;
+        std::uint64_t commits;
+        bool stopping;
+        bool failed;
+};
@@ -0,0 +1,97 @@
+#include "OrderStore.h"
+#include <algorithm>
+#include <string>
+
+/** return the order as an OrderBookEntry owning its strings */
+OrderBookEntry OrderRow::toEntry() const
+{
+    return OrderBookEntry{price, amount, std::string{timestamp}, std::string{product}, orderType, std::string{username}};
+}
+
+OrderStore::OrderStore()
+{
+
+}
+
+OrderStore::OrderStore(const OrderStore& other)
+{
+    *this = other;
+}
+
+OrderStore& OrderStore::operator=(const OrderStore& other)
+{
+    if (this == &other) {
+        return *this;
+    }
+    clear();
+    rows.reserve(other.rows.size());
+    for (const OrderRow& row : other.rows)
+    {
+        OrderRow copy = row;
+        copy.timestamp = intern(row.timestamp);
+        copy.product = intern(row.product);
+        copy.username = intern(row.username);
+        rows.push_back(copy);
+    }
+    return *this;
+}
+
+/** add an order after all rows */
+void OrderStore::append(const OrderBookEntry& order)
+{
+    rows.push_back(toRow(order));
+}
+
+/** add an order after the last row with the same timestamp */
+void OrderStore::insert(const OrderBookEntry& order)
+{
+    OrderRow row = toRow(order);
+    rows.insert(std::upper_bound(rows.begin(), rows.end(), row, OrderRow::compareByTimestamp), row);
+}
+
+/** make room for more rows */
+void OrderStore::reserve(std::size_t more)
+{
+    if (rows.size() + more > rows.capacity()) {
+        // keep growing geometrically when appending segment by segment
+        rows.reserve(std::max(rows.size() + more, 2 * rows.capacity()));
+    }
+}
+
+/** drop all rows and release the arena */
+void OrderStore::clear()
+{
+    rows.clear();
+    strings.clear();
+    arena.release();
+}
+
+/** return the bytes held by the rows and their strings */
+std::size_t OrderStore::getMemoryUsage() const
+{
+    // a node and a bucket per interned string
+    std::size_t index = strings.size() * (sizeof(std::string_view) + 2 * sizeof(void*)) + strings.bucket_count() * sizeof(void*);
+    return rows.capacity() * sizeof(OrderRow) + arena.getBytesReserved() + index;
+}
+
+/** return text as held by the arena, copying it there the first time */
+std::string_view OrderStore::intern(std::string_view text)
+{
+    // rows arrive grouped by timestamp, so the last one matches most of the time
+    if (rows.size() > 0 && rows.back().timestamp == text) {
+        return rows.back().timestamp;
+    }
+    auto found = strings.find(text);
+    if (found != strings.end()) {
+        return *found;
+    }
+    std::string_view copied = arena.copy(text);
+    strings.insert(copied);
+    return copied;
+}
+
+/** return order as a row with interned strings */
+OrderRow OrderStore::toRow(const OrderBookEntry& order)
+{
+    return OrderRow{order.price, order.amount, intern(order.timestamp), intern(order.product), intern(order.username), order.orderType};
+}
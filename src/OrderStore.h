@@ -0,0 +1,72 @@
+#pragma once
+
+#include "OrderBookEntry.h"
+#include "Arena.h"
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+/** an order as stored in a book, its strings live in the book's arena */
+struct OrderRow
+{
+    /** return the order as an OrderBookEntry owning its strings */
+    OrderBookEntry toEntry() const;
+
+    static bool compareByTimestamp(const OrderRow& r1, const OrderRow& r2)
+    {
+        return r1.timestamp < r2.timestamp;
+    }
+
+    double price;
+    double amount;
+    std::string_view timestamp;
+    std::string_view product;
+    std::string_view username;
+    OrderBookType orderType;
+};
+
+/** the rows of an order book, sorted by timestamp.
+ * Every distinct timestamp, product and username is kept once in an Arena,
+ * so adding a row allocates nothing but the occasional slab and dropping the
+ * store frees a few slabs instead of a string per row.
+ * Copies get an arena of their own
+ */
+class OrderStore
+{
+    public:
+        OrderStore();
+        OrderStore(const OrderStore& other);
+        OrderStore& operator=(const OrderStore& other);
+        OrderStore(OrderStore&& other) = default;
+        OrderStore& operator=(OrderStore&& other) = default;
+
+        /** add an order after all rows */
+        void append(const OrderBookEntry& order);
+        /** add an order after the last row with the same timestamp */
+        void insert(const OrderBookEntry& order);
+        /** make room for more rows */
+        void reserve(std::size_t rows);
+        /** drop all rows and release the arena */
+        void clear();
+
+        std::size_t size() const { return rows.size(); }
+        const OrderRow& operator[](std::size_t i) const { return rows[i]; }
+        const OrderRow& back() const { return rows.back(); }
+        std::vector<OrderRow>::const_iterator begin() const { return rows.begin(); }
+        std::vector<OrderRow>::const_iterator end() const { return rows.end(); }
+        std::vector<OrderRow>::const_reverse_iterator rbegin() const { return rows.rbegin(); }
+        std::vector<OrderRow>::const_reverse_iterator rend() const { return rows.rend(); }
+
+        /** return the bytes held by the rows and their strings */
+        std::size_t getMemoryUsage() const;
+
+    private:
+        /** return text as held by the arena, copying it there the first time */
+        std::string_view intern(std::string_view text);
+        /** return order as a row with interned strings */
+        OrderRow toRow(const OrderBookEntry& order);
+
+        Arena arena;
+        std::unordered_set<std::string_view> strings;
+        std::vector<OrderRow> rows;
+};
@@ -0,0 +1,220 @@
+#include "PriceModels.h"
+#include <limits>
+#include <algorithm>
+
+const double PriceModels::smoothing = 2.0 / (ewmaSpan + 1);
+// other spans are averaged over this many spans of levels, the older ones weigh too little to count
+static const unsigned int ewmaReach = 40;
+
+PriceLevel::PriceLevel()
+: high(-std::numeric_limits<double>::infinity()),
+  low(std::numeric_limits<double>::infinity()),
+  volume(0),
+  count(0)
+{
+
+}
+
+/** adds a single order to the level */
+void PriceLevel::add(double price, double amount)
+{
+    if (price > high) high = price;
+    if (price < low) low = price;
+    volume += amount;
+    count++;
+}
+
+PriceModels::PriceModels()
+{
+
+}
+
+/** add an order to the level at position, growing the series if needed */
+void PriceModels::addOrder(unsigned int position, double price, double amount)
+{
+    if (position >= levels.size()) {
+        grow(position + 1);
+    }
+    levels[position].add(price, amount);
+    update(position);
+}
+
+/** insert an empty level at position, the following levels move right by one */
+void PriceModels::insertPosition(unsigned int position)
+{
+    if (position >= levels.size()) {
+        // nothing to shift, the level is created on the first addOrder
+        return;
+    }
+    levels.insert(levels.begin() + position, PriceLevel{});
+    smoothed.insert(smoothed.begin() + position, Smoothed{});
+    update(position);
+}
+
+/** return the level at position, an empty one past the end */
+const PriceLevel& PriceModels::getLevel(unsigned int position) const
+{
+    static const PriceLevel empty;
+    return position < levels.size() ? levels[position] : empty;
+}
+
+/** the moving average with a span of window timestamps of the highest or lowest price per timestamp up to position */
+bool PriceModels::getEwma(unsigned int position, unsigned int window, bool high, double& prediction) const
+{
+    if (levels.size() == 0 || window == 0) {
+        return false;
+    }
+    // nothing arrived after the end, the averages stay as they were there
+    position = std::min(position, (unsigned int) levels.size() - 1);
+    if (window == ewmaSpan) {
+        const Smoothed& state = smoothed[position];
+        prediction = high ? state.high : state.low;
+        return state.seeded;
+    }
+
+    // the same steps as update, from the oldest level that still counts
+    double weight = 2.0 / (window + 1);
+    unsigned int first = position >= window * ewmaReach ? position - window * ewmaReach : 0;
+    bool seeded = false;
+    for (unsigned int i = first; i <= position; ++i)
+    {
+        const PriceLevel& level = levels[i];
+        if (level.count == 0) {
+            continue;
+        }
+        double price = high ? level.high : level.low;
+        if (seeded) {
+            prediction += weight * (price - prediction);
+        } else {
+            prediction = price;
+            seeded = true;
+        }
+    }
+    return seeded;
+}
+
+/** the least squares line through the highest or lowest prices of the window, one timestamp later */
+bool PriceModels::getTrend(unsigned int position, unsigned int window, bool high, double& prediction) const
+{
+    // x counts timestamps back from position, so the sums stay small
+    double n = 0, sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for (unsigned int back = 0; back < window && back <= position; ++back)
+    {
+        const PriceLevel& level = getLevel(position - back);
+        if (level.count == 0) {
+            continue;
+        }
+        double x = -(double) back;
+        double y = high ? level.high : level.low;
+        n += 1;
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+    if (n == 0) {
+        return false;
+    }
+    double spread = n * sumXX - sumX * sumX;
+    if (spread == 0) {
+        // a single timestamp has no trend
+        prediction = sumY / n;
+        return true;
+    }
+    double slope = (n * sumXY - sumX * sumY) / spread;
+    double intercept = (sumY - slope * sumX) / n;
+    prediction = intercept + slope;
+    return true;
+}
+
+/** the highest or lowest prices of the window timestamps ending at position, weighted by their volume */
+bool PriceModels::getVolumeWeighted(unsigned int position, unsigned int window, bool high, double& prediction) const
+{
+    double volume = 0, weighted = 0;
+    for (unsigned int back = 0; back < window && back <= position; ++back)
+    {
+        const PriceLevel& level = getLevel(position - back);
+        if (level.count == 0) {
+            continue;
+        }
+        volume += level.volume;
+        weighted += (high ? level.high : level.low) * level.volume;
+    }
+    if (volume <= 0) {
+        return false;
+    }
+    prediction = weighted / volume;
+    return true;
+}
+
+/** return the amount of positions */
+unsigned int PriceModels::size() const
+{
+    return levels.size();
+}
+
+/** return the memory held by the series, in bytes */
+std::size_t PriceModels::getMemoryUsage() const
+{
+    return levels.capacity() * sizeof(PriceLevel) + smoothed.capacity() * sizeof(Smoothed);
+}
+
+/** return the model named by text, false if there is none of that name */
+bool PriceModels::stringToModel(const std::string& text, PredictionModel& model)
+{
+    if (text == "percentile") {
+        model = PredictionModel::percentile;
+    } else if (text == "ewma") {
+        model = PredictionModel::ewma;
+    } else if (text == "trend") {
+        model = PredictionModel::trend;
+    } else if (text == "vwap") {
+        model = PredictionModel::vwap;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/** return the name of model */
+std::string PriceModels::modelToString(PredictionModel model)
+{
+    if (model == PredictionModel::ewma) {
+        return "ewma";
+    }
+    if (model == PredictionModel::trend) {
+        return "trend";
+    }
+    if (model == PredictionModel::vwap) {
+        return "vwap";
+    }
+    return "percentile";
+}
+
+/** make room for at least minPositions positions */
+void PriceModels::grow(unsigned int minPositions)
+{
+    unsigned int from = levels.size();
+    levels.resize(minPositions);
+    smoothed.resize(minPositions);
+    update(from);
+}
+
+/** recompute the moving averages from position on, one step per position */
+void PriceModels::update(unsigned int from)
+{
+    for (unsigned int i = from; i < levels.size(); ++i)
+    {
+        Smoothed state = i > 0 ? smoothed[i - 1] : Smoothed{0, 0, false};
+        const PriceLevel& level = levels[i];
+        if (level.count > 0) {
+            if (state.seeded) {
+                state.high += smoothing * (level.high - state.high);
+                state.low += smoothing * (level.low - state.low);
+            } else {
+                state = Smoothed{level.high, level.low, true};
+            }
+        }
+        smoothed[i] = state;
+    }
+}
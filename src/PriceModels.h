@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+/** how predict forecasts the next price */
+enum class PredictionModel{percentile, ewma, trend, vwap};
+
+/** the orders of one product and side at one timestamp */
+struct PriceLevel
+{
+    PriceLevel();
+
+    /** adds a single order to the level */
+    void add(double price, double amount);
+
+    double high;
+    double low;
+    // sum of the amounts
+    double volume;
+    int count;
+};
+
+/** predictors of one product and side, kept up to date as orders arrive.
+ * Position i holds the level of timestamp position i (as in PriceRangeTree) and the
+ * exponentially weighted moving averages of the highest and lowest price up to it,
+ * with a span of ewmaSpan timestamps. Adding an order at the last position updates one
+ * average from the one before, so data arriving in time order costs O(1) per order.
+ *
+ * Every model predicts the highest (high) or lowest price of the side's next level
+ * from the window timestamps before it:
+ *   ewma   the moving average with a span of window timestamps. The default span is
+ *          maintained, other spans are averaged over the last 40 spans of levels,
+ *          older ones weigh less than e^-80
+ *   trend  the least squares line through the highest or lowest prices of the window,
+ *          evaluated one timestamp later
+ *   vwap   the highest or lowest prices of the window, each weighted by the volume of
+ *          its timestamp
+ */
+class PriceModels
+{
+    public:
+        PriceModels();
+        /** add an order to the level at position, growing the series if needed */
+        void addOrder(unsigned int position, double price, double amount);
+        /** insert an empty level at position, the following levels move right by one */
+        void insertPosition(unsigned int position);
+        /** return the level at position, an empty one past the end */
+        const PriceLevel& getLevel(unsigned int position) const;
+        /** the moving average with a span of window timestamps of the highest (high) or lowest
+         * price per timestamp up to position, false if there were no orders by then
+         * */
+        bool getEwma(unsigned int position, unsigned int window, bool high, double& prediction) const;
+        /** the least squares line through the highest (high) or lowest prices of the window
+         * timestamps ending at position, evaluated one timestamp later. False without orders in the window
+         * */
+        bool getTrend(unsigned int position, unsigned int window, bool high, double& prediction) const;
+        /** the highest (high) or lowest prices of the window timestamps ending at position, weighted
+         * by the volume of their timestamp. False without orders in the window
+         * */
+        bool getVolumeWeighted(unsigned int position, unsigned int window, bool high, double& prediction) const;
+        /** return the amount of positions */
+        unsigned int size() const;
+        /** return the memory held by the series, in bytes */
+        std::size_t getMemoryUsage() const;
+
+        /** return the model named by text, false if there is none of that name */
+        static bool stringToModel(const std::string& text, PredictionModel& model);
+        /** return the name of model, as stringToModel reads it */
+        static std::string modelToString(PredictionModel model);
+
+        // span of the maintained moving averages, in timestamps
+        static const unsigned int ewmaSpan = 5;
+        // weight of the newest level in the maintained moving averages, 2 / (span + 1)
+        static const double smoothing;
+
+    private:
+        /** the moving averages up to a position */
+        struct Smoothed
+        {
+            double high;
+            double low;
+            bool seeded;
+        };
+
+        /** make room for at least minPositions positions */
+        void grow(unsigned int minPositions);
+        /** recompute the moving averages from position on */
+        void update(unsigned int from);
+
+        std::vector<PriceLevel> levels;
+        std::vector<Smoothed> smoothed;
+};
@@ -0,0 +1,130 @@
+#include "PriceRangeTree.h"
+#include <limits>
+#include <algorithm>
+
+PriceSummary::PriceSummary()
+: min(std::numeric_limits<double>::infinity()),
+  max(-std::numeric_limits<double>::infinity()),
+  sum(0),
+  count(0)
+{
+
+}
+
+/** adds a single price to the summary */
+void PriceSummary::add(double price)
+{
+    if (price < min) min = price;
+    if (price > max) max = price;
+    sum += price;
+    count++;
+}
+
+/** combines another summary into this one */
+void PriceSummary::merge(const PriceSummary& other)
+{
+    if (other.min < min) min = other.min;
+    if (other.max > max) max = other.max;
+    sum += other.sum;
+    count += other.count;
+}
+
+/** returns the average price, sum / count */
+double PriceSummary::avg() const
+{
+    return sum / count;
+}
+
+PriceRangeTree::PriceRangeTree()
+: capacity(1), leaves(0), nodes(2)
+{
+
+}
+
+/** add a price to the leaf at position, growing the tree if needed */
+void PriceRangeTree::addPrice(unsigned int position, double price)
+{
+    if (position >= leaves) {
+        grow(position + 1);
+    }
+    unsigned int node = capacity + position;
+    nodes[node].add(price);
+    // walk up to the root, every ancestor gets the price as well
+    for (node /= 2; node >= 1; node /= 2)
+    {
+        nodes[node].add(price);
+    }
+}
+
+/** insert an empty leaf at position, the following leaves move right by one */
+void PriceRangeTree::insertPosition(unsigned int position)
+{
+    if (position >= leaves) {
+        // nothing to shift, the leaf is created on the first addPrice
+        return;
+    }
+    grow(leaves + 1);
+    std::move_backward(nodes.begin() + capacity + position,
+                       nodes.begin() + capacity + leaves - 1,
+                       nodes.begin() + capacity + leaves);
+    nodes[capacity + position] = PriceSummary{};
+    rebuild();
+}
+
+/** return the summary of the leaves in [first, last] */
+PriceSummary PriceRangeTree::query(unsigned int first, unsigned int last) const
+{
+    PriceSummary summary;
+    if (leaves == 0 || first >= leaves || first > last) {
+        return summary;
+    }
+    last = std::min(last, leaves - 1);
+
+    // standard bottom up walk over the half open range [lo, hi)
+    unsigned int lo = first + capacity;
+    unsigned int hi = last + 1 + capacity;
+    while (lo < hi)
+    {
+        if (lo & 1) summary.merge(nodes[lo++]);
+        if (hi & 1) summary.merge(nodes[--hi]);
+        lo /= 2;
+        hi /= 2;
+    }
+    return summary;
+}
+
+/** return the amount of leaves */
+unsigned int PriceRangeTree::size() const
+{
+    return leaves;
+}
+
+/** make room for at least minLeaves leaves */
+void PriceRangeTree::grow(unsigned int minLeaves)
+{
+    if (minLeaves > capacity) {
+        unsigned int newCapacity = capacity;
+        while (newCapacity < minLeaves)
+        {
+            newCapacity *= 2;
+        }
+        std::vector<PriceSummary> newNodes(2 * newCapacity);
+        std::copy(nodes.begin() + capacity, nodes.begin() + capacity + leaves, newNodes.begin() + newCapacity);
+        nodes.swap(newNodes);
+        capacity = newCapacity;
+        leaves = minLeaves;
+        rebuild();
+        return;
+    }
+    leaves = std::max(leaves, minLeaves);
+}
+
+/** recompute all inner nodes from the leaves */
+void PriceRangeTree::rebuild()
+{
+    for (unsigned int node = capacity - 1; node >= 1; --node)
+    {
+        nodes[node] = nodes[2 * node];
+        nodes[node].merge(nodes[2 * node + 1]);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+/** min, max, sum and count of a set of prices */
+struct PriceSummary
+{
+    PriceSummary();
+
+    /** adds a single price to the summary */
+    void add(double price);
+    /** combines another summary into this one */
+    void merge(const PriceSummary& other);
+    /** returns the average price, sum / count */
+    double avg() const;
+
+    double min;
+    double max;
+    double sum;
+    int count;
+};
+
+/** segment tree over per-timestamp price summaries.
+ * Leaf i holds the summary of all prices at timestamp position i,
+ * so a summary of any range of timestamps is answered in O(log n)
+ * and adding a price is an O(log n) point update.
+ */
+class PriceRangeTree
+{
+    public:
+        PriceRangeTree();
+        /** add a price to the leaf at position, growing the tree if needed */
+        void addPrice(unsigned int position, double price);
+        /** insert an empty leaf at position, the following leaves move right by one */
+        void insertPosition(unsigned int position);
+        /** return the summary of the leaves in [first, last] */
+        PriceSummary query(unsigned int first, unsigned int last) const;
+        /** return the amount of leaves */
+        unsigned int size() const;
+
+    private:
+        /** make room for at least minLeaves leaves */
+        void grow(unsigned int minLeaves);
+        /** recompute all inner nodes from the leaves */
+        void rebuild();
+
+        // leaves live in nodes[capacity, 2 * capacity), node i has children 2i and 2i+1
+        unsigned int capacity;
+        unsigned int leaves;
+        std::vector<PriceSummary> nodes;
+};
@@ -0,0 +1,59 @@
+#include "QueryCache.h"
+#include "Metrics.h"
+
+QueryCache::QueryCache(unsigned int _capacity)
+: capacity(_capacity), hits(0), misses(0)
+{
+
+}
+
+/** build the normalized key of a query */
+std::string QueryCache::makeKey(std::string command,
+                                std::string product,
+                                OrderBookType type,
+                                std::string time,
+                                std::string window)
+{
+    return command + '|' + product + '|' + OrderBookEntry::bookTypeToString(type) + '|' + time + '|' + window;
+}
+
+/** return true and set result if key is cached for this product version */
+bool QueryCache::lookup(const std::string& key, unsigned long version, double& result)
+{
+    // every session has its own cache, the process wide counters add them all up
+    static std::atomic<unsigned long>& allHits = Metrics::global().counter("querycache.hits");
+    static std::atomic<unsigned long>& allMisses = Metrics::global().counter("querycache.misses");
+    auto it = entries.find(key);
+    if (it == entries.end() || it->second.version != version) {
+        misses++;
+        allMisses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    hits++;
+    allHits.fetch_add(1, std::memory_order_relaxed);
+    result = it->second.result;
+    return true;
+}
+
+/** store the result of key computed at this product version */
+void QueryCache::store(const std::string& key, unsigned long version, double result)
+{
+    // the key space is small (product x side x time x window), so when the
+    // cache fills up it is cheaper to start over than to track recency
+    if (entries.size() >= capacity && entries.find(key) == entries.end()) {
+        entries.clear();
+    }
+    entries[key] = Entry{version, result};
+}
+
+/** return amount of lookups that found a valid entry */
+unsigned long QueryCache::getHits() const
+{
+    return hits;
+}
+
+/** return amount of lookups that did not find a valid entry */
+unsigned long QueryCache::getMisses() const
+{
+    return misses;
+}
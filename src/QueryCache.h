@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include "OrderBookEntry.h"
+
+/** caches numeric query results.
+ * Every entry is tagged with the version of the product it was computed for,
+ * an entry is only returned while the product version is unchanged.
+ */
+class QueryCache
+{
+    public:
+        QueryCache(unsigned int capacity = 4096);
+        /** build the normalized key of a query */
+        static std::string makeKey(std::string command,
+                                   std::string product,
+                                   OrderBookType type,
+                                   std::string time,
+                                   std::string window);
+        /** return true and set result if key is cached for this product version */
+        bool lookup(const std::string& key, unsigned long version, double& result);
+        /** store the result of key computed at this product version */
+        void store(const std::string& key, unsigned long version, double result);
+
+        /** return amount of lookups that found a valid entry */
+        unsigned long getHits() const;
+        /** return amount of lookups that did not find a valid entry */
+        unsigned long getMisses() const;
+
+    private:
+        struct Entry
+        {
+            unsigned long version;
+            double result;
+        };
+
+        unsigned int capacity;
+        std::unordered_map<std::string, Entry> entries;
+        unsigned long hits;
+        unsigned long misses;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/** bounded lock-free queue for exactly one producer thread and one consumer thread.
+ * A full queue makes the producer wait and an empty one the consumer, both
+ * waits are counted so a pipeline can show where it is held up.
+ */
+template <typename T>
+class SPSCQueue
+{
+    public:
+        /** capacity is rounded up to a power of two */
+        SPSCQueue(std::size_t capacity)
+        : head(0), tail(0), closed(false), fullWaits(0), emptyWaits(0)
+        {
+            std::size_t size = 2;
+            while (size < capacity) size *= 2;
+            slots.resize(size);
+            mask = size - 1;
+        }
+
+        /** producer: add an item, waits while the queue is full */
+        void push(T item)
+        {
+            std::size_t position = tail.load(std::memory_order_relaxed);
+            if (position - head.load(std::memory_order_acquire) > mask) {
+                fullWaits++;
+                while (position - head.load(std::memory_order_acquire) > mask)
+                {
+                    std::this_thread::yield();
+                }
+            }
+            slots[position & mask] = std::move(item);
+            tail.store(position + 1, std::memory_order_release);
+        }
+
+        /** producer: no more items will be pushed */
+        void close()
+        {
+            closed.store(true, std::memory_order_release);
+        }
+
+        /** consumer: take the next item, waits while the queue is empty.
+         * Returns false once the queue is closed and drained
+         * */
+        bool pop(T& item)
+        {
+            std::size_t position = head.load(std::memory_order_relaxed);
+            if (position == tail.load(std::memory_order_acquire)) {
+                emptyWaits++;
+                while (position == tail.load(std::memory_order_acquire))
+                {
+                    // closed is set after the last push, so check tail once more
+                    if (closed.load(std::memory_order_acquire)) {
+                        if (position == tail.load(std::memory_order_acquire)) {
+                            return false;
+                        }
+                        break;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+            item = std::move(slots[position & mask]);
+            head.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        /** return how often the producer found the queue full */
+        unsigned long getFullWaits() const { return fullWaits; }
+        /** return how often the consumer found the queue empty */
+        unsigned long getEmptyWaits() const { return emptyWaits; }
+
+    private:
+        std::vector<T> slots;
+        std::size_t mask;
+        // head is only written by the consumer and tail by the producer,
+        // keep them on separate cache lines
+        alignas(64) std::atomic<std::size_t> head;
+        alignas(64) std::atomic<std::size_t> tail;
+        alignas(64) std::atomic<bool> closed;
+        unsigned long fullWaits;
+        unsigned long emptyWaits;
+};
@@ -0,0 +1,274 @@
+#include "SimulationCheckpoint.h"
+#include "BinaryCodec.h"
+#include "Trace.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <cstdio>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace BinaryCodec;
+
+// file: magic, version, save sequence, current time, wallet, dictionary, timestamps, rows.
+// row: timestamp step (the distance from the previous row's timestamp), product / side code, username code, price bits, amount bits.
+// version 1 files have no save sequence.
+static const char checkpointMagic[4] = {'M', 'K', 'R', 'S'};
+static const unsigned char checkpointVersion = 2;
+// every product has one code per book type
+static const unsigned int bookTypes = 5;
+// rows are handed to the book this many at a time
+static const std::size_t segmentRows = 4096;
+
+/** appends a length prefixed string */
+static void putString(std::string& out, std::string_view value)
+{
+    putVarint(out, value.size());
+    out.append(value.data(), value.size());
+}
+
+/** reads a length prefixed string, pos moves past it */
+static std::string getString(const std::string& in, std::size_t& pos)
+{
+    std::size_t length = getVarint(in, pos);
+    if (length > in.size() - pos) {
+        throw std::runtime_error{"truncated string"};
+    }
+    std::string value = in.substr(pos, length);
+    pos += length;
+    return value;
+}
+
+/** return the id of value in the dictionary, adding it the first time */
+static unsigned int getCode(std::unordered_map<std::string_view, unsigned int>& codes,
+                            std::vector<std::string_view>& dictionary,
+                            std::string_view value)
+{
+    auto it = codes.find(value);
+    if (it != codes.end()) {
+        return it->second;
+    }
+    codes[value] = dictionary.size();
+    dictionary.push_back(value);
+    return dictionary.size() - 1;
+}
+
+/** write all of data to fd, false on an error */
+static bool writeAll(int fd, const char* data, std::size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+/** sync the directory holding filename, so a file renamed into it stays there after a crash */
+static bool syncDirectory(const std::string& filename)
+{
+    std::size_t slash = filename.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : filename.substr(0, slash);
+    int directoryFd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (directoryFd < 0) {
+        return false;
+    }
+    bool synced = ::fsync(directoryFd) == 0;
+    ::close(directoryFd);
+    return synced;
+}
+
+SimulationCheckpoint::SimulationCheckpoint()
+{
+
+}
+
+/** save the state to filename, replacing it in one step */
+bool SimulationCheckpoint::write(std::string filename, std::uint64_t save, const std::string& currentTime, const OrderBook& book, const Wallet& wallet)
+{
+    TraceScope scope{"SimulationCheckpoint::write", "checkpoint", filename};
+    const OrderStore& rows = book.getRows();
+
+    // the strings are views into the book's arena, every one is written once
+    std::unordered_map<std::string_view, unsigned int> codes;
+    std::vector<std::string_view> dictionary;
+    std::vector<std::string_view> timestamps;
+    std::string body;
+    std::size_t lastTimestamp = 0;
+    for (const OrderRow& row : rows)
+    {
+        // rows are sorted, so a timestamp's rows follow each other
+        if (timestamps.size() == 0 || timestamps.back() != row.timestamp) {
+            timestamps.push_back(row.timestamp);
+        }
+        putVarint(body, timestamps.size() - 1 - lastTimestamp);
+        lastTimestamp = timestamps.size() - 1;
+        putVarint(body, getCode(codes, dictionary, row.product) * bookTypes + (unsigned int) row.orderType);
+        putVarint(body, getCode(codes, dictionary, row.username));
+        putFixed(body, doubleToBits(row.price), 8);
+        putFixed(body, doubleToBits(row.amount), 8);
+    }
+
+    std::string out{checkpointMagic, 4};
+    out += (char) checkpointVersion;
+    putVarint(out, save);
+    putString(out, currentTime);
+    std::vector<std::pair<std::string, double>> balances = wallet.getBalances();
+    putVarint(out, balances.size());
+    for (const std::pair<std::string, double>& balance : balances)
+    {
+        putString(out, balance.first);
+        putFixed(out, doubleToBits(balance.second), 8);
+    }
+    putVarint(out, dictionary.size());
+    for (std::string_view value : dictionary)
+    {
+        putString(out, value);
+    }
+    // consecutive timestamps share most of their characters
+    putVarint(out, timestamps.size());
+    std::string_view previous;
+    for (std::string_view timestamp : timestamps)
+    {
+        std::size_t shared = 0;
+        while (shared < previous.size() && shared < timestamp.size() && previous[shared] == timestamp[shared])
+        {
+            ++shared;
+        }
+        putVarint(out, shared);
+        putString(out, timestamp.substr(shared));
+        previous = timestamp;
+    }
+    putVarint(out, rows.size());
+    out += body;
+
+    // written aside, synced and renamed over the old checkpoint, so there always is a whole one.
+    // The directory is synced too, or a crash could bring the old name back after a journal
+    // started from the new checkpoint
+    std::string partial = filename + ".partial";
+    int fd = ::open(partial.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cout << "SimulationCheckpoint: could not open " << partial << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    bool written = writeAll(fd, out.data(), out.size()) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!written) {
+        std::cout << "SimulationCheckpoint: could not write " << partial << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (std::rename(partial.c_str(), filename.c_str()) != 0 || !syncDirectory(filename)) {
+        std::cout << "SimulationCheckpoint: could not replace " << filename << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/** load the state saved in filename, nothing is changed if it can't be read */
+bool SimulationCheckpoint::read(std::string filename, std::uint64_t& save, std::string& currentTime, OrderBook& book, Wallet& wallet)
+{
+    TraceScope scope{"SimulationCheckpoint::read", "checkpoint", filename};
+    std::ifstream file{filename, std::ios::binary};
+    if (!file.is_open()) {
+        std::cout << "SimulationCheckpoint: could not open " << filename << std::endl;
+        return false;
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    std::string in = contents.str();
+    if (in.size() < 5 || in.compare(0, 4, checkpointMagic, 4) != 0 || (unsigned char) in[4] < 1 || (unsigned char) in[4] > checkpointVersion) {
+        std::cout << "SimulationCheckpoint: " << filename << " is not a checkpoint" << std::endl;
+        return false;
+    }
+
+    std::uint64_t restoredSave = 0;
+    std::string restoredTime;
+    OrderBook restoredBook;
+    Wallet restoredWallet;
+    try {
+        std::size_t pos = 5;
+        if ((unsigned char) in[4] >= 2) {
+            restoredSave = getVarint(in, pos);
+        }
+        restoredTime = getString(in, pos);
+        std::size_t currencies = getVarint(in, pos);
+        for (std::size_t i = 0; i < currencies; ++i)
+        {
+            std::string currency = getString(in, pos);
+            if (pos + 8 > in.size()) {
+                throw std::runtime_error{"truncated wallet"};
+            }
+            restoredWallet.setBalance(currency, bitsToDouble(getFixed(in, pos, 8)));
+            pos += 8;
+        }
+        std::size_t dictionarySize = getVarint(in, pos);
+        if (dictionarySize > in.size()) {
+            throw std::runtime_error{"corrupt dictionary"};
+        }
+        std::vector<std::string> dictionary(dictionarySize);
+        for (std::string& value : dictionary)
+        {
+            value = getString(in, pos);
+        }
+        std::size_t timestampCount = getVarint(in, pos);
+        if (timestampCount > in.size()) {
+            throw std::runtime_error{"corrupt timestamps"};
+        }
+        std::vector<std::string> timestamps(timestampCount);
+        for (std::size_t i = 0; i < timestampCount; ++i)
+        {
+            std::size_t shared = getVarint(in, pos);
+            if (shared > (i == 0 ? 0 : timestamps[i - 1].size())) {
+                throw std::runtime_error{"corrupt timestamps"};
+            }
+            timestamps[i] = (i == 0 ? std::string{} : timestamps[i - 1].substr(0, shared)) + getString(in, pos);
+        }
+
+        std::size_t rowCount = getVarint(in, pos);
+        std::size_t timestamp = 0;
+        std::vector<OrderBookEntry> segment;
+        segment.reserve(std::min(rowCount, segmentRows));
+        for (std::size_t i = 0; i < rowCount; ++i)
+        {
+            timestamp += getVarint(in, pos);
+            std::size_t code = getVarint(in, pos);
+            std::size_t username = getVarint(in, pos);
+            if (timestamp >= timestamps.size() || code / bookTypes >= dictionary.size() || username >= dictionary.size() || pos + 16 > in.size()) {
+                throw std::runtime_error{"corrupt row"};
+            }
+            segment.push_back(OrderBookEntry{bitsToDouble(getFixed(in, pos, 8)),
+                                             bitsToDouble(getFixed(in, pos + 8, 8)),
+                                             timestamps[timestamp],
+                                             dictionary[code / bookTypes],
+                                             (OrderBookType) (code % bookTypes),
+                                             dictionary[username]});
+            pos += 16;
+            if (segment.size() == segmentRows) {
+                restoredBook.appendOrders(segment);
+                segment.clear();
+            }
+        }
+        restoredBook.appendOrders(segment);
+    } catch (const std::exception& e) {
+        std::cout << "SimulationCheckpoint: " << filename << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    save = restoredSave;
+    currentTime = restoredTime;
+    book = std::move(restoredBook);
+    wallet = std::move(restoredWallet);
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include "OrderBook.h"
+#include "Wallet.h"
+
+/** the complete state of a simulation saved as a compact binary file: the current
+ * time, the wallet and every order of the book, our own orders included.
+ *
+ * Rows are written in book order. Timestamps are kept once, each stored as the
+ * suffix it doesn't share with the one before, and a row refers to its timestamp
+ * by the distance from the previous row's. Products, sides and usernames are
+ * dictionary codes, prices and amounts their exact bits. Restoring decodes the
+ * rows straight into a book, so it takes time in proportion to the file and not
+ * to the steps that led to it.
+ *
+ * Every save of a simulation gets the next save sequence number, which the journal
+ * started from the checkpoint repeats, so a journal can tell whether the checkpoint
+ * it names was replaced by a later save
+ */
+class SimulationCheckpoint
+{
+    public:
+        SimulationCheckpoint();
+
+        /** save the state to filename as save number save. The file is replaced in one step, so an
+         * interrupted write leaves the previous checkpoint in place, and it is on disk once this
+         * returns true. Returns false if it couldn't be written
+         * */
+        static bool write(std::string filename, std::uint64_t save, const std::string& currentTime, const OrderBook& book, const Wallet& wallet);
+        /** load the state saved in filename. Nothing is changed and false is returned if the
+         * file can't be read or isn't a checkpoint
+         * */
+        static bool read(std::string filename, std::uint64_t& save, std::string& currentTime, OrderBook& book, Wallet& wallet);
+};
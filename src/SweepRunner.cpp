@@ -0,0 +1,263 @@
+#include "SweepRunner.h"
+#include "WorkStealingPool.h"
+#include "Tokenizer.h"
+#include "CSVReader.h"
+#include "Trace.h"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+// the time frames the predictions look back over, as predict does
+static const int predictionWindow = 5;
+// the username of the runs' orders, the one matchOrders and the wallet settle for
+static const std::string sweepUser = "simuser";
+
+SweepRunner::SweepRunner(std::shared_ptr<const OrderBook> book, std::string currency, double initialAmount)
+: book(book), currency(currency), initialAmount(initialAmount), steals(0)
+{
+    products = book->getKnownProducts();
+    for (const std::string& product : products)
+    {
+        std::size_t slash = product.find('/');
+        productCurrencies.push_back({product.substr(0, slash), slash == std::string::npos ? "" : product.substr(slash + 1)});
+    }
+
+    // every currency is valued at the mid price of a product pairing it with one already valued,
+    // a pass per hop away from the valuation currency
+    std::string latestTime = book->getLatestTime();
+    std::vector<double> mids(products.size(), std::numeric_limits<double>::quiet_NaN());
+    for (std::size_t i = 0; i < products.size(); ++i)
+    {
+        PriceSummary bids = book->getWindowSummary(products[i], latestTime, predictionWindow, OrderBookType::bid);
+        PriceSummary asks = book->getWindowSummary(products[i], latestTime, predictionWindow, OrderBookType::ask);
+        if (bids.count > 0 && asks.count > 0) {
+            mids[i] = (bids.max + asks.min) / 2;
+        }
+    }
+    prices[currency] = 1;
+    bool valued = true;
+    while (valued)
+    {
+        valued = false;
+        for (std::size_t i = 0; i < products.size(); ++i)
+        {
+            const std::string& base = productCurrencies[i].first;
+            const std::string& quote = productCurrencies[i].second;
+            if (std::isnan(mids[i]) || mids[i] <= 0) {
+                continue;
+            }
+            if (prices.count(quote) > 0 && prices.count(base) == 0) {
+                prices[base] = mids[i] * prices[quote];
+                valued = true;
+            } else if (prices.count(base) > 0 && prices.count(quote) == 0) {
+                prices[quote] = prices[base] / mids[i];
+                valued = true;
+            }
+        }
+    }
+}
+
+/** run every configuration on threads threads, returning the results in the order of configs */
+std::vector<SweepResult> SweepRunner::run(const std::vector<SweepConfig>& configs, unsigned int threads)
+{
+    TraceScope scope{"SweepRunner::run", "sweep", std::to_string(configs.size()) + " runs"};
+    // the predictions only depend on the book, every run of a model reads the same ones
+    for (const SweepConfig& config : configs)
+    {
+        if (predictions.count(config.model) == 0) {
+            predict(config.model);
+        }
+    }
+
+    std::vector<SweepResult> results(configs.size());
+    WorkStealingPool pool{threads};
+    pool.run(configs.size(), [this, &configs, &results](std::size_t task, unsigned int worker)
+    {
+        results[task] = runConfig(configs[task]);
+        results[task].worker = worker;
+    });
+    steals = pool.getSteals();
+    return results;
+}
+
+/** return the amount of tasks the last run moved between threads */
+std::size_t SweepRunner::getSteals() const
+{
+    return steals;
+}
+
+/** fill the predictions of model for every time frame */
+void SweepRunner::predict(PredictionModel model)
+{
+    TraceScope scope{"SweepRunner::predict", "sweep", PriceModels::modelToString(model)};
+    const std::vector<std::string>& timestamps = book->getTimestamps();
+    std::vector<Prediction>& table = predictions[model];
+    table.assign(timestamps.size() * products.size(), Prediction{std::numeric_limits<double>::quiet_NaN(),
+                                                                 std::numeric_limits<double>::quiet_NaN()});
+    // a time frame is traded on what was known before it, the first one has nothing to go on
+    for (std::size_t position = 1; position < timestamps.size(); ++position)
+    {
+        for (std::size_t i = 0; i < products.size(); ++i)
+        {
+            Prediction& prediction = table[position * products.size() + i];
+            prediction.bid = book->calcProductPrediction(products[i], timestamps[position - 1], predictionWindow, OrderBookType::bid, "max", model);
+            prediction.ask = book->calcProductPrediction(products[i], timestamps[position - 1], predictionWindow, OrderBookType::ask, "min", model);
+        }
+    }
+}
+
+/** backtest one configuration */
+SweepResult SweepRunner::runConfig(const SweepConfig& config) const
+{
+    TraceScope scope{"SweepRunner::runConfig", "sweep", PriceModels::modelToString(config.model)};
+    auto start = std::chrono::steady_clock::now();
+    SweepResult result{config, 0, 0, 0, 0, 0, 0};
+    Wallet wallet;
+    wallet.insertCurrency(currency, initialAmount);
+    result.startValue = valueOf(wallet);
+
+    const std::vector<std::string>& timestamps = book->getTimestamps();
+    const std::vector<Prediction>& table = predictions.find(config.model)->second;
+    std::vector<OrderBookEntry> ownAsks;
+    std::vector<OrderBookEntry> ownBids;
+    for (std::size_t position = 1; position < timestamps.size(); ++position)
+    {
+        const std::string& timestamp = timestamps[position];
+        for (std::size_t i = 0; i < products.size(); ++i)
+        {
+            const Prediction& prediction = table[position * products.size() + i];
+            ownAsks.clear();
+            ownBids.clear();
+
+            double bidPrice = prediction.ask * (1 - config.bidOffset);
+            double quoteBalance = wallet.getBalance(productCurrencies[i].second);
+            if (!std::isnan(bidPrice) && bidPrice > 0 && quoteBalance > 0) {
+                ownBids.push_back(OrderBookEntry{bidPrice, quoteBalance * config.orderFraction / bidPrice,
+                                                 timestamp, products[i], OrderBookType::bid, sweepUser});
+            }
+            double askPrice = prediction.bid * (1 + config.askOffset);
+            double baseBalance = wallet.getBalance(productCurrencies[i].first);
+            // an ask at or below our own bid would only trade with ourselves
+            bool crossesOwnBid = ownBids.size() > 0 && askPrice <= bidPrice;
+            if (!std::isnan(askPrice) && askPrice > 0 && baseBalance > 0 && !crossesOwnBid) {
+                ownAsks.push_back(OrderBookEntry{askPrice, baseBalance * config.orderFraction,
+                                                 timestamp, products[i], OrderBookType::ask, sweepUser});
+            }
+            // the wallet only settles our sales, a time frame we have no orders in changes nothing
+            if (ownAsks.size() == 0 && ownBids.size() == 0) {
+                continue;
+            }
+            result.orders += ownAsks.size() + ownBids.size();
+            // neither would trade if our bid is below every ask and our ask above every bid,
+            // which the book's price summaries tell without copying its orders
+            bool bidCrosses = ownBids.size() > 0 && book->getPriceSummary(products[i], OrderBookType::ask, timestamp, timestamp).min <= bidPrice;
+            bool askCrosses = ownAsks.size() > 0 && book->getPriceSummary(products[i], OrderBookType::bid, timestamp, timestamp).max >= askPrice;
+            if (!bidCrosses && !askCrosses) {
+                continue;
+            }
+
+            // the book's orders of the time frame are copied, matching uses up their amounts
+            std::pair<std::vector<OrderBookEntry>, std::vector<OrderBookEntry>> orders = book->getOrdersByBidAsk(products[i], timestamp);
+            orders.first.insert(orders.first.end(), ownAsks.begin(), ownAsks.end());
+            orders.second.insert(orders.second.end(), ownBids.begin(), ownBids.end());
+            std::vector<OrderBookEntry> sales = OrderBook::matchOrders(orders.first, orders.second, products[i], timestamp);
+            for (const OrderBookEntry& sale : sales)
+            {
+                if (sale.username == sweepUser) {
+                    result.sales++;
+                }
+            }
+            wallet.processSales(sales, sweepUser);
+        }
+    }
+
+    result.endValue = valueOf(wallet);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+/** return the wallet's value in the valuation currency at the last time */
+double SweepRunner::valueOf(const Wallet& wallet) const
+{
+    double value = 0;
+    for (const std::pair<std::string, double>& balance : wallet.getBalances())
+    {
+        auto price = prices.find(balance.first);
+        // a currency without a price can't be valued, it counts for nothing
+        if (price != prices.end()) {
+            value += balance.second * price->second;
+        }
+    }
+    return value;
+}
+
+/** return count configurations spread over the models, offsets and order fractions.
+ * The grid has 4 models x 8 bid offsets x 8 ask offsets x 4 fractions, it repeats after 1024
+ * */
+std::vector<SweepConfig> SweepRunner::makeGrid(std::size_t count)
+{
+    const PredictionModel models[] = {PredictionModel::percentile, PredictionModel::ewma, PredictionModel::trend, PredictionModel::vwap};
+    const double offsets[] = {-0.01, -0.005, -0.002, 0, 0.002, 0.005, 0.01, 0.02};
+    const double fractions[] = {0.05, 0.1, 0.2, 0.4};
+    std::vector<SweepConfig> configs;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        configs.push_back(SweepConfig{models[i % 4], offsets[i / 4 % 8], offsets[i / 32 % 8], fractions[i / 256 % 4]});
+    }
+    return configs;
+}
+
+/** read configurations from a csv file of model,bidOffset,askOffset,orderFraction lines */
+bool SweepRunner::readConfigs(std::string filename, std::vector<SweepConfig>& configs)
+{
+    std::ifstream file{filename};
+    if (!file.is_open()) {
+        std::cout << "SweepRunner: could not open " << filename << std::endl;
+        return false;
+    }
+    std::string line;
+    unsigned long lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        if (line.size() == 0 || line[0] == '#') {
+            continue;
+        }
+        std::string_view tokens[4];
+        SweepConfig config;
+        if (CSVReader::tokenise(line, ',', tokens, 4) != 4
+            || !PriceModels::stringToModel(std::string{tokens[0]}, config.model)
+            || !CSVReader::parseDouble(tokens[1], config.bidOffset)
+            || !CSVReader::parseDouble(tokens[2], config.askOffset)
+            || !CSVReader::parseDouble(tokens[3], config.orderFraction)
+            || config.orderFraction <= 0 || config.orderFraction > 1) {
+            std::cout << "SweepRunner: bad configuration on line " << lineNumber << " of " << filename
+                      << ", expected model,bidOffset,askOffset,orderFraction" << std::endl;
+            return false;
+        }
+        configs.push_back(config);
+    }
+    return true;
+}
+
+/** write results as csv, one line per run */
+void SweepRunner::writeResults(std::ostream& out, const std::vector<SweepResult>& results)
+{
+    out << "model,bidOffset,askOffset,orderFraction,startValue,endValue,pnl,orders,sales,seconds,worker\n";
+    for (const SweepResult& result : results)
+    {
+        out << PriceModels::modelToString(result.config.model) << ','
+            << result.config.bidOffset << ','
+            << result.config.askOffset << ','
+            << result.config.orderFraction << ','
+            << result.startValue << ','
+            << result.endValue << ','
+            << result.endValue - result.startValue << ','
+            << result.orders << ','
+            << result.sales << ','
+            << result.seconds << ','
+            << result.worker << '\n';
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <ostream>
+#include "OrderBook.h"
+#include "Wallet.h"
+#include "PriceModels.h"
+
+/** the parameters of one backtest run */
+struct SweepConfig
+{
+    PredictionModel model;
+    // our bid is placed this fraction below the predicted lowest ask, negative crosses it
+    double bidOffset;
+    // our ask is placed this fraction above the predicted highest bid, negative crosses it
+    double askOffset;
+    // the fraction of the balance put into every order
+    double orderFraction;
+};
+
+/** the outcome of one backtest run */
+struct SweepResult
+{
+    SweepConfig config;
+    // the wallet valued in the valuation currency at the last time, before and after the run
+    double startValue;
+    double endValue;
+    unsigned long orders;
+    unsigned long sales;
+    double seconds;
+    unsigned int worker;
+};
+
+/** backtests many strategy configurations against one order book.
+ * The book is loaded once and shared read-only by every run, as are the predictions of
+ * every model, which only depend on the book. A run is a MerkelMain style simulation
+ * with a wallet and orders of its own: every time frame it bids and asks around the
+ * prices predicted from the time frames before it, and its orders are matched together
+ * with the book's orders of that time frame (the overlay), which the book never sees.
+ * Runs are independent, so they run in parallel on a WorkStealingPool
+ */
+class SweepRunner
+{
+    public:
+        /** runs start with initialAmount of currency in the wallet, which is also what the result is valued in */
+        SweepRunner(std::shared_ptr<const OrderBook> book, std::string currency = "BTC", double initialAmount = 10);
+
+        /** run every configuration on threads threads, returning the results in the order of configs */
+        std::vector<SweepResult> run(const std::vector<SweepConfig>& configs, unsigned int threads);
+        /** return the amount of tasks the last run moved between threads */
+        std::size_t getSteals() const;
+
+        /** return count configurations spread over the models, offsets and order fractions */
+        static std::vector<SweepConfig> makeGrid(std::size_t count);
+        /** read configurations from a csv file of model,bidOffset,askOffset,orderFraction lines.
+         * False if it can't be read or a line is bad
+         * */
+        static bool readConfigs(std::string filename, std::vector<SweepConfig>& configs);
+        /** write results as csv, one line per run */
+        static void writeResults(std::ostream& out, const std::vector<SweepResult>& results);
+
+    private:
+        /** the predicted highest bid and lowest ask of a product */
+        struct Prediction
+        {
+            double bid;
+            double ask;
+        };
+
+        /** fill the predictions of model for every time frame, once per model */
+        void predict(PredictionModel model);
+        /** backtest one configuration */
+        SweepResult runConfig(const SweepConfig& config) const;
+        /** return the wallet's value in the valuation currency at the last time */
+        double valueOf(const Wallet& wallet) const;
+
+        std::shared_ptr<const OrderBook> book;
+        std::string currency;
+        double initialAmount;
+        std::vector<std::string> products;
+        // per product, its base and quote currency
+        std::vector<std::pair<std::string, std::string>> productCurrencies;
+        // currency -> price in the valuation currency at the last time, from the mid prices
+        std::map<std::string, double> prices;
+        // per model, the prediction for every time frame and product, at timestamp position * products + product
+        std::map<PredictionModel, std::vector<Prediction>> predictions;
+        std::size_t steals;
+};
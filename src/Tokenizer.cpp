@@ -0,0 +1,79 @@
+#include "Tokenizer.h"
+
+Tokenizer::Tokenizer(std::string_view _line, char _separator)
+: line(_line), writable(nullptr), separator(_separator), position(_line.find_first_not_of(_separator))
+{
+    if (position == std::string_view::npos) {
+        position = line.size();
+    }
+}
+
+Tokenizer::Tokenizer(char* _line, std::size_t size, char _separator)
+: Tokenizer(std::string_view{_line, size}, _separator)
+{
+    writable = _line;
+}
+
+Tokenizer::Tokenizer(std::string& _line, char _separator)
+: Tokenizer(_line.data(), _line.size(), _separator)
+{
+
+}
+
+/** set field to the next field of the line, false when there is none */
+bool Tokenizer::next(std::string_view& field)
+{
+    // an empty field ends the line
+    if (position >= line.size() || line[position] == separator) {
+        position = line.size();
+        return false;
+    }
+
+    if (line[position] == '"') {
+        // find the closing quote, skipping doubled ones
+        std::size_t close = line.find('"', position + 1);
+        while (close != std::string_view::npos && close + 1 < line.size() && line[close + 1] == '"')
+        {
+            close = line.find('"', close + 2);
+        }
+        if (close == std::string_view::npos) {
+            // unterminated, the field runs to the end of the line
+            field = unescape(position + 1, line.size());
+            position = line.size();
+            return true;
+        }
+        field = unescape(position + 1, close);
+        std::size_t end = line.find(separator, close + 1);
+        position = end == std::string_view::npos ? line.size() : end + 1;
+        return true;
+    }
+
+    std::size_t end = line.find(separator, position);
+    if (end == std::string_view::npos) {
+        field = line.substr(position);
+        position = line.size();
+        return true;
+    }
+    field = line.substr(position, end - position);
+    position = end + 1;
+    return true;
+}
+
+/** return the text of a quoted field in [start, end), unescaped if the line may be rewritten */
+std::string_view Tokenizer::unescape(std::size_t start, std::size_t end)
+{
+    std::string_view quoted = line.substr(start, end - start);
+    if (writable == nullptr || quoted.find("\"\"") == std::string_view::npos) {
+        return quoted;
+    }
+    // the field only shrinks, so it stays inside its own quotes and earlier fields keep their text
+    std::size_t out = start;
+    for (std::size_t in = start; in < end; ++in)
+    {
+        writable[out++] = writable[in];
+        if (writable[in] == '"' && in + 1 < end && writable[in + 1] == '"') {
+            ++in;
+        }
+    }
+    return std::string_view{writable + start, out - start};
+}
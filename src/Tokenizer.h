@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+/** splits a line into fields, viewing the line instead of copying it, so it never allocates:
+ *
+ *     Tokenizer tokenizer{line, ','};
+ *     std::string_view field;
+ *     while (tokenizer.next(field)) { ... }
+ *
+ * As CSVReader::tokenise always did, separators at the start of the line are
+ * skipped and an empty field ends the line. A field starting with a double quote
+ * runs to the closing quote and may contain separators; the field is the text
+ * between the quotes. A doubled quote inside it stands for one quote: over a line
+ * it may rewrite the tokenizer makes it single in place, moving the rest of the
+ * field up, over a read-only line it is left as it is.
+ * The line must outlive the fields
+ */
+class Tokenizer
+{
+    public:
+        Tokenizer(std::string_view _line, char _separator);
+        /** tokenize a line whose quoted fields may be rewritten to unescape doubled quotes */
+        Tokenizer(char* _line, std::size_t size, char _separator);
+        Tokenizer(std::string& _line, char _separator);
+        /** set field to the next field of the line, false when there is none */
+        bool next(std::string_view& field);
+
+    private:
+        /** return the text of a quoted field in [start, end), unescaped if the line may be rewritten */
+        std::string_view unescape(std::size_t start, std::size_t end);
+
+        std::string_view line;
+        // the line's characters if they may be rewritten, else nullptr
+        char* writable;
+        char separator;
+        // start of the next field, line.size() once done
+        std::size_t position;
+};
@@ -0,0 +1,155 @@
+#include "Trace.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+std::atomic<bool> Trace::enabled{false};
+
+namespace
+{
+    /** one complete event */
+    struct TraceEvent
+    {
+        const char* name;
+        const char* category;
+        std::string detail;
+        double start;
+        double duration;
+    };
+
+    /** the events of one thread, only that thread adds to it */
+    struct ThreadBuffer
+    {
+        unsigned int threadId;
+        std::string threadName;
+        // taken by the owning thread for every event, and by stop() once, so nearly never contended
+        std::mutex mutex;
+        std::vector<TraceEvent> events;
+    };
+
+    std::mutex registryMutex;
+    std::string traceFile;
+    std::chrono::steady_clock::time_point traceStart;
+    // owned here, so events outlive the threads that recorded them
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+    /** return the calling thread's buffer, registering it on first use */
+    ThreadBuffer& threadBuffer()
+    {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (buffer == nullptr) {
+            std::lock_guard<std::mutex> lock{registryMutex};
+            buffers.emplace_back(new ThreadBuffer());
+            buffer = buffers.back().get();
+            buffer->threadId = (unsigned int) buffers.size();
+        }
+        return *buffer;
+    }
+
+    /** write text as a JSON string */
+    void writeString(std::ostream& out, const std::string& text)
+    {
+        out << '"';
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if ((unsigned char) c < 0x20) {
+                out << ' ';
+            } else {
+                out << c;
+            }
+        }
+        out << '"';
+    }
+}
+
+/** start recording, events are written to filename by stop() */
+void Trace::start(std::string filename)
+{
+    std::lock_guard<std::mutex> lock{registryMutex};
+    traceFile = filename;
+    traceStart = std::chrono::steady_clock::now();
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+/** stop recording and write every thread's events, false if the file can't be written.
+ * Threads still recording may lose their last events
+ * */
+bool Trace::stop()
+{
+    if (!enabled.exchange(false)) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock{registryMutex};
+    std::ofstream out{traceFile};
+    if (!out.is_open()) {
+        std::cerr << "Trace::stop could not open " << traceFile << std::endl;
+        return false;
+    }
+
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    unsigned long written = 0;
+    out << std::fixed << std::setprecision(3);
+    for (std::unique_ptr<ThreadBuffer>& buffer : buffers)
+    {
+        std::lock_guard<std::mutex> bufferLock{buffer->mutex};
+        if (buffer->threadName != "") {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+            writeString(out, buffer->threadName);
+            out << "}}";
+            first = false;
+        }
+        for (const TraceEvent& event : buffer->events)
+        {
+            out << (first ? "" : ",\n") << "{\"name\":";
+            writeString(out, event.name);
+            out << ",\"cat\":";
+            writeString(out, event.category);
+            out << ",\"ph\":\"X\",\"ts\":" << event.start << ",\"dur\":" << event.duration
+                << ",\"pid\":1,\"tid\":" << buffer->threadId;
+            if (event.detail != "") {
+                out << ",\"args\":{\"detail\":";
+                writeString(out, event.detail);
+                out << "}";
+            }
+            out << "}";
+            first = false;
+            written++;
+        }
+        buffer->events.clear();
+    }
+    out << "\n]}\n";
+    out.close();
+    std::cerr << "Trace::stop wrote " << written << " events to " << traceFile << std::endl;
+    return !out.fail();
+}
+
+/** name the calling thread in the trace */
+void Trace::setThreadName(std::string name)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock{buffer.mutex};
+    buffer.threadName = name;
+}
+
+/** record an event of the calling thread, times in microseconds since the trace started */
+void Trace::record(const char* name, const char* category, const std::string& detail, double start, double duration)
+{
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock{buffer.mutex};
+    buffer.events.push_back(TraceEvent{name, category, detail, start, duration});
+}
+
+/** return microseconds since the trace started */
+double Trace::now()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - traceStart).count();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <chrono>
+
+/** records timelines of scoped events and writes them as a Chrome trace
+ * (chrome://tracing, ui.perfetto.dev).
+ *
+ * Events go to a buffer of the thread recording them. While tracing is off a
+ * TraceScope costs one relaxed atomic load:
+ *
+ *     TraceScope scope{"OrderBook::matchAsksToBids", "match", product};
+ *
+ * Names and categories must be string literals, only the detail is copied.
+ */
+class Trace
+{
+    public:
+        /** start recording, events are written to filename by stop() */
+        static void start(std::string filename);
+        /** stop recording and write every thread's events, false if the file can't be written.
+         * Threads still recording may lose their last events
+         * */
+        static bool stop();
+        /** return whether events are being recorded */
+        static bool isEnabled()
+        {
+            return enabled.load(std::memory_order_relaxed);
+        }
+        /** name the calling thread in the trace */
+        static void setThreadName(std::string name);
+        /** record an event of the calling thread, times in microseconds since the trace started */
+        static void record(const char* name, const char* category, const std::string& detail, double start, double duration);
+        /** return microseconds since the trace started */
+        static double now();
+
+    private:
+        static std::atomic<bool> enabled;
+};
+
+/** records one event from its construction to its destruction */
+class TraceScope
+{
+    public:
+        // inline, so scopes cost next to nothing while tracing is off
+        TraceScope(const char* _name, const char* _category)
+        : name(_name), category(_category), start(Trace::isEnabled() ? Trace::now() : -1)
+        {
+        }
+        TraceScope(const char* _name, const char* _category, const std::string& _detail)
+        : TraceScope(_name, _category)
+        {
+            if (start >= 0) {
+                detail = _detail;
+            }
+        }
+        ~TraceScope()
+        {
+            if (start >= 0) {
+                Trace::record(name, category, detail, start, Trace::now() - start);
+            }
+        }
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+        const char* name;
+        const char* category;
+        std::string detail;
+        double start;
+};
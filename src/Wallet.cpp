@@ -1,6 +1,8 @@
 #include "Wallet.h"
 #include <iostream>
+#include <algorithm>
 #include "CSVReader.h"
+#include "Trace.h"
 
 Wallet::Wallet()
 {
@@ -10,20 +12,13 @@ Wallet::Wallet()
 
 void Wallet::insertCurrency(std::string type, double amount)
 {
-    double balance;
     if (amount < 0)
     {
         throw std::exception{};
     }
-    if (currencies.count(type) == 0) // not there yet
-    {
-        balance = 0;
-    }
-    else { // is there 
-        balance = currencies[type];
-    }
-    balance += amount; 
-    currencies[type] = balance; 
+    unsigned int id = getCurrencyId(type);
+    balances[id] += amount;
+    held[id] = true;
 }
 
 bool Wallet::removeCurrency(std::string type, double amount)
@@ -32,63 +27,79 @@ bool Wallet::removeCurrency(std::string type, double amount)
     {
         return false; 
     }
-    if (currencies.count(type) == 0) // not there yet
+    auto currencyIt = currencyIds.find(type);
+    if (currencyIt == currencyIds.end() || !held[currencyIt->second]) // not there yet
     {
         //std::cout << "No currency for " << type << std::endl;
         return false;
     }
-    else { // is there - do  we have enough
-        if (containsCurrency(type, amount))// we have enough
-        {
-            //std::cout << "Removing " << type << ": " << amount << std::endl;
-            currencies[type] -= amount;
-            return true;
-        } 
-        else // they have it but not enough.
-            return false; 
+    // is there - do  we have enough
+    if (balances[currencyIt->second] >= amount)// we have enough
+    {
+        //std::cout << "Removing " << type << ": " << amount << std::endl;
+        balances[currencyIt->second] -= amount;
+        return true;
     }
+    // they have it but not enough.
+    return false;
 }
 
-bool Wallet::containsCurrency(std::string type, double amount)
+double Wallet::getBalance(const std::string& type) const
 {
-    if (currencies.count(type) == 0) // not there yet
+    auto currencyIt = currencyIds.find(type);
+    if (currencyIt == currencyIds.end() || !held[currencyIt->second])
+        return 0;
+    return balances[currencyIt->second];
+}
+
+bool Wallet::containsCurrency(std::string type, double amount) const
+{
+    auto currencyIt = currencyIds.find(type);
+    if (currencyIt == currencyIds.end() || !held[currencyIt->second]) // not there yet
         return false;
-    else 
-        return currencies[type] >= amount;
-    
+    return balances[currencyIt->second] >= amount;
 }
 
 std::string Wallet::toString()
 {
+    // listed by name, as ids follow the order of first use
+    std::vector<unsigned int> ids;
+    for (unsigned int id = 0; id < currencyNames.size(); ++id)
+    {
+        if (held[id]) {
+            ids.push_back(id);
+        }
+    }
+    std::sort(ids.begin(), ids.end(), [this](unsigned int a, unsigned int b) { return currencyNames[a] < currencyNames[b]; });
+
     std::string s;
-    for (std::pair<std::string,double> pair : currencies)
+    for (unsigned int id : ids)
     {
-        std::string currency = pair.first;
-        double amount = pair.second;
-        s += currency + " : " + std::to_string(amount) + "\n";
+        s += currencyNames[id] + " : " + std::to_string(balances[id]) + "\n";
     }
     return s;
 }
 
-bool Wallet::canFulfillOrder(OrderBookEntry order)
+bool Wallet::canFulfillOrder(const OrderBookEntry& order)
 {
-    std::vector<std::string> currs = CSVReader::tokenise(order.product, '/');
+    TraceScope scope{"Wallet::canFulfillOrder", "wallet", order.product};
+    const ProductCurrencies& currencies = getProductCurrencies(order.product);
+    if (!currencies.valid) {
+        return false;
+    }
     // ask
     if (order.orderType == OrderBookType::ask)
     {
         double amount = order.amount;
-        std::string currency = currs[0];
-        std::cout << "Wallet::canFulfillOrder " << currency << " : " << amount << std::endl;
-
-        return containsCurrency(currency, amount);
+        std::cout << "Wallet::canFulfillOrder " << currencyNames[currencies.base] << " : " << amount << std::endl;
+        return held[currencies.base] && balances[currencies.base] >= amount;
     }
     // bid
     if (order.orderType == OrderBookType::bid)
     {
         double amount = order.amount * order.price;
-        std::string currency = currs[1];
-        std::cout << "Wallet::canFulfillOrder " << currency << " : " << amount << std::endl;
-        return containsCurrency(currency, amount);
+        std::cout << "Wallet::canFulfillOrder " << currencyNames[currencies.quote] << " : " << amount << std::endl;
+        return held[currencies.quote] && balances[currencies.quote] >= amount;
     }
 
 
@@ -96,33 +107,109 @@ bool Wallet::canFulfillOrder(OrderBookEntry order)
 }
       
 
-void Wallet::processSale(OrderBookEntry& sale)
+void Wallet::processSale(const OrderBookEntry& sale)
 {
-    std::vector<std::string> currs = CSVReader::tokenise(sale.product, '/');
-    // ask
-    if (sale.orderType == OrderBookType::asksale)
+    TraceScope scope{"Wallet::processSale", "wallet", sale.product};
+    settle(sale, getProductCurrencies(sale.product));
+}
+
+/** update the contents of the wallet with every sale of username,
+ * e.g. all sales of a timeframe, in one pass
+ * */
+void Wallet::processSales(const std::vector<OrderBookEntry>& sales, const std::string& username)
+{
+    TraceScope scope{"Wallet::processSales", "wallet"};
+    // sales of a timeframe come product by product, so the product rarely changes
+    const std::string* lastProduct = nullptr;
+    const ProductCurrencies* currencies = nullptr;
+    for (const OrderBookEntry& sale : sales)
     {
-        double outgoingAmount = sale.amount;
-        std::string outgoingCurrency = currs[0];
-        double incomingAmount = sale.amount * sale.price;
-        std::string incomingCurrency = currs[1];
+        if (sale.username != username) {
+            continue;
+        }
+        if (lastProduct == nullptr || *lastProduct != sale.product) {
+            currencies = &getProductCurrencies(sale.product);
+            lastProduct = &sale.product;
+        }
+        settle(sale, *currencies);
+    }
+}
+
+/** return the id of currency, assigning one the first time */
+unsigned int Wallet::getCurrencyId(const std::string& currency)
+{
+    auto currencyIt = currencyIds.find(currency);
+    if (currencyIt != currencyIds.end()) {
+        return currencyIt->second;
+    }
+    unsigned int id = (unsigned int) currencyNames.size();
+    currencyIds.emplace(currency, id);
+    currencyNames.push_back(currency);
+    balances.push_back(0);
+    held.push_back(false);
+    return id;
+}
 
-        currencies[incomingCurrency] += incomingAmount;
-        currencies[outgoingCurrency] -= outgoingAmount;
+/** return the currency ids of product, e.g. ETH and BTC of ETH/BTC */
+const Wallet::ProductCurrencies& Wallet::getProductCurrencies(const std::string& product)
+{
+    auto productIt = productCurrencies.find(product);
+    if (productIt != productCurrencies.end()) {
+        return productIt->second;
+    }
+    std::string_view currs[2];
+    ProductCurrencies currencies{0, 0, CSVReader::tokenise(product, '/', currs, 2) == 2};
+    if (currencies.valid) {
+        currencies.base = getCurrencyId(std::string{currs[0]});
+        currencies.quote = getCurrencyId(std::string{currs[1]});
+    }
+    return productCurrencies.emplace(product, currencies).first->second;
+}
 
+/** apply a sale of the currencies to the balances */
+void Wallet::settle(const OrderBookEntry& sale, const ProductCurrencies& currencies)
+{
+    if (!currencies.valid) {
+        return;
     }
-    // bid
-    if (sale.orderType == OrderBookType::bidsale)
+    // ask: base goes out, quote comes in
+    if (sale.orderType == OrderBookType::asksale)
     {
-        double incomingAmount = sale.amount;
-        std::string incomingCurrency = currs[0];
-        double outgoingAmount = sale.amount * sale.price;
-        std::string outgoingCurrency = currs[1];
-
-        currencies[incomingCurrency] += incomingAmount;
-        currencies[outgoingCurrency] -= outgoingAmount;
+        balances[currencies.quote] += sale.amount * sale.price;
+        balances[currencies.base] -= sale.amount;
+    }
+    // bid: quote goes out, base comes in
+    else if (sale.orderType == OrderBookType::bidsale)
+    {
+        balances[currencies.base] += sale.amount;
+        balances[currencies.quote] -= sale.amount * sale.price;
+    }
+    else
+    {
+        return;
     }
+    held[currencies.base] = true;
+    held[currencies.quote] = true;
 }
+std::vector<std::pair<std::string, double>> Wallet::getBalances() const
+{
+    std::vector<std::pair<std::string, double>> currencies;
+    for (unsigned int id = 0; id < currencyNames.size(); ++id)
+    {
+        if (held[id]) {
+            currencies.push_back({currencyNames[id], balances[id]});
+        }
+    }
+    return currencies;
+}
+
+void Wallet::setBalance(std::string type, double amount)
+{
+    unsigned int id = getCurrencyId(type);
+    balances[id] = amount;
+    held[id] = true;
+}
+
 std::ostream& operator<<(std::ostream& os,  Wallet& wallet)
 {
     os << wallet.toString();
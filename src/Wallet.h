@@ -1,10 +1,17 @@
 #pragma once
 
 #include <string>
-#include <map>
+#include <vector>
+#include <unordered_map>
+#include <utility>
 #include "OrderBookEntry.h"
 #include <iostream>
 
+/** balances per currency.
+ * Currencies get dense ids in order of first use and balances are kept in
+ * an array indexed by them. The base and quote currency ids of a product
+ * are resolved once, so settling a sale is two array updates
+ */
 class Wallet 
 {
     public:
@@ -14,14 +21,24 @@ class Wallet
         /** remove currency from the wallet */
         bool removeCurrency(std::string type, double amount);
         
+        /** return the balance of a currency, 0 if the wallet never held it */
+        double getBalance(const std::string& type) const;
         /** check if the wallet contains this much currency or more */
-        bool containsCurrency(std::string type, double amount);
+        bool containsCurrency(std::string type, double amount) const;
         /** checks if the wallet can cope with this ask or bid.*/
-        bool canFulfillOrder(OrderBookEntry order);
+        bool canFulfillOrder(const OrderBookEntry& order);
         /** update the contents of the wallet
          * assumes the order was made by the owner of the wallet
         */
-        void processSale(OrderBookEntry& sale);
+        void processSale(const OrderBookEntry& sale);
+        /** update the contents of the wallet with every sale of username,
+         * e.g. all sales of a timeframe, in one pass
+         * */
+        void processSales(const std::vector<OrderBookEntry>& sales, const std::string& username);
+        /** return the currencies in the wallet and their balances, in order of first use */
+        std::vector<std::pair<std::string, double>> getBalances() const;
+        /** set the balance of a currency, e.g. one saved with getBalances */
+        void setBalance(std::string type, double amount);
 
 
         /** generate a string representation of the wallet */
@@ -30,11 +47,30 @@ class Wallet
 
         
     private:
-        std::map<std::string,double> currencies;
+        /** base and quote currency ids of a product */
+        struct ProductCurrencies
+        {
+            unsigned int base;
+            unsigned int quote;
+            bool valid;
+        };
 
+        /** return the id of currency, assigning one the first time */
+        unsigned int getCurrencyId(const std::string& currency);
+        /** return the currency ids of product, e.g. ETH and BTC of ETH/BTC */
+        const ProductCurrencies& getProductCurrencies(const std::string& product);
+        /** apply a sale of the currencies to the balances */
+        void settle(const OrderBookEntry& sale, const ProductCurrencies& currencies);
+
+        // currency -> id, ids index the vectors below
+        std::unordered_map<std::string, unsigned int> currencyIds;
+        std::vector<std::string> currencyNames;
+        std::vector<double> balances;
+        // whether the currency was ever put in the wallet, only those are listed
+        std::vector<bool> held;
+        std::unordered_map<std::string, ProductCurrencies> productCurrencies;
 };
 
 
 
 	
-
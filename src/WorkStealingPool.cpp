@@ -0,0 +1,95 @@
+#include "WorkStealingPool.h"
+#include "Trace.h"
+#include <thread>
+#include <string>
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(unsigned int threads)
+: threads(std::max(1u, threads)), steals(0)
+{
+    for (unsigned int i = 0; i < this->threads; ++i)
+    {
+        queues.push_back(std::make_unique<TaskQueue>());
+    }
+}
+
+/** run task(i, worker) for every i in [0, tasks) and return once all of them are done */
+void WorkStealingPool::run(std::size_t tasks, const std::function<void(std::size_t task, unsigned int worker)>& task)
+{
+    // tasks are never added while running, so a worker that finds every deque empty is done
+    steals = 0;
+    for (unsigned int worker = 0; worker < threads; ++worker)
+    {
+        std::size_t first = tasks * worker / threads;
+        std::size_t last = tasks * (worker + 1) / threads;
+        std::deque<std::size_t>& own = queues[worker]->tasks;
+        own.clear();
+        for (std::size_t i = first; i < last; ++i)
+        {
+            own.push_back(i);
+        }
+    }
+
+    auto work = [this, &task](unsigned int worker)
+    {
+        std::size_t next;
+        while (take(worker, next))
+        {
+            task(next, worker);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int worker = 1; worker < threads; ++worker)
+    {
+        workers.emplace_back([&work, worker]()
+        {
+            Trace::setThreadName("pool worker " + std::to_string(worker));
+            work(worker);
+        });
+    }
+    // the calling thread is worker 0
+    work(0);
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+/** return the amount of worker threads */
+unsigned int WorkStealingPool::getThreads() const
+{
+    return threads;
+}
+
+/** return the amount of tasks taken from another worker's deque in the last run */
+std::size_t WorkStealingPool::getSteals() const
+{
+    return steals;
+}
+
+/** take the next task of worker, stealing one if its own deque is empty */
+bool WorkStealingPool::take(unsigned int worker, std::size_t& task)
+{
+    {
+        TaskQueue& own = *queues[worker];
+        std::lock_guard<std::mutex> lock{own.mutex};
+        if (own.tasks.size() > 0) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // victims are tried starting with the next worker, so thieves spread over them
+    for (unsigned int offset = 1; offset < threads; ++offset)
+    {
+        TaskQueue& victim = *queues[(worker + offset) % threads];
+        std::lock_guard<std::mutex> lock{victim.mutex};
+        if (victim.tasks.size() > 0) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            ++steals;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+/** runs a batch of independent tasks on a fixed amount of threads.
+ * Every worker starts with a contiguous share of the tasks in a deque of its own and
+ * takes them from the back. A worker that runs out steals from the front of another's
+ * deque, so a share of slow tasks is spread over the workers that finished early
+ * without every task going through one shared queue
+ */
+class WorkStealingPool
+{
+    public:
+        /** a pool of threads workers, at least one */
+        WorkStealingPool(unsigned int threads);
+
+        /** run task(i, worker) for every i in [0, tasks) and return once all of them are done.
+         * worker is the index of the thread running it, below getThreads()
+         * */
+        void run(std::size_t tasks, const std::function<void(std::size_t task, unsigned int worker)>& task);
+        /** return the amount of worker threads */
+        unsigned int getThreads() const;
+        /** return the amount of tasks taken from another worker's deque in the last run */
+        std::size_t getSteals() const;
+
+    private:
+        /** the tasks waiting for one worker */
+        struct TaskQueue
+        {
+            std::mutex mutex;
+            std::deque<std::size_t> tasks;
+        };
+
+        /** take the next task of worker, stealing one if its own deque is empty. False when none are left */
+        bool take(unsigned int worker, std::size_t& task);
+
+        unsigned int threads;
+        std::vector<std::unique_ptr<TaskQueue>> queues;
+        std::atomic<std::size_t> steals;
+};
@@ -0,0 +1,194 @@
+#include "Benchmark.h"
+#include "../AllocationCounter.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <algorithm>
+#include <sstream>
+
+volatile std::size_t benchmarkSink = 0;
+
+/** run every benchmark for at least minSeconds */
+Benchmark::Benchmark(double _minSeconds)
+: minSeconds(_minSeconds)
+{
+
+}
+
+/** time op, which does opsPerCall operations every call.
+ * setup runs before every call and is not timed, ops without setup are timed in batches
+ * */
+const BenchmarkResult& Benchmark::run(std::string name,
+                                      std::size_t rows,
+                                      std::size_t opsPerCall,
+                                      std::function<void()> op,
+                                      std::function<void()> setup)
+{
+    // warm up caches and lazily built state
+    if (setup) setup();
+    op();
+
+    unsigned long calls = 0;
+    unsigned long allocated = 0;
+    double seconds = 0;
+    // without setup, calls are timed in growing batches so the clock costs next to nothing
+    unsigned long batch = 1;
+    while (seconds < minSeconds)
+    {
+        if (setup) setup();
+        unsigned long before = AllocationCounter::getAllocations();
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned long i = 0; i < batch; ++i)
+        {
+            op();
+        }
+        auto end = std::chrono::steady_clock::now();
+        allocated += AllocationCounter::getAllocations() - before;
+        seconds += std::chrono::duration<double>(end - start).count();
+        calls += batch;
+        if (!setup && batch < (1ul << 20)) {
+            batch *= 2;
+        }
+    }
+
+    double operations = (double) calls * opsPerCall;
+    results.push_back(BenchmarkResult{name, rows, (unsigned long) operations, seconds * 1e9 / operations, allocated / operations});
+    return results.back();
+}
+
+/** return every result so far, in the order run */
+const std::vector<BenchmarkResult>& Benchmark::getResults() const
+{
+    return results;
+}
+
+/** print one row per result, then how every benchmark scales with the dataset size */
+void Benchmark::printTable(std::ostream& out) const
+{
+    out << std::left << std::setw(40) << "benchmark" << std::right << std::setw(10) << "rows"
+        << std::setw(14) << "ns/op" << std::setw(14) << "allocs/op" << std::setw(14) << "ops" << "\n";
+    std::vector<std::string> names;
+    for (const BenchmarkResult& result : results)
+    {
+        out << std::left << std::setw(40) << result.name << std::right << std::setw(10) << result.rows
+            << std::setw(14) << std::fixed << std::setprecision(1) << result.nsPerOp
+            << std::setw(14) << std::setprecision(2) << result.allocsPerOp
+            << std::setw(14) << result.operations << "\n";
+        if (std::find(names.begin(), names.end(), result.name) == names.end()) {
+            names.push_back(result.name);
+        }
+    }
+    out << "\n" << std::left << std::setw(40) << "scaling (ns/op ~ rows^x)" << std::right << std::setw(10) << "x" << "\n";
+    for (const std::string& name : names)
+    {
+        out << std::left << std::setw(40) << name << std::right << std::setw(10) << std::setprecision(2) << getScaling(name) << "\n";
+    }
+    out << std::defaultfloat << std::setprecision(6);
+}
+
+/** write the results as JSON, one result per line so reports diff cleanly */
+void Benchmark::writeJson(std::ostream& out) const
+{
+    out << "{\n  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult& result = results[i];
+        out << "    {\"name\": \"" << result.name << "\", \"rows\": " << result.rows
+            << ", \"operations\": " << result.operations
+            << ", \"ns_per_op\": " << std::fixed << std::setprecision(2) << result.nsPerOp
+            << ", \"allocs_per_op\": " << std::setprecision(3) << result.allocsPerOp
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n  \"scaling\": {";
+    std::vector<std::string> names;
+    for (const BenchmarkResult& result : results)
+    {
+        if (std::find(names.begin(), names.end(), result.name) == names.end()) {
+            out << (names.size() > 0 ? ", " : "") << "\"" << result.name << "\": " << std::setprecision(3) << getScaling(result.name);
+            names.push_back(result.name);
+        }
+    }
+    out << "}\n}\n" << std::defaultfloat << std::setprecision(6);
+}
+
+/** the number after "key": on a line written by writeJson, or -1 */
+static double jsonNumber(const std::string& line, std::string key)
+{
+    std::size_t pos = line.find("\"" + key + "\": ");
+    if (pos == std::string::npos) {
+        return -1;
+    }
+    return std::atof(line.c_str() + pos + key.size() + 4);
+}
+
+/** compare against a JSON report written by writeJson, returns the amount of results
+ * more than threshold (0.1 = 10%) slower or allocating more
+ * */
+unsigned int Benchmark::compare(std::istream& baseline, double threshold, std::ostream& out) const
+{
+    // name and rows identify a result
+    std::map<std::pair<std::string, std::size_t>, std::pair<double, double>> previous;
+    std::string line;
+    while (std::getline(baseline, line))
+    {
+        std::size_t name = line.find("\"name\": \"");
+        if (name == std::string::npos) {
+            continue;
+        }
+        name += 9;
+        std::size_t rows = (std::size_t) jsonNumber(line, "rows");
+        previous[{line.substr(name, line.find('"', name) - name), rows}] = {jsonNumber(line, "ns_per_op"), jsonNumber(line, "allocs_per_op")};
+    }
+
+    unsigned int regressions = 0;
+    out << std::left << std::setw(40) << "benchmark" << std::right << std::setw(10) << "rows"
+        << std::setw(14) << "base ns/op" << std::setw(14) << "ns/op" << std::setw(10) << "change" << "\n";
+    for (const BenchmarkResult& result : results)
+    {
+        auto it = previous.find({result.name, result.rows});
+        if (it == previous.end()) {
+            continue;
+        }
+        double change = result.nsPerOp / it->second.first - 1;
+        bool slower = change > threshold;
+        // allocations are exact, any more of them is a regression
+        bool allocating = result.allocsPerOp > it->second.second + 0.01;
+        out << std::left << std::setw(40) << result.name << std::right << std::setw(10) << result.rows
+            << std::setw(14) << std::fixed << std::setprecision(1) << it->second.first
+            << std::setw(14) << result.nsPerOp
+            << std::setw(9) << std::showpos << change * 100 << "%" << std::noshowpos
+            << (slower ? "  SLOWER" : "") << (allocating ? "  MORE ALLOCATIONS" : "") << "\n";
+        if (slower || allocating) {
+            regressions++;
+        }
+    }
+    out << std::defaultfloat << std::setprecision(6);
+    return regressions;
+}
+
+/** slope of log(ns/op) over log(rows) for a benchmark: 0 is constant time, 1 linear in the rows */
+double Benchmark::getScaling(std::string name) const
+{
+    // least squares fit over every size the benchmark ran at
+    double n = 0, sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for (const BenchmarkResult& result : results)
+    {
+        if (result.name != name || result.rows == 0 || result.nsPerOp <= 0) {
+            continue;
+        }
+        double x = std::log((double) result.rows);
+        double y = std::log(result.nsPerOp);
+        n++;
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+    double denominator = n * sumXX - sumX * sumX;
+    if (n < 2 || denominator == 0) {
+        return 0;
+    }
+    return (n * sumXY - sumX * sumY) / denominator;
+}
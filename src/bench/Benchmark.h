@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <iostream>
+
+/** the measurement of one benchmark at one dataset size */
+struct BenchmarkResult
+{
+    std::string name;
+    // rows in the dataset the benchmark ran over
+    std::size_t rows;
+    unsigned long operations;
+    double nsPerOp;
+    double allocsPerOp;
+};
+
+/** runs benchmarks and reports them as a table, as JSON, and against an earlier JSON report.
+ *
+ * Allocations are counted by AllocationCounter, which replaces the global operator new,
+ * so allocs/op covers everything an operation allocates, including inside the standard library.
+ */
+class Benchmark
+{
+    public:
+        /** run every benchmark for at least minSeconds */
+        Benchmark(double minSeconds = 0.2);
+
+        /** time op, which does opsPerCall operations every call.
+         * setup runs before every call and is not timed, ops without setup are timed in batches
+         * */
+        const BenchmarkResult& run(std::string name,
+                                   std::size_t rows,
+                                   std::size_t opsPerCall,
+                                   std::function<void()> op,
+                                   std::function<void()> setup = nullptr);
+        /** return every result so far, in the order run */
+        const std::vector<BenchmarkResult>& getResults() const;
+
+        /** print one row per result, then how every benchmark scales with the dataset size */
+        void printTable(std::ostream& out) const;
+        /** write the results as JSON, one result per line so reports diff cleanly */
+        void writeJson(std::ostream& out) const;
+        /** compare against a JSON report written by writeJson, returns the amount of results
+         * more than threshold (0.1 = 10%) slower or allocating more
+         * */
+        unsigned int compare(std::istream& baseline, double threshold, std::ostream& out) const;
+
+        /** slope of log(ns/op) over log(rows) for a benchmark: 0 is constant time, 1 linear in the rows */
+        double getScaling(std::string name) const;
+
+    private:
+        double minSeconds;
+        std::vector<BenchmarkResult> results;
+};
+
+/** keeps a value alive so the optimiser can't drop the work producing it */
+extern volatile std::size_t benchmarkSink;
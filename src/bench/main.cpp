@@ -0,0 +1,302 @@
+#include "Benchmark.h"
+#include "../CSVReader.h"
+#include "../OrderBook.h"
+#include "../Wallet.h"
+#include "../Tokenizer.h"
+#include "../OrderJournal.h"
+#include "../SweepRunner.h"
+#include "../MarketExport.h"
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <filesystem>
+#include <algorithm>
+
+/** usage:
+ *  ./bench.out [--data <csv-file>] [--sizes 1,4,16] [--min-time <seconds>] [--json <file>]
+ *              [--baseline <json-file>] [--threshold <fraction>]
+ *
+ *  Runs the OrderBook hot paths over the data file repeated 1, 4 and 16 times (--sizes),
+ *  every copy a year after the one before so the timestamps stay in order.
+ *  With --baseline exits with 1 if a benchmark got slower than --threshold (default 0.1)
+ *  or allocates more than in the baseline report.
+ * */
+
+/** the allocating tokenise CSVReader used before Tokenizer, kept as the reference the
+ * string_view tokenise is measured against. A string per token
+ * */
+static std::vector<std::string> legacyTokenise(std::string csvLine, char separator)
+{
+    std::vector<std::string> tokens;
+    std::size_t start = csvLine.find_first_not_of(separator, 0);
+    std::size_t end;
+    do {
+        end = csvLine.find_first_of(separator, start);
+        if (start == csvLine.length() || start == end) break;
+        if (end != std::string::npos) tokens.push_back(csvLine.substr(start, end - start));
+        else tokens.push_back(csvLine.substr(start, csvLine.length() - start));
+        start = end + 1;
+    } while (end != std::string::npos);
+    return tokens;
+}
+
+/** the lines of the csv file repeated copies times, copy c moved c years later */
+static std::vector<std::string> repeatLines(const std::vector<std::string>& lines, unsigned int copies)
+{
+    std::vector<std::string> repeated;
+    repeated.reserve(lines.size() * copies);
+    for (unsigned int copy = 0; copy < copies; ++copy)
+    {
+        for (const std::string& line : lines)
+        {
+            std::string shifted = line;
+            if (shifted.size() >= 4) {
+                shifted.replace(0, 4, std::to_string(std::stoi(line.substr(0, 4)) + copy));
+            }
+            repeated.push_back(shifted);
+        }
+    }
+    return repeated;
+}
+
+/** run every benchmark over one dataset */
+static void runBenchmarks(Benchmark& benchmark, const std::vector<std::string>& lines, std::string csvFile)
+{
+    // the dataset as a file, parsed and as a book
+    {
+        std::ofstream file{csvFile};
+        for (const std::string& line : lines)
+        {
+            file << line << "\n";
+        }
+    }
+    std::vector<OrderBookEntry> rows = CSVReader::readCSV(csvFile);
+    OrderBook book;
+    book.appendOrders(rows);
+    const std::vector<std::string>& timestamps = book.getTimestamps();
+    std::size_t size = rows.size();
+    std::string product = "ETH/BTC";
+
+    benchmark.run("CSVReader::readCSV", size, size, [&]()
+    {
+        benchmarkSink += CSVReader::readCSV(csvFile).size();
+    });
+
+    std::size_t line = 0;
+    benchmark.run("legacy tokenise", size, 1, [&]()
+    {
+        benchmarkSink += legacyTokenise(lines[line], ',').size();
+        line = line + 1 < lines.size() ? line + 1 : 0;
+    });
+
+    std::string_view tokens[CSVReader::rowTokens];
+    benchmark.run("CSVReader::tokenise string_view", size, 1, [&]()
+    {
+        benchmarkSink += CSVReader::tokenise(lines[line], ',', tokens, CSVReader::rowTokens);
+        line = line + 1 < lines.size() ? line + 1 : 0;
+    });
+
+    std::size_t time = 0;
+    auto nextTime = [&]()
+    {
+        const std::string& timestamp = timestamps[time];
+        time = time + 1 < timestamps.size() ? time + 1 : 0;
+        return timestamp;
+    };
+
+    benchmark.run("OrderBook::getOrders", size, 1, [&]()
+    {
+        benchmarkSink += book.getOrders(OrderBookType::ask, product, nextTime()).size();
+    });
+
+    std::string current = timestamps[0];
+    benchmark.run("OrderBook::getNextTime", size, 1, [&]()
+    {
+        current = book.getNextTime(current);
+        benchmarkSink += current.size();
+    });
+
+    benchmark.run("OrderBook::calcProductInTimestampsAvg", size, 1, [&]()
+    {
+        benchmarkSink += (std::size_t) book.calcProductInTimestampsAvg(product, nextTime(), 10, OrderBookType::ask);
+    });
+
+    benchmark.run("OrderBook::calcProductPrediction", size, 1, [&]()
+    {
+        benchmarkSink += (std::size_t) book.calcProductPrediction(product, nextTime(), 10, OrderBookType::ask, "max");
+    });
+    for (std::pair<const char*, PredictionModel> model : {std::make_pair("ewma", PredictionModel::ewma),
+                                                          std::make_pair("trend", PredictionModel::trend),
+                                                          std::make_pair("vwap", PredictionModel::vwap)})
+    {
+        benchmark.run(std::string{"OrderBook::calcProductPrediction "} + model.first, size, 1, [&]()
+        {
+            benchmarkSink += (std::size_t) book.calcProductPrediction(product, nextTime(), 10, OrderBookType::ask, "max", model.second);
+        });
+    }
+
+    benchmark.run("OrderBook::matchAsksToBids", size, 1, [&]()
+    {
+        benchmarkSink += book.matchAsksToBids(product, nextTime()).size();
+    });
+
+    // user orders land at random times of a full book, every call starts from a fresh copy
+    const std::size_t inserts = 256;
+    std::mt19937 random{42};
+    std::vector<OrderBookEntry> orders;
+    for (std::size_t i = 0; i < inserts; ++i)
+    {
+        orders.push_back(rows[random() % rows.size()]);
+        orders.back().username = "simuser";
+    }
+    OrderBook insertBook;
+    benchmark.run("OrderBook::insertOrder", size, inserts, [&]()
+    {
+        for (OrderBookEntry& order : orders)
+        {
+            insertBook.insertOrder(order);
+        }
+    }, [&]()
+    {
+        insertBook = book;
+    });
+
+    Wallet wallet;
+    for (const char* currency : {"BTC", "ETH", "DOGE", "USDT"})
+    {
+        wallet.insertCurrency(currency, 1e12);
+    }
+    std::vector<OrderBookEntry> sales;
+    for (std::size_t i = 0; i < 1024; ++i)
+    {
+        sales.push_back(rows[random() % rows.size()]);
+        sales.back().orderType = sales.back().orderType == OrderBookType::ask ? OrderBookType::asksale : OrderBookType::bidsale;
+    }
+    std::size_t sale = 0;
+    benchmark.run("Wallet::processSale", size, 1, [&]()
+    {
+        wallet.processSale(sales[sale]);
+        sale = sale + 1 < sales.size() ? sale + 1 : 0;
+    });
+    benchmark.run("Wallet::processSales", size, sales.size(), [&]()
+    {
+        wallet.processSales(sales, "dataset");
+    });
+
+    // one backtest over the whole book, on the calling thread
+    SweepRunner sweep{std::make_shared<const OrderBook>(book)};
+    std::vector<SweepConfig> configs{SweepConfig{PredictionModel::ewma, -0.002, -0.002, 0.1}};
+    benchmark.run("SweepRunner::run", size, 1, [&]()
+    {
+        benchmarkSink += sweep.run(configs, 1)[0].sales;
+    });
+
+    // depth and trades of every timestamp, written out
+    std::string exportFile = csvFile + ".mkrc";
+    benchmark.run("MarketExport::write", size, rows.size(), [&]()
+    {
+        benchmarkSink += MarketExport::write(exportFile, book);
+    });
+    std::filesystem::remove(exportFile);
+
+    // orders stream in and are committed in groups, one sync for every call
+    std::string journalFile = csvFile + ".journal";
+    OrderJournal journal;
+    journal.create(journalFile, JournalRecord{JournalRecordType::dataset, csvFile, {}});
+    std::vector<JournalRecord> entered;
+    for (std::size_t i = 0; i < 256; ++i)
+    {
+        entered.push_back(JournalRecord{JournalRecordType::order, "", {orders[i % orders.size()]}});
+    }
+    benchmark.run("OrderJournal::append", size, entered.size(), [&]()
+    {
+        std::uint64_t sequence = 0;
+        for (const JournalRecord& record : entered)
+        {
+            sequence = journal.append(record);
+        }
+        journal.commit(sequence);
+    });
+    journal.close();
+    std::filesystem::remove(journalFile);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string dataFile = "20200317.csv";
+    std::vector<unsigned int> sizes{1, 4, 16};
+    double minSeconds = 0.2;
+    std::string jsonFile;
+    std::string baselineFile;
+    double threshold = 0.1;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--data" && i + 1 < argc) {
+            dataFile = argv[++i];
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            sizes.clear();
+            Tokenizer tokenizer{argv[++i], ','};
+            std::string_view size;
+            while (tokenizer.next(size))
+            {
+                sizes.push_back(std::stoul(std::string{size}));
+            }
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            minSeconds = std::stod(argv[++i]);
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonFile = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baselineFile = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            threshold = std::stod(argv[++i]);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--data <csv-file>] [--sizes 1,4,16] [--min-time <seconds>] [--json <file>] [--baseline <json-file>] [--threshold <fraction>]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::ifstream data{dataFile};
+    if (!data.is_open()) {
+        std::cerr << "Could not open " << dataFile << std::endl;
+        return 1;
+    }
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(data, line))
+    {
+        lines.push_back(line);
+    }
+
+    // the code under test reports progress and bad rows on std::cout, keep it out of the results
+    std::streambuf* coutBuffer = std::cout.rdbuf(nullptr);
+    Benchmark benchmark{minSeconds};
+    std::string csvFile = (std::filesystem::temp_directory_path() / "merklerex-bench.csv").string();
+    for (unsigned int copies : sizes)
+    {
+        std::cerr << "running over " << copies << "x " << dataFile << std::endl;
+        runBenchmarks(benchmark, repeatLines(lines, copies), csvFile);
+    }
+    std::filesystem::remove(csvFile);
+    std::cout.rdbuf(coutBuffer);
+
+    benchmark.printTable(std::cout);
+
+    if (jsonFile != "") {
+        std::ofstream json{jsonFile};
+        benchmark.writeJson(json);
+    }
+
+    if (baselineFile != "") {
+        std::ifstream baseline{baselineFile};
+        if (!baseline.is_open()) {
+            std::cerr << "Could not open " << baselineFile << std::endl;
+            return 1;
+        }
+        std::cout << "\n";
+        unsigned int regressions = benchmark.compare(baseline, threshold, std::cout);
+        std::cout << regressions << " regressions" << std::endl;
+        return regressions > 0 ? 1 : 0;
+    }
+    return 0;
+}
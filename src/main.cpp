@@ -1,12 +1,496 @@
 #include "Wallet.h"
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include "MerkelMain.h"
 #include "AdvisorBotMain.h"
+#include "ConcurrentOrderBook.h"
+#include "DayCatalogue.h"
+#include "AdvisorBotServer.h"
+#include "LoadGenerator.h"
+#include "CSVReader.h"
+#include "OrderArchive.h"
+#include "MarketDataGenerator.h"
+#include "Trace.h"
+#include "SweepRunner.h"
+#include "MarketExport.h"
+#include <cstdlib>
+#include <csignal>
+#include <charconv>
+#include <cmath>
+#include <type_traits>
 
-int main()
+// the server being run, so SIGINT / SIGTERM can stop it cleanly
+static AdvisorBotServer* runningServer = nullptr;
+
+static void stopServer(int)
+{
+    if (runningServer != nullptr) {
+        runningServer->stop();
+    }
+}
+
+/** read value from the whole of text, false if it isn't a number of that type or is out of its range */
+template <typename T>
+static bool parseNumber(const std::string& text, T& value)
+{
+    T parsed{};
+    std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), parsed);
+    if (text.size() == 0 || result.ec != std::errc{} || result.ptr != text.data() + text.size()) {
+        return false;
+    }
+    if constexpr (std::is_floating_point<T>::value) {
+        if (!std::isfinite(parsed)) {
+            return false;
+        }
+    }
+    value = parsed;
+    return true;
+}
+
+/** print the usage lines, after a bad argument */
+static void printUsage(const char* program)
+{
+    std::cerr << "usage: " << program << " [--batch <file|->] [--format text|csv|json] [--output <file>] [--threads <n>] [--ingest <file>] [--data <file>] [--data-dir <dir>] [--memory-budget <MiB>] [--trace <file>] [--load-stats]" << std::endl;
+    std::cerr << "       " << program << " --archive <csv-file> <archive-file>" << std::endl;
+    std::cerr << "       " << program << " --simulate [--data <file>] [--restore <checkpoint-file>] [--checkpoint <file> --checkpoint-every <n>] [--journal <file>]" << std::endl;
+    std::cerr << "       " << program << " --sweep <n|config-file> [--data <file>] [--threads <n>] [--output <file>]" << std::endl;
+    std::cerr << "       " << program << " --export <file> [--data <file>]" << std::endl;
+    std::cerr << "       " << program << " --generate <csv-or-archive-file> [--products <n>] [--rows-per-timestamp <n>] [--timestamps <n>] [--volatility <x>] [--crossing <ratio>] [--malformed <ratio>] [--seed <n>] [--start <timestamp>]" << std::endl;
+    std::cerr << "       " << program << " --serve <port|socket-path> [--ingest <file>]" << std::endl;
+    std::cerr << "       " << program << " --loadgen <port|socket-path> [--connections <n>] [--requests <n>] [--pipeline <n>] [--script <file>]" << std::endl;
+}
+
+/** usage: 
+ *  ./a.out                                        interactive AdvisorBot
+ *  ./a.out --batch <file|-> [--format text|csv|json] [--output <file>] [--threads <n>]
+ *                                                 run a command script until EOF
+ *  ./a.out --serve <port|socket-path>             serve commands to many clients, see AdvisorBotServer
+ *  ./a.out --loadgen <port|socket-path> [--connections <n>] [--requests <n>] [--pipeline <n>] [--script <file>]
+ *                                                 load test a running server
+ *  --ingest <file>                                append the rows of another csv file to the
+ *                                                 book on a writer thread while commands run
+ *  --data-dir <dir> [--memory-budget <MiB>]       use every csv file in dir as one day of a multi-day
+ *                                                 dataset instead of 20200317.csv (interactive and batch)
+ *  --data <file>                                  load a csv or archive file instead of 20200317.csv
+ *  ./a.out --archive <csv-file> <archive-file>    compress a csv data file into an archive, see OrderArchive
+ *  ./a.out --generate <csv-or-archive-file> [--products <n>] [--rows-per-timestamp <n>] [--timestamps <n>]
+ *          [--volatility <x>] [--crossing <ratio>] [--malformed <ratio>] [--seed <n>] [--start <timestamp>]
+ *                                                 write a synthetic dataset, see MarketDataGenerator. It starts
+ *                                                 at --start, e.g. "2020/03/18 17:01:24.884492", or at the time
+ *                                                 20200317.csv starts
+ *  --load-stats                                   print the throughput and waiting time of every ingest stage
+ *                                                 when a csv file is loaded
+ *  --trace <file>                                 record loading, matching and queries as a Chrome trace,
+ *                                                 open it in chrome://tracing or ui.perfetto.dev
+ *  ./a.out --simulate [--data <file>] [--restore <checkpoint-file>] [--checkpoint <file> --checkpoint-every <n>]
+ *          [--journal <file>]                     interactive trading simulation (MerkelMain), optionally
+ *                                                 resumed from a checkpoint and saving one every n time frames.
+ *                                                 With --journal every order and sale is journaled, and an
+ *                                                 existing journal is recovered instead of --data / --restore
+ *  ./a.out --sweep <n|config-file> [--data <file>] [--threads <n>] [--output <file>]
+ *                                                 backtest n strategy configurations, or those in a csv file
+ *                                                 of model,bidOffset,askOffset,orderFraction lines, in parallel
+ *                                                 on one shared book (see SweepRunner). Uses every core unless
+ *                                                 --threads is given, --output writes every run's result as csv
+ *  ./a.out --export <file> [--data <file>]        write the depth per price level and the trades of every
+ *                                                 timestamp as a columnar file, see MarketExport
+ * */
+int main(int argc, char* argv[])
 {   
-    // MerkelMain app{};
-    AdvisorBotMain app{};
-    app.init();
-    
+    std::string batchFile;
+    std::string format = "text";
+    std::string outputFile;
+    unsigned int threads = 1;
+    bool threadsGiven = false;
+    std::string ingestFile;
+    std::string serveAddress;
+    std::string loadgenAddress;
+    std::string scriptFile;
+    unsigned int connections = 8;
+    unsigned long requests = 100000;
+    unsigned int pipeline = 16;
+    std::string dataDirectory;
+    std::string dataFile = "20200317.csv";
+    std::string archiveSource;
+    std::string archiveFile;
+    std::string generateFile;
+    MarketDataSettings generatorSettings;
+    std::size_t memoryBudget = 512;
+    std::string traceFile;
+    bool simulate = false;
+    std::string restoreFile;
+    std::string checkpointFile;
+    unsigned int checkpointEvery = 0;
+    std::string journalFile;
+    std::string sweep;
+    std::string exportFile;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool valid = true;
+        if (arg == "--batch" && i + 1 < argc) {
+            batchFile = argv[++i];
+        } else if (arg == "--format" && i + 1 < argc) {
+            format = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else if (arg == "--ingest" && i + 1 < argc) {
+            ingestFile = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            // 0 means one thread per core
+            valid = parseNumber(argv[++i], threads);
+            threadsGiven = true;
+            if (threads == 0) {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serveAddress = argv[++i];
+        } else if (arg == "--loadgen" && i + 1 < argc) {
+            loadgenAddress = argv[++i];
+        } else if (arg == "--script" && i + 1 < argc) {
+            scriptFile = argv[++i];
+        } else if (arg == "--connections" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], connections);
+        } else if (arg == "--requests" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], requests);
+        } else if (arg == "--pipeline" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], pipeline);
+        } else if (arg == "--data" && i + 1 < argc) {
+            dataFile = argv[++i];
+        } else if (arg == "--archive" && i + 2 < argc) {
+            archiveSource = argv[++i];
+            archiveFile = argv[++i];
+        } else if (arg == "--generate" && i + 1 < argc) {
+            generateFile = argv[++i];
+        } else if (arg == "--products" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], generatorSettings.products);
+        } else if (arg == "--rows-per-timestamp" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], generatorSettings.rowsPerTimestamp);
+        } else if (arg == "--timestamps" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], generatorSettings.timestamps);
+        } else if (arg == "--volatility" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], generatorSettings.volatility);
+        } else if (arg == "--crossing" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], generatorSettings.crossingRatio);
+        } else if (arg == "--malformed" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], generatorSettings.malformedRate);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], generatorSettings.seed);
+        } else if (arg == "--start" && i + 1 < argc) {
+            generatorSettings.startTime = argv[++i];
+        } else if (arg == "--data-dir" && i + 1 < argc) {
+            dataDirectory = argv[++i];
+        } else if (arg == "--memory-budget" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], memoryBudget);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            traceFile = argv[++i];
+        } else if (arg == "--load-stats") {
+            OrderBook::setPrintLoadStats(true);
+        } else if (arg == "--simulate") {
+            simulate = true;
+        } else if (arg == "--restore" && i + 1 < argc) {
+            restoreFile = argv[++i];
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            checkpointFile = argv[++i];
+        } else if (arg == "--checkpoint-every" && i + 1 < argc) {
+            valid = parseNumber(argv[++i], checkpointEvery);
+        } else if (arg == "--journal" && i + 1 < argc) {
+            journalFile = argv[++i];
+        } else if (arg == "--sweep" && i + 1 < argc) {
+            sweep = argv[++i];
+        } else if (arg == "--export" && i + 1 < argc) {
+            exportFile = argv[++i];
+        } else {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (!valid) {
+            std::cerr << "Bad number " << argv[i] << " for " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // the trace is written on the way out, whichever mode returns
+    if (traceFile != "") {
+        Trace::start(traceFile);
+        Trace::setThreadName("main");
+        std::atexit([]() { Trace::stop(); });
+    }
+
+    // generating a dataset needs no book
+    if (generateFile != "") {
+        MarketDataGenerator generator{generatorSettings};
+        return generator.write(generateFile) ? 0 : 1;
+    }
+
+    // compressing is a one off, it needs no book either
+    if (archiveFile != "") {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<OrderBookEntry> rows = CSVReader::readCSV(archiveSource);
+        auto read = std::chrono::steady_clock::now();
+        if (!OrderArchive::write(archiveFile, rows)) {
+            return 1;
+        }
+        auto written = std::chrono::steady_clock::now();
+        std::size_t decoded = OrderArchive::read(archiveFile).size();
+        auto end = std::chrono::steady_clock::now();
+
+        std::ifstream csv{archiveSource, std::ios::binary | std::ios::ate};
+        std::ifstream archive{archiveFile, std::ios::binary | std::ios::ate};
+        double csvBytes = csv.tellg();
+        double archiveBytes = archive.tellg();
+        std::cout << "wrote " << decoded << " rows to " << archiveFile << std::endl;
+        std::cout << "csv: " << csvBytes << " bytes, read in " << std::chrono::duration<double>(read - start).count() << "s" << std::endl;
+        std::cout << "archive: " << archiveBytes << " bytes (" << csvBytes / archiveBytes << "x smaller), written in "
+                  << std::chrono::duration<double>(written - read).count() << "s, read in "
+                  << std::chrono::duration<double>(end - written).count() << "s" << std::endl;
+        return decoded == rows.size() ? 0 : 1;
+    }
+
+    // the trading simulation has a book of its own, a restored one is read from the checkpoint only
+    // a multi-day dataset is read by the interactive and batch AdvisorBot only
+    if (dataDirectory != "" && (simulate || sweep != "" || exportFile != "" || serveAddress != "" || ingestFile != "")) {
+        std::cerr << "--data-dir can't be used with --simulate, --sweep, --export, --serve or --ingest" << std::endl;
+        return 1;
+    }
+
+    if (simulate) {
+        // an existing journal knows where its simulation started
+        bool recovering = journalFile != "" && std::filesystem::exists(journalFile);
+        MerkelMain app{restoreFile == "" && !recovering ? dataFile : ""};
+        if (!recovering && restoreFile != "" && !app.restore(restoreFile)) {
+            return 1;
+        }
+        if (journalFile != "" && !app.openJournal(journalFile)) {
+            return 1;
+        }
+        if (checkpointFile != "") {
+            app.setAutoCheckpoint(checkpointFile, checkpointEvery == 0 ? 64 : checkpointEvery);
+        }
+        app.init();
+        return 0;
+    }
+
+    // an export reads the book once and writes it out as it goes
+    if (exportFile != "") {
+        OrderBook book{dataFile};
+        auto start = std::chrono::steady_clock::now();
+        if (!MarketExport::write(exportFile, book)) {
+            return 1;
+        }
+        auto written = std::chrono::steady_clock::now();
+        ExportSummary summary;
+        if (!MarketExport::scan(exportFile, summary)) {
+            return 1;
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        std::ifstream exported{exportFile, std::ios::binary | std::ios::ate};
+        double seconds = std::chrono::duration<double>(written - start).count();
+        std::cout << "exported " << book.getTimestamps().size() << " timestamps to " << exportFile << " in " << seconds << "s ("
+                  << (seconds > 0 ? book.getTimestamps().size() / seconds : 0) << " timestamps/s), "
+                  << (double) exported.tellg() << " bytes" << std::endl;
+        std::cout << "depth: " << summary.depthRows << " levels, trades: " << summary.tradeRows << " sales of "
+                  << summary.tradeAmount << " in total, " << summary.blocks << " blocks scanned in "
+                  << std::chrono::duration<double>(end - written).count() << "s" << std::endl;
+        return 0;
+    }
+
+    // a sweep loads the book once and shares it with every run
+    if (sweep != "") {
+        std::vector<SweepConfig> configs;
+        std::size_t runs = 0;
+        if (sweep.find_first_not_of("0123456789") == std::string::npos) {
+            if (!parseNumber(sweep, runs)) {
+                std::cerr << "Bad number " << sweep << " for --sweep" << std::endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+            configs = SweepRunner::makeGrid(runs);
+        } else if (!SweepRunner::readConfigs(sweep, configs)) {
+            return 1;
+        }
+        std::shared_ptr<const OrderBook> book = std::make_shared<const OrderBook>(dataFile);
+        SweepRunner runner{book};
+        unsigned int sweepThreads = threadsGiven ? threads : std::max(1u, std::thread::hardware_concurrency());
+        auto start = std::chrono::steady_clock::now();
+        std::vector<SweepResult> results = runner.run(configs, sweepThreads);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "sweep: " << results.size() << " runs on " << sweepThreads << " threads in " << seconds << "s ("
+                  << (seconds > 0 ? results.size() / seconds : 0) << " runs/s, " << runner.getSteals() << " stolen)" << std::endl;
+        std::cout << "book: " << book->getRowCount() << " orders, " << (book->getMemoryUsage() >> 10)
+                  << " KiB shared by every run" << std::endl;
+        std::vector<const SweepResult*> ranked;
+        for (const SweepResult& result : results)
+        {
+            ranked.push_back(&result);
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const SweepResult* a, const SweepResult* b)
+        {
+            return a->endValue - a->startValue > b->endValue - b->startValue;
+        });
+        for (std::size_t i = 0; i < ranked.size() && i < 5; ++i)
+        {
+            const SweepResult& result = *ranked[i];
+            std::cout << "#" << i + 1 << " " << PriceModels::modelToString(result.config.model)
+                      << " bid offset " << result.config.bidOffset << " ask offset " << result.config.askOffset
+                      << " fraction " << result.config.orderFraction << ": pnl " << result.endValue - result.startValue
+                      << " (" << result.sales << " sales of " << result.orders << " orders)" << std::endl;
+        }
+        if (outputFile != "") {
+            std::ofstream resultFile{outputFile};
+            if (!resultFile.is_open()) {
+                std::cerr << "Could not open " << outputFile << std::endl;
+                return 1;
+            }
+            SweepRunner::writeResults(resultFile, results);
+        }
+        return 0;
+    }
+
+    // the load generator is only a client, it needs no book
+    if (loadgenAddress != "") {
+        std::vector<std::string> commands{"prod", "min ETH/BTC ask", "max ETH/BTC bid", "avg ETH/BTC ask 3", "predict max ETH/BTC ask", "time"};
+        if (scriptFile != "") {
+            std::ifstream script{scriptFile};
+            std::string line;
+            commands.clear();
+            while (std::getline(script, line))
+            {
+                if (line.size() > 0 && line[0] != '#') {
+                    commands.push_back(line);
+                }
+            }
+            if (commands.size() == 0) {
+                std::cerr << "No commands in " << scriptFile << std::endl;
+                return 1;
+            }
+        }
+        LoadGenerator generator{loadgenAddress, commands, connections, requests, pipeline};
+        return generator.run() ? 0 : 1;
+    }
+
+    // batch mode reads commands from a file or stdin
+    std::ifstream commandFile;
+    if (batchFile != "" && batchFile != "-") {
+        commandFile.open(batchFile);
+        if (!commandFile.is_open()) {
+            std::cerr << "Could not open " << batchFile << std::endl;
+            return 1;
+        }
+    }
+    std::ofstream resultFile;
+    if (outputFile != "") {
+        resultFile.open(outputFile);
+        if (!resultFile.is_open()) {
+            std::cerr << "Could not open " << outputFile << std::endl;
+            return 1;
+        }
+    }
+
+    // loading reports progress on std::cout, keep it out of the batch results
+    std::streambuf* coutBuffer = std::cout.rdbuf();
+    if (batchFile != "" || serveAddress != "") {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    // a multi-day dataset loads its days as the commands reach them
+    if (dataDirectory != "") {
+        std::shared_ptr<DayCatalogue> catalogue = std::make_shared<DayCatalogue>(dataDirectory, memoryBudget << 20);
+        if (catalogue->size() == 0) {
+            std::cerr << "No csv files in " << dataDirectory << std::endl;
+            return 1;
+        }
+        AdvisorBotMain app{catalogue, AdvisorBotMain::makeCommandCounters()};
+        if (batchFile == "") {
+            app.init();
+            return 0;
+        }
+        // days load while the batch runs, so std::cout stays on stderr and results go to stdout directly.
+        // No sync_with_stdio(false) here, it would put std::cout back on stdout
+        std::ostream standardOutput{coutBuffer};
+        app.runBatch(batchFile == "-" ? std::cin : commandFile,
+                     outputFile == "" ? standardOutput : resultFile,
+                     format,
+                     threads);
+        return 0;
+    }
+
+    // the book is kept twice (see ConcurrentOrderBook) only when a writer adds to it or the server shares it
+    std::shared_ptr<ConcurrentOrderBook> sharedBook;
+    std::shared_ptr<const OrderBook> book;
+    if (serveAddress != "" || ingestFile != "") {
+        sharedBook = std::make_shared<ConcurrentOrderBook>(dataFile);
+    } else {
+        book = std::make_shared<const OrderBook>(dataFile);
+    }
+    std::vector<OrderBookEntry> ingestRows;
+    if (ingestFile != "") {
+        ingestRows = CSVReader::readCSV(ingestFile);
+    }
+    std::cout.rdbuf(coutBuffer);
+
+    // the writer publishes one timestamp at a time, readers see whole timestamps only
+    std::thread writer;
+    if (ingestFile != "") {
+        writer = std::thread{[sharedBook, &ingestRows]()
+        {
+            Trace::setThreadName("ingest writer");
+            std::vector<OrderBookEntry> segment;
+            for (const OrderBookEntry& row : ingestRows)
+            {
+                if (segment.size() > 0 && segment.back().timestamp != row.timestamp) {
+                    sharedBook->appendOrders(segment);
+                    segment.clear();
+                }
+                segment.push_back(row);
+            }
+            if (segment.size() > 0) {
+                sharedBook->appendOrders(segment);
+            }
+        }};
+    }
+
+    if (serveAddress != "") {
+        std::shared_ptr<CommandCounters> commandsCounter = AdvisorBotMain::makeCommandCounters();
+        AdvisorBotServer server{sharedBook, commandsCounter};
+        bool listening = server.listen(serveAddress);
+        if (listening) {
+            runningServer = &server;
+            std::signal(SIGINT, stopServer);
+            std::signal(SIGTERM, stopServer);
+            server.run();
+            runningServer = nullptr;
+        }
+        if (writer.joinable()) writer.join();
+        return listening ? 0 : 1;
+    }
+
+    std::unique_ptr<AdvisorBotMain> app;
+    if (sharedBook) {
+        app.reset(new AdvisorBotMain{sharedBook, AdvisorBotMain::makeCommandCounters()});
+    } else {
+        app.reset(new AdvisorBotMain{book, AdvisorBotMain::makeCommandCounters()});
+    }
+    if (batchFile == "") {
+        app->init();
+        if (writer.joinable()) writer.join();
+        return 0;
+    }
+
+    std::ios::sync_with_stdio(false);
+    app->runBatch(batchFile == "-" ? std::cin : commandFile,
+                  outputFile == "" ? std::cout : resultFile,
+                  format,
+                  threads);
+    if (writer.joinable()) writer.join();
+    return 0;
 }